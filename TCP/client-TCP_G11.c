@@ -1,38 +1,583 @@
+#define _GNU_SOURCE     // Necessario per ppoll nel generatore di carico
+#include <stdint.h>     // Tipi a dimensione fissa (uint32_t, int32_t) per i frame
 #include <stdio.h>      // Libreria standard per l'input/output (printf, scanf, perror)
 #include <stdlib.h>     // Libreria per funzioni di utilità generale (atoi, exit)
-#include <string.h>     // Libreria per la manipolazione di stringhe (bzero, bcopy, strstr)
-#include <unistd.h>     // Fornisce accesso alle API POSIX (read, write, close)
+#include <string.h>     // Libreria per la manipolazione di stringhe (bzero, bcopy)
+#include <unistd.h>     // Fornisce accesso alle API POSIX (isatty)
+#include <errno.h>      // Codici di errore dell'I/O non bloccante (EAGAIN)
+#include <fcntl.h>      // open e socket non bloccante nella modalità flusso
+#include <poll.h>       // Invio delle coppie e ricezione degli esiti insieme (-F)
+#include <sys/stat.h>   // Dimensione del file di coppie
+#include <sys/mman.h>   // Mappatura del file di coppie quando sendfile non è disponibile
+#include <sys/sendfile.h> // Invio del file di coppie senza copiarlo nel processo
+#include <signal.h>     // SIGPIPE ignorato nella modalità flusso
 #include <netdb.h>      // Definizioni per le operazioni di network database (gethostbyname)
 #include <arpa/inet.h>  // Definizioni per le operazioni su indirizzi Internet (htons)
+#include "../common/protocollo_G11.h" // Formato dei frame condiviso con il server
+#include "../common/libcalc_G11.h"    // Libreria client: connessioni, id delle richieste, aggregazione in lotti
+#include "../common/grandi_G11.h"     // Conversione degli interi grandi da e verso il testo decimale
+#include "../common/carico_G11.h"     // Generatore di carico (-g)
 
-// Funzione per la gestione degli errori. Stampa un messaggio e termina il programma.
+#define USO "Uso: %s hostname porta [-s] [-l coppie_per_lotto] [-T int32|int64|double|grande] [-E espressione] [-g [-P tcp|udp] [-C connessioni] [-j thread] " \
+            "[-q profondita] [-R richieste_al_s] [-x miscela] [-d secondi]] [-F A|S|M|D -i file_coppie -o file_esiti]\n"
+#define MAX_IN_VOLO 1024            // Righe della sessione inviate prima di attendere le risposte
+#define MAX_TESTO 40000             // Caratteri di un operando: un intero grande arriva a circa 39500 cifre decimali
+
+// Riga della sessione in attesa di risposta, conservata per stampare l'operazione insieme al risultato
+struct riga_sessione {
+    char op;
+    int32_t a, b;
+    struct g11_futuro f;
+};
+
+// Funzione per la gestione degli errori. Stampa un messaggio di errore e termina il programma.
 void error(const char *msg) {
     perror(msg); // Stampa il messaggio di errore personalizzato e la descrizione dell'errore di sistema
     exit(0);     // Termina il programma
 }
 
+// Codifica in 'frame' una richiesta con operandi del tipo indicato, scritti in decimale.
+// Ritorna la lunghezza del frame, oppure 0 se un operando non è un numero valido per il tipo.
+static uint32_t codifica_tipizzata(uint8_t *frame, uint8_t op, uint16_t tipo, const char *a, const char *b) {
+    static uint32_t cifre[2][G11_GRANDI_MAX_CIFRE];
+    const char *testo[2] = { a, b };
+    char *fine;
+
+    if (tipo == G11_TIPO_GRANDE) {
+        struct g11_grande x[2];
+        for (int k = 0; k < 2; k++) {
+            size_t letti = g11_grande_da_testo(testo[k], &x[k], cifre[k], G11_GRANDI_MAX_CIFRE);
+            if (letti == 0 || testo[k][letti] != '\0') return 0;
+        }
+        uint32_t lunghezza = g11_dim_richiesta_grandi(x[0].n, x[1].n);
+        g11_scrivi_intestazione(frame, lunghezza, op, tipo, 0);
+        uint8_t *p = frame + G11_DIM_INTESTAZIONE + 8;
+        for (int k = 0; k < 2; k++) {
+            g11_scrivi_u32(frame + G11_DIM_INTESTAZIONE + 4 * k, x[k].n | (x[k].negativo ? G11_GRANDI_NEGATIVO : 0));
+            for (uint32_t i = x[k].n; i-- > 0; p += 4) {
+                g11_scrivi_u32(p, x[k].cifre[i]);
+            }
+        }
+        return lunghezza;
+    }
+
+    uint64_t v[2];
+    for (int k = 0; k < 2; k++) {
+        errno = 0;
+        if (tipo == G11_TIPO_DOUBLE) {
+            double d = strtod(testo[k], &fine);
+            memcpy(&v[k], &d, sizeof(d));
+        } else {
+            v[k] = (uint64_t) strtoll(testo[k], &fine, 10);
+        }
+        if (fine == testo[k] || *fine != '\0' || errno == ERANGE) return 0;
+    }
+    g11_codifica_richiesta_64(frame, op, tipo, 0, v[0], v[1]);
+    return G11_DIM_RICHIESTA_64;
+}
+
+// Scrive in 'testo' il risultato di una risposta tipizzata (almeno MAX_TESTO caratteri).
+static const char *risultato_tipizzato(const uint8_t *frame, char *testo) {
+    static uint32_t cifre[2 * G11_GRANDI_MAX_CIFRE];
+    uint32_t lunghezza = g11_leggi_u32(frame);
+    uint16_t tipo = g11_leggi_u16(frame + 6);
+    const uint8_t *corpo = frame + G11_DIM_INTESTAZIONE;
+
+    if (tipo == G11_TIPO_GRANDE && lunghezza >= g11_dim_risposta_grande(0)) {
+        uint32_t n = g11_leggi_u32(corpo) & ~G11_GRANDI_NEGATIVO;
+        if (n > 2 * G11_GRANDI_MAX_CIFRE || lunghezza != g11_dim_risposta_grande(n)) return "?";
+        struct g11_grande x = { cifre, n, (g11_leggi_u32(corpo) & G11_GRANDI_NEGATIVO) != 0 };
+        for (uint32_t i = 0; i < n; i++) {
+            cifre[n - 1 - i] = g11_leggi_u32(corpo + 4 + 4u * i);
+        }
+        x.n = g11_cifre_normalizza(cifre, n);
+        return g11_grande_a_testo(&x, testo);
+    }
+    if ((tipo == G11_TIPO_INT64 || tipo == G11_TIPO_DOUBLE) && lunghezza == G11_DIM_RISPOSTA_64) {
+        uint64_t v = g11_leggi_u64(corpo);
+        if (tipo == G11_TIPO_DOUBLE) {
+            double d;
+            memcpy(&d, &v, sizeof(d));
+            snprintf(testo, MAX_TESTO, "%.17g", d);
+        } else {
+            snprintf(testo, MAX_TESTO, "%lld", (long long) (int64_t) v);
+        }
+        return testo;
+    }
+    return "?";
+}
+
+// Esegue una richiesta tipizzata e stampa il risultato come la sessione ("[n] a op b = r").
+// Ritorna -1 se la connessione è caduta.
+static int esegui_tipizzata(struct g11_calc *cl, uint32_t numero, char op, uint16_t tipo, const char *a, const char *b) {
+    static uint8_t richiesta[G11_DIM_INTESTAZIONE + 8 + 8 * G11_GRANDI_MAX_CIFRE];
+    static uint8_t risposta[G11_DIM_INTESTAZIONE + 4 + 8 * G11_GRANDI_MAX_CIFRE];
+    static char testo[MAX_TESTO];
+
+    uint8_t codice = g11_opcode_da_comando(op);
+    if (codifica_tipizzata(richiesta, codice ? codice : (uint8_t) op, tipo, a, b) == 0) {
+        printf("[%u] operandi non validi per il tipo %s\n", numero, g11_nome_tipo(tipo));
+        return 0;
+    }
+    int stato = g11_calc_esegui_frame(cl, richiesta, risposta, sizeof(risposta));
+    if (stato == G11_CALC_ERRORE_CONNESSIONE) {
+        return -1;
+    }
+    char simbolo = codice ? (char) codice : op;
+    if (stato == G11_STATO_OK) {
+        printf("[%u] %s %c %s = %s\n", numero, a, simbolo, b, risultato_tipizzato(risposta, testo));
+    } else {
+        printf("[%u] %s %c %s: %s\n", numero, a, simbolo, b, g11_descrizione_stato((uint8_t) stato));
+    }
+    return 0;
+}
+
+// Sessione con operandi tipizzati (-T): le righe hanno lo stesso formato, ma ognuna attende la propria
+// risposta prima della successiva.
+static void esegui_sessione_tipizzata(struct g11_calc *cl, uint16_t tipo) {
+    static char riga[2 * MAX_TESTO + 16];
+    uint32_t numero = 0;
+    while (fgets(riga, sizeof(riga), stdin) != NULL) {
+        char *op = strtok(riga, " \t\r\n");
+        char *a = strtok(NULL, " \t\r\n");
+        char *b = strtok(NULL, " \t\r\n");
+        if (op == NULL || a == NULL || b == NULL || op[1] != '\0') {
+            continue; // Riga non valida o vuota
+        }
+        if (esegui_tipizzata(cl, ++numero, op[0], tipo, a, b) < 0) {
+            fprintf(stderr, "Il server ha chiuso la connessione\n");
+            exit(0);
+        }
+    }
+}
+
+// Valuta l'espressione lato server per ogni riga di standard input, che contiene i valori delle variabili
+// a, b, c, ... nell'ordine. Le righe partono a gruppi di al più 'per_frame' assegnazioni in un solo frame
+// G11_OP_ESPRESSIONE: il server compila l'espressione una volta e riusa il programma per tutti i gruppi.
+static void esegui_espressione(struct g11_calc *cl, const char *testo, uint32_t per_frame) {
+    static int32_t valori[MAX_IN_VOLO * G11_ESPR_MAX_VARIABILI];
+    static uint8_t richiesta[G11_DIM_INTESTAZIONE + G11_DIM_ESPRESSIONE + G11_ESPR_MAX_TESTO +
+                             4 * MAX_IN_VOLO * G11_ESPR_MAX_VARIABILI];
+    static uint8_t risposta[G11_DIM_INTESTAZIONE + 4 + 5 * MAX_IN_VOLO + 4];
+    size_t t = strlen(testo);
+    uint32_t k = 0, numero = 0;
+    char riga[1024];
+    int fine = 0;
+
+    // Le variabili sono le lettere minuscole: k è la più alta usata
+    for (size_t i = 0; i < t; i++) {
+        if (testo[i] >= 'a' && testo[i] <= 'z' && (uint32_t) (testo[i] - 'a' + 1) > k) k = (uint32_t) (testo[i] - 'a' + 1);
+    }
+    if (t > G11_ESPR_MAX_TESTO) {
+        fprintf(stderr, "Errore: l'espressione supera %d caratteri\n", G11_ESPR_MAX_TESTO);
+        return;
+    }
+    if (per_frame > MAX_IN_VOLO || k == 0) {
+        per_frame = k == 0 ? 1 : MAX_IN_VOLO;
+    }
+
+    while (!fine) {
+        uint32_t m = 0;
+        while (m < per_frame) {
+            if (k == 0 ? numero > 0 : fgets(riga, sizeof(riga), stdin) == NULL) {
+                fine = 1;
+                break;
+            }
+            // Una riga con meno di k valori viene ignorata
+            char *p = riga, *q;
+            uint32_t j = 0;
+            for (; j < k; j++, p = q) {
+                long v = strtol(p, &q, 10);
+                if (q == p) break;
+                valori[m * k + j] = (int32_t) v;
+            }
+            if (j == k) m++;
+            if (k == 0) fine = 1;
+        }
+        if (m == 0) {
+            break;
+        }
+
+        g11_codifica_espressione(richiesta, 0, testo, (uint16_t) t, (uint8_t) k, valori, m);
+        int stato = g11_calc_esegui_frame(cl, richiesta, risposta, sizeof(risposta));
+        if (stato == G11_CALC_ERRORE_CONNESSIONE) {
+            fprintf(stderr, "Il server ha chiuso la connessione\n");
+            exit(0);
+        }
+        if (stato != G11_STATO_OK) {
+            printf("%s: %s\n", testo, g11_descrizione_stato((uint8_t) stato));
+            return;
+        }
+        const uint8_t *risultati = risposta + G11_DIM_INTESTAZIONE + 4;
+        const uint8_t *stati = risultati + 4u * m;
+        for (uint32_t i = 0; i < m; i++) {
+            printf("[%u] %s", ++numero, testo);
+            for (uint32_t j = 0; j < k; j++) {
+                printf("%s%c=%d", j ? ", " : " con ", 'a' + j, valori[i * k + j]);
+            }
+            if (stati[i] == G11_STATO_OK) {
+                printf(" = %d\n", (int32_t) g11_leggi_u32(risultati + 4u * i));
+            } else {
+                printf(": %s\n", g11_descrizione_stato(stati[i]));
+            }
+        }
+    }
+}
+
+// Invia le coppie del file non ancora inviate, finché il socket le accetta. sendfile passa le pagine del
+// file al socket senza copiarle nel processo; se il file non lo consente si manda la sua mappatura in memoria.
+// Ritorna -1 in caso di errore.
+static int invia_coppie(int sockfd, int file, off_t dim, off_t *inviati, const uint8_t **mappa) {
+    while (*inviati < dim) {
+        ssize_t n;
+        if (*mappa == NULL) {
+            n = sendfile(sockfd, file, inviati, (size_t) (dim - *inviati)); // Fa avanzare *inviati
+            if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                void *p = mmap(NULL, (size_t) dim, PROT_READ, MAP_PRIVATE, file, 0);
+                if (p == MAP_FAILED) {
+                    return -1;
+                }
+                madvise(p, (size_t) dim, MADV_SEQUENTIAL);
+                *mappa = p;
+                continue;
+            }
+        } else {
+            n = send(sockfd, *mappa + *inviati, (size_t) (dim - *inviati), MSG_NOSIGNAL);
+            if (n > 0) {
+                *inviati += n;
+            }
+        }
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+        }
+    }
+    return 0;
+}
+
+// Scrive nel file di uscita gli esiti arrivati, finché ce ne sono. Con una pipe (tubo[0] >= 0) splice li
+// sposta dal socket al file senza passare dal processo, altrimenti si usa il buffer e write.
+// Ritorna -1 in caso di errore o se il server chiude prima della fine.
+static int ricevi_esiti(int sockfd, int uscita, const int tubo[2], uint64_t dim, uint64_t *ricevuti) {
+    static uint8_t buf[65536];
+    while (*ricevuti < dim) {
+        size_t voluti = dim - *ricevuti < sizeof(buf) ? (size_t) (dim - *ricevuti) : sizeof(buf);
+        ssize_t n = tubo[0] >= 0 ? splice(sockfd, NULL, tubo[1], NULL, voluti, SPLICE_F_MOVE | SPLICE_F_NONBLOCK)
+                                 : recv(sockfd, buf, voluti, 0);
+        if (n == 0) {
+            errno = ECONNRESET;
+            return -1;
+        }
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+        }
+        *ricevuti += (uint64_t) n;
+        for (ssize_t scritti = 0, m; scritti < n; scritti += m) {
+            m = tubo[0] >= 0 ? splice(tubo[0], NULL, uscita, NULL, (size_t) (n - scritti), SPLICE_F_MOVE)
+                             : write(uscita, buf + scritti, (size_t) (n - scritti));
+            if (m <= 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Modalità flusso (-F): applica l'operazione a tutte le coppie del file di ingresso (int32 big-endian, a e b
+// alternati, 8 byte per coppia) e scrive gli esiti nel file di uscita (risultato int32, stato e 3 byte a
+// zero per coppia). Invio e ricezione procedono insieme, guidati da poll, così nessuno dei due lati accumula
+// dati: la memoria usata è la stessa per qualsiasi dimensione del file. Ritorna 0 se il flusso è completo,
+// 1 se il file non è valido, la connessione cade o il server risponde con un errore.
+static int esegui_flusso(const struct sockaddr_in *server, char op, const char *ingresso, const char *uscita) {
+    int esito = 1, out = -1, sockfd = -1;
+    int tubo[2] = { -1, -1 };
+    const uint8_t *mappa = NULL;
+    off_t dim = 0;
+
+    signal(SIGPIPE, SIG_IGN); // Se il server chiude la connessione l'invio fallisce con EPIPE invece di terminare
+    // 1. File di coppie e file degli esiti
+    int file = open(ingresso, O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        perror("ERRORE apertura del file di coppie");
+        return 1;
+    }
+    struct stat st;
+    if (fstat(file, &st) < 0 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "Errore: %s non è un file regolare\n", ingresso);
+        goto fine;
+    }
+    if (st.st_size % G11_DIM_COPPIA != 0) {
+        fprintf(stderr, "Attenzione: gli ultimi %d byte non formano una coppia e vengono ignorati\n",
+                (int) (st.st_size % G11_DIM_COPPIA));
+    }
+    uint64_t n = (uint64_t) st.st_size / G11_DIM_COPPIA;
+    dim = (off_t) (n * G11_DIM_COPPIA);
+    out = open(uscita, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        perror("ERRORE apertura del file degli esiti");
+        goto fine;
+    }
+    if (fstat(out, &st) == 0 && (S_ISREG(st.st_mode) || S_ISFIFO(st.st_mode)) && pipe2(tubo, O_CLOEXEC) < 0) {
+        tubo[0] = tubo[1] = -1; // Senza pipe si riceve con recv e write
+    }
+
+    // 2. Connessione e richiesta che apre il flusso
+    sockfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sockfd < 0) {
+        perror("ERRORE apertura del socket");
+        goto fine;
+    }
+    if (connect(sockfd, (const struct sockaddr *) server, sizeof(*server)) < 0) {
+        perror("ERRORE connessione");
+        goto fine;
+    }
+    uint8_t richiesta[G11_DIM_INTESTAZIONE + G11_DIM_FLUSSO];
+    g11_codifica_flusso(richiesta, (uint8_t) op, 1, n);
+    if (write(sockfd, richiesta, sizeof(richiesta)) != (ssize_t) sizeof(richiesta)) {
+        perror("ERRORE invio della richiesta");
+        goto fine;
+    }
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+
+    // 3. Coppie in uscita ed esiti in ingresso: prima l'intestazione della risposta, poi gli esiti
+    uint8_t intestazione[G11_DIM_RISPOSTA_FLUSSO];
+    size_t letti = 0, attesi = G11_DIM_INTESTAZIONE;
+    uint64_t ricevuti = 0;
+    off_t inviati = 0;
+    while (letti < attesi || ricevuti < n * G11_DIM_ESITO) {
+        struct pollfd p = { sockfd, (short) (POLLIN | (inviati < dim ? POLLOUT : 0)), 0 };
+        if (poll(&p, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("ERRORE in poll");
+            goto fine;
+        }
+        if ((p.revents & POLLOUT) && invia_coppie(sockfd, file, dim, &inviati, &mappa) < 0) {
+            perror("ERRORE invio delle coppie");
+            goto fine;
+        }
+        if (!(p.revents & (POLLIN | POLLHUP | POLLERR))) {
+            continue;
+        }
+        if (letti == attesi) {
+            if (ricevi_esiti(sockfd, out, tubo, n * G11_DIM_ESITO, &ricevuti) < 0) {
+                perror("ERRORE ricezione degli esiti");
+                goto fine;
+            }
+            continue;
+        }
+        ssize_t r = recv(sockfd, intestazione + letti, attesi - letti, 0);
+        if (r == 0) {
+            fprintf(stderr, "Il server ha chiuso la connessione\n");
+            goto fine;
+        }
+        if (r < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+            perror("ERRORE ricezione della risposta");
+            goto fine;
+        }
+        letti += (size_t) r;
+        if (letti == G11_DIM_INTESTAZIONE) {
+            attesi = g11_leggi_u32(intestazione); // G11_DIM_RISPOSTA con un errore
+            if (attesi != G11_DIM_RISPOSTA_FLUSSO && attesi != G11_DIM_RISPOSTA) {
+                fprintf(stderr, "Risposta non valida dal server\n");
+                goto fine;
+            }
+        }
+        if (letti == attesi && intestazione[5] != G11_STATO_OK) {
+            printf("Flusso: %s\n", g11_descrizione_stato(intestazione[5]));
+            goto fine;
+        }
+    }
+
+    printf("Flusso %s: %lu coppie elaborate, esiti in %s\n", g11_nome_operazione((uint8_t) op),
+           (unsigned long) n, uscita);
+    esito = 0;
+
+fine:
+    // Unico punto di uscita: si rilascia tutto ciò che è stato aperto
+    if (mappa != NULL) {
+        munmap((void *) mappa, (size_t) dim);
+    }
+    if (tubo[0] >= 0) {
+        close(tubo[0]);
+        close(tubo[1]);
+    }
+    if (sockfd >= 0) {
+        close(sockfd);
+    }
+    if (out >= 0) {
+        close(out);
+    }
+    close(file);
+    return esito;
+}
+
+// Sessione in pipeline: legge da standard input righe "operazione primo secondo" (es. "A 3 4") e le accoda
+// nella libreria senza attendere le singole risposte; ogni MAX_IN_VOLO righe (o a fine input) vengono
+// inviate insieme e i risultati stampati nell'ordine delle righe. Con 'lotto' > 1 la libreria riunisce le
+// righe con la stessa operazione in frame G11_OP_LOTTO di al massimo 'lotto' coppie.
+static void esegui_sessione(struct g11_calc *cl) {
+    static struct riga_sessione righe[MAX_IN_VOLO];
+    uint32_t numero = 0;                         // Numero progressivo delle righe, stampato tra parentesi
+    int interattivo = isatty(STDIN_FILENO);
+    char riga[256];
+    int fine = 0;
+
+    while (!fine) {
+        uint32_t n = 0;
+        while (n < MAX_IN_VOLO) {
+            if (fgets(riga, sizeof(riga), stdin) == NULL) {
+                fine = 1;
+                break;
+            }
+            struct riga_sessione *r = &righe[n];
+            if (sscanf(riga, " %c %d %d", &r->op, &r->a, &r->b) != 3) {
+                continue; // Riga non valida o vuota
+            }
+            // Un comando sconosciuto viene comunque inviato: il server risponde con G11_STATO_OP_NON_VALIDA
+            uint8_t op = g11_opcode_da_comando(r->op);
+            r->op = op ? (char) op : r->op;
+            g11_calc_futuro(cl, (uint8_t) r->op, r->a, r->b, &r->f);
+            n++;
+            if (interattivo) {
+                break; // Da terminale ogni riga parte subito
+            }
+        }
+
+        // La prima attesa invia tutte le righe accodate; le risposte vengono abbinate tramite l'id
+        for (uint32_t i = 0; i < n; i++) {
+            int32_t risultato;
+            int stato = g11_futuro_attendi(&righe[i].f, &risultato);
+            numero++;
+            if (stato == G11_CALC_ERRORE_CONNESSIONE) {
+                fprintf(stderr, "Il server ha chiuso la connessione\n");
+                exit(0);
+            }
+            if (stato == G11_STATO_OK) {
+                printf("[%u] %d %c %d = %d\n", numero, righe[i].a, righe[i].op, righe[i].b, risultato);
+            } else {
+                printf("[%u] %d %c %d: %s\n", numero, righe[i].a, righe[i].op, righe[i].b,
+                       g11_descrizione_stato((uint8_t) stato));
+            }
+        }
+    }
+}
+
+// Dialogo interattivo: chiede operazione e operandi finché l'utente non inserisce un comando diverso da A, S, M, D.
+// Tutte le operazioni viaggiano sulla stessa connessione.
+static void esegui_interattivo(struct g11_calc *cl, uint16_t tipo) {
+    static char operandi[2][MAX_TESTO];
+    uint32_t numero = 0;
+    for (;;) {
+        // Chiede all'utente di inserire un comando
+        char command;
+        printf("Inserisci operazione (A, S, M, D) o altro per terminare: ");
+        if (scanf(" %c", &command) != 1) { // Legge un carattere da standard input (lo spazio prima di %c ignora eventuali whitespace)
+            return;
+        }
+        uint8_t op = g11_opcode_da_comando(command);
+        if (op == 0) {
+            printf("Processo terminato come richiesto.\n");
+            return;
+        }
+        printf("Operazione: %s\n", g11_nome_operazione(op));
+
+        // Con -T gli operandi vengono letti come testo e convertiti secondo il tipo
+        if (tipo != G11_TIPO_INT32) {
+            printf("Inserisci primo operando (%s): ", g11_nome_tipo(tipo));
+            if (scanf("%39999s", operandi[0]) != 1) return;
+            printf("Inserisci secondo operando (%s): ", g11_nome_tipo(tipo));
+            if (scanf("%39999s", operandi[1]) != 1) return;
+            if (esegui_tipizzata(cl, ++numero, command, tipo, operandi[0], operandi[1]) < 0) {
+                fprintf(stderr, "Il server ha chiuso la connessione\n");
+                return;
+            }
+            continue;
+        }
+
+        // Se il comando è valido, chiede i numeri all'utente
+        int numbers[2];
+        printf("Inserisci primo intero: ");
+        if (scanf("%d", &numbers[0]) != 1) return;
+        printf("Inserisci secondo intero: ");
+        if (scanf("%d", &numbers[1]) != 1) return;
+
+        // Invia la richiesta e ne attende la risposta con stato e risultato
+        int32_t risultato;
+        int stato = g11_calc_esegui(cl, op, numbers[0], numbers[1], &risultato);
+        if (stato == G11_CALC_ERRORE_CONNESSIONE) {
+            fprintf(stderr, "Il server ha chiuso la connessione\n");
+            return;
+        }
+        printf("Stato Server: %s\n", g11_descrizione_stato((uint8_t) stato));
+        if (stato == G11_STATO_OK) {
+            printf("Risultato ricevuto dal server: %d\n", risultato);
+        }
+    }
+}
+
 int main(int argc, char *argv[]) {
+    int sessione = 0;  // Se 1 invia in pipeline le righe lette da standard input (-s)
+    long lotto = 1;    // Coppie massime per frame G11_OP_LOTTO in sessione (-l)
+    uint16_t tipo = G11_TIPO_INT32; // Tipo degli operandi (-T)
+    const char *espressione = NULL; // Espressione da valutare per ogni riga di standard input (-E)
+    char flusso = 0;                // Operazione da applicare al file di coppie (-F), 0 = nessun flusso
+    const char *file_coppie = NULL, *file_esiti = NULL; // File di ingresso (-i) e di uscita (-o) del flusso
+    struct g11_carico carico; // Parametri del generatore di carico (-g e seguenti)
+    int opt;
+    g11_carico_predefinito(&carico, G11_CARICO_TCP);
+
+    // Lettura delle opzioni:
+    //   -s, -l <n>  sessione in pipeline dalle righe di standard input, con lotti di al più n coppie
+    //   -T <tipo>   tipo degli operandi: int32 (predefinito), int64, double, grande (precisione arbitraria)
+    //   -E <espr>   valuta l'espressione (es. "(a+b)*c/d") con i valori di ogni riga; -l assegnazioni per frame
+    //   -g          generatore di carico: -P protocollo, -C connessioni, -j thread, -q richieste in volo
+    //               per connessione, -R richieste al secondo (0 = ciclo chiuso), -x miscela di operazioni
+    //               (es. A:40,S:20,M:30,D:10), -d durata in secondi; -l indica le coppie per richiesta
+    //   -F <op>     flusso: applica l'operazione a tutte le coppie del file -i e scrive gli esiti nel file -o
+    while ((opt = getopt(argc, argv, "sl:T:E:F:i:o:" G11_CARICO_OPZIONI)) != -1) {
+        switch (opt) {
+            case 's': sessione = 1; break;
+            case 'l': lotto = atol(optarg); sessione = 1; break;
+            case 'E': espressione = optarg; break;
+            case 'F': flusso = optarg[0]; break;
+            case 'i': file_coppie = optarg; break;
+            case 'o': file_esiti = optarg; break;
+            case 'T':
+                for (tipo = G11_TIPO_INT32; tipo <= G11_TIPO_GRANDE && strcmp(optarg, g11_nome_tipo(tipo)) != 0; tipo++);
+                if (tipo <= G11_TIPO_GRANDE) break;
+                fprintf(stderr, "Errore: tipo sconosciuto '%s'\n", optarg);
+                exit(0);
+            default:
+                if (g11_carico_opzione(&carico, opt, optarg) > 0) break;
+                fprintf(stderr, USO, argv[0]);
+                exit(0);
+        }
+    }
+    argv += optind - 1; // Gli argomenti posizionali tornano in argv[1] e argv[2]
+    argc -= optind - 1;
+
     // Controlla che siano stati forniti hostname e porta del server come argomenti
     if (argc < 3) {
-        fprintf(stderr, "Uso: %s hostname porta\n", argv[0]); // Stampa il corretto utilizzo del programma
-        exit(0);                                             // Termina se gli argomenti sono insufficienti
+        fprintf(stderr, USO, argv[0]); // Stampa il corretto utilizzo del programma
+        exit(0);                                                  // Termina se gli argomenti sono insufficienti
+    }
+    if (flusso != 0 && (strchr("ASMD", flusso) == NULL || file_coppie == NULL || file_esiti == NULL)) {
+        fprintf(stderr, "Errore: il flusso richiede un'operazione tra A, S, M, D e i file -i e -o\n");
+        exit(0);
+    }
+    if (lotto < 1 || lotto > (long) G11_MAX_LOTTO) {
+        fprintf(stderr, "Errore: il lotto deve contenere tra 1 e %u coppie\n", G11_MAX_LOTTO);
+        exit(0);
     }
 
-    int sockfd, portno, n;                  // Descrittore del socket, numero di porta, variabile per valori di ritorno
+    int portno;                             // Numero di porta
+    struct g11_calc *cl;                    // Connessione gestita dalla libreria client
     struct sockaddr_in serv_addr;           // Struttura per l'indirizzo del server
     struct hostent *server;                 // Struttura per memorizzare informazioni sull'host (come l'indirizzo IP)
-    char buffer[256];                       // Buffer per la comunicazione
 
     portno = atoi(argv[2]); // Converte il numero di porta da stringa a intero
 
-    // 1. Creazione del socket TCP
-    // AF_INET per indirizzi IPv4, SOCK_STREAM per TCP.
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) {
-        error("ERRORE apertura socket"); // Gestisce l'errore se la creazione fallisce
-    }
-
-    // 2. Risoluzione del nome host
+    // 1. Risoluzione del nome host
     // Ottiene le informazioni sul server (incluso l'indirizzo IP) a partire dal suo nome.
     server = gethostbyname(argv[1]);
     if (server == NULL) {
@@ -40,7 +585,7 @@ int main(int argc, char *argv[]) {
         exit(0);
     }
 
-    // 3. Setup dell'indirizzo del server a cui connettersi
+    // 2. Setup dell'indirizzo del server a cui connettersi
     bzero((char *) &serv_addr, sizeof(serv_addr)); // Azzera la struttura dell'indirizzo
     serv_addr.sin_family = AF_INET;                // Imposta la famiglia di indirizzi a IPv4
 
@@ -49,69 +594,39 @@ int main(int argc, char *argv[]) {
 
     serv_addr.sin_port = htons(portno); // Converte la porta in network byte order
 
-    // 4. Connessione al server
-    // Tenta di stabilire una connessione TCP con il server all'indirizzo specificato.
-    if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
-        error("ERRORE connessione"); // Gestisce l'errore se la connessione fallisce
-    }
-
-    // 5. Riceve il messaggio di conferma dal server
-    bzero(buffer, 256); // Pulisce il buffer
-    n = read(sockfd, buffer, 255); // Legge il messaggio inviato dal server
-    if (n < 0) {
-        error("ERRORE lettura da socket");
+    // Il generatore di carico apre le proprie connessioni, anche UDP (-P udp)
+    if (carico.attivo) {
+        carico.lotto = (uint32_t) lotto;
+        return g11_carico_esegui(&carico, &serv_addr) == 0 ? 0 : 1;
     }
-    printf("Server: %s\n", buffer); // Stampa il messaggio di conferma
-
-    // 6. Chiede all'utente di inserire un comando
-    char command;
-    printf("Inserisci operazione (A, S, M, D) o altro per terminare: ");
-    scanf(" %c", &command); // Legge un carattere da standard input (lo spazio prima di %c ignora eventuali whitespace)
 
-    // 7. Invia il comando al server
-    n = write(sockfd, &command, 1); // Scrive il singolo carattere del comando sul socket
-    if (n < 0) {
-        error("ERRORE scrittura su socket");
+    // Il flusso usa un proprio socket: coppie ed esiti viaggiano come byte grezzi, senza frame
+    if (flusso != 0) {
+        return esegui_flusso(&serv_addr, flusso, file_coppie, file_esiti);
     }
 
-    // 8. Riceve la risposta del server al comando
-    bzero(buffer, 256); // Pulisce il buffer
-    n = read(sockfd, buffer, 255); // Legge la risposta (es. "ADDIZIONE" o "TERMINE...")
-    if (n < 0) {
-        error("ERRORE lettura stato dal socket");
-    }
-    printf("Stato Server: %s\n", buffer); // Stampa lo stato inviato dal server
-
-    // Controlla se il server ha inviato un messaggio di terminazione
-    if (strstr(buffer, "TERMINE") != NULL) {
-        printf("Processo terminato come richiesto.\n");
-        close(sockfd); // Chiude il socket
-        return 0;      // Termina il client
+    // 3. Connessione al server tramite la libreria client (common/libcalc_G11.h): una sola connessione
+    // persistente; in sessione le righe con la stessa operazione vengono riunite in lotti di al più 'lotto' coppie
+    cl = g11_calc_crea(&serv_addr, 1, 1, sessione && espressione == NULL ? (uint32_t) lotto : 1);
+    if (cl == NULL) {
+        error("ERRORE connessione"); // Gestisce l'errore se la connessione fallisce
     }
-
-    // Se il comando è valido, chiede i numeri all'utente
-    int numbers[2];
-    printf("Inserisci primo intero: ");
-    scanf("%d", &numbers[0]);
-    printf("Inserisci secondo intero: ");
-    scanf("%d", &numbers[1]);
-
-    // 9. Invia i due interi al server
-    // Scrive sul socket l'array di interi.
-    n = write(sockfd, numbers, sizeof(int) * 2);
-    if (n < 0) {
-        error("ERRORE scrittura interi su socket");
+    if (!sessione && espressione == NULL) {
+        printf("Server: connessione avvenuta\n");
     }
 
-    // 10. Riceve il risultato del calcolo
-    int result;
-    n = read(sockfd, &result, sizeof(int)); // Legge il risultato intero inviato dal server
-    if (n < 0) {
-        error("ERRORE lettura risultato da socket");
+    // 4. Scambio delle richieste sulla connessione persistente
+    if (espressione != NULL) {
+        esegui_espressione(cl, espressione, lotto > 1 ? (uint32_t) lotto : MAX_IN_VOLO);
+    } else if (sessione && tipo != G11_TIPO_INT32) {
+        esegui_sessione_tipizzata(cl, tipo);
+    } else if (sessione) {
+        esegui_sessione(cl);
+    } else {
+        esegui_interattivo(cl, tipo);
     }
-    printf("Risultato ricevuto dal server: %d\n", result); // Stampa il risultato
 
-    // 11. Chiude la connessione
-    close(sockfd);
+    // 5. Chiude la connessione
+    g11_calc_chiudi(cl);
     return 0; // Termina il programma con successo
-}
\ No newline at end of file
+}
@@ -1,136 +1,1426 @@
+#define _GNU_SOURCE             // Necessario per accept4, per le estensioni Linux di epoll e per l'affinità dei thread
+#include <stddef.h>     // offsetof
+#include <stdint.h>     // Tipi a dimensione fissa
 #include <stdio.h>      // Libreria standard per l'input/output, usata per funzioni come printf e perror
 #include <stdlib.h>     // Libreria standard per funzioni di utilità generale, come atoi ed exit
-#include <string.h>     // Libreria per la manipolazione di stringhe, usata per bzero e strcpy
+#include <string.h>     // Libreria per la manipolazione di stringhe, usata per bzero e memmove
 #include <unistd.h>     // Fornisce accesso alle API POSIX, qui usata per read, write e close
+#include <errno.h>      // Codici di errore (EAGAIN, EINTR) necessari per l'I/O non bloccante
+#include <signal.h>     // Gestione dei segnali (SIGPIPE va ignorato se il client chiude durante una write)
+#include <pthread.h>    // Thread lavoratori, uno per core
+#include <sched.h>      // Affinità dei thread ai core (CPU pinning)
+#include <sys/epoll.h>  // Interfaccia epoll per il ciclo ad eventi
+#include <sys/resource.h> // getrlimit/setrlimit per alzare il numero massimo di descrittori aperti
+#include <netinet/tcp.h>  // Opzione TCP_NODELAY
 #include <arpa/inet.h>  // Definisce la struttura sockaddr_in e le funzioni di manipolazione degli indirizzi IP come htons
+#include "../common/protocollo_G11.h" // Formato dei frame condiviso con i client
+#include "../common/calcolo_G11.h"    // Esecuzione delle operazioni
+#include "../common/memo_G11.h"       // Cache dei risultati per lavoratore (-M)
+#include "../common/pool_G11.h"       // Lastre delle connessioni e pool dei buffer di ogni lavoratore
+#include "../common/ammissione_G11.h" // Limite di richieste al secondo per client (-r, -B)
+#include "../common/metriche_G11.h"   // Contatori e istogrammi per thread, porta delle metriche (-m)
+#include "../common/uring_G11.h"      // Motore di I/O alternativo basato su io_uring (-e uring)
+#include "../common/log_G11.h"        // Registro asincrono: nessuna scrittura su stdio nei lavoratori
+#include "../common/servizio_G11.h"   // Arresto ordinato, ricarica della configurazione, passaggio dei socket
+
+#define MAX_EVENTI 256              // Numero massimo di eventi restituiti da una singola epoll_wait
+#define BACKLOG_PREDEFINITO SOMAXCONN // Dimensione predefinita della coda di connessioni in attesa (modificabile con -b)
+#define MAX_LAVORATORI 256          // Numero massimo di thread lavoratori (-t)
+#define DIM_BUFFER 16384            // Dimensione iniziale dei buffer di ingresso e uscita di ogni connessione
+#define BUFFER_PREALLOCATI (256u << 10) // Classi di buffer preallocate all'avvio di ogni lavoratore (due per classe)
+#define BUFFER_TRATTENUTI (64u << 20)   // Byte di buffer liberi che un lavoratore conserva per riusarli
+#define CONTROLLO_MS 250            // Intervallo massimo tra due controlli di scadenze (-I, -W) e arresto
+#define ARRESTO_INATTIVE_MS 100     // Durante l'arresto si chiudono le connessioni inattive da tanto
+#define DRENAGGIO_PREDEFINITO 30    // Secondi concessi all'arresto ordinato (-D)
+#define URING_VOCI 1024             // Posti nella coda di sottomissione dell'anello di ogni lavoratore
+#define URING_VOCI_CQ 8192          // Posti nella coda di completamento (recv multishot ne producono molti)
+#define URING_BUFFER 1024           // Buffer forniti al kernel per le ricezioni, per lavoratore
+#define URING_DIM_BUFFER 4096       // Dimensione di ciascun buffer fornito
+#define URING_GRUPPO 0              // Gruppo dell'anello di buffer
+
+// Tipo di operazione nei 2 bit bassi di user_data; il resto è il puntatore alla connessione (allineato a 16)
+// oppure, per le accept, l'indice del socket di ascolto nell'elenco del lavoratore
+enum { URING_ACCETTA, URING_RICEVI, URING_INVIA, URING_ANNULLA };
+#define URING_DATO(c, tipo) ((uint64_t) (uintptr_t) (c) | (tipo))
+#define URING_ASCOLTO(i) ((uint64_t) (i) << 2 | URING_ACCETTA)
+#define URING_TIPO(dato) ((int) ((dato) & 3))
+#define URING_CONNESSIONE(dato) ((struct connessione *) (uintptr_t) ((dato) & ~(uint64_t) 3))
+
+// Liste delle connessioni per le scadenze, in ordine di ultima attività: le inattive non aspettano nulla,
+// quelle in attesa hanno un frame ricevuto a metà, risposte non ancora inviate o un flusso in corso.
+enum { LISTA_INATTIVE, LISTA_IN_ATTESA, LISTE };
+
+struct lista_connessioni {
+    struct connessione *testa;       // Attività meno recente
+    struct connessione *coda;        // Attività più recente
+};
+
+// Stato di una singola connessione. Viene puntato da epoll_event.data.ptr,
+// quindi ogni evento porta direttamente alla connessione senza ricerche.
+// La connessione è persistente: il client invia frame di richiesta uno dopo l'altro (anche in pipeline)
+// e il server risponde nello stesso ordine, riportando l'id di ciascuna richiesta.
+struct connessione {
+    int fd;                          // Descrittore del socket del client
+    int chiusura;                    // Frame non valido: si inviano le risposte pendenti e si chiude
+    int eof;                         // Il client ha chiuso il suo lato della connessione
+    size_t letti;                    // Byte presenti nel buffer di ingresso
+    size_t consumati;                // Byte del buffer di ingresso già elaborati
+    size_t da_inviare;               // Fine dei dati da inviare nel buffer di uscita
+    size_t inviati;                  // Byte del buffer di uscita già inviati
+    unsigned char *in;               // Buffer di ricezione: i frame vengono analizzati qui senza copiarli
+    unsigned char *out;              // Buffer di invio delle risposte
+    size_t dim_in, dim_out;          // Capacità attuale dei due buffer
+    struct g11_metriche *m;          // Metriche del lavoratore che gestisce la connessione
+    struct g11_memo *memo;           // Cache dei risultati del lavoratore
+    struct lavoratore *l;            // Lavoratore proprietario: lastre delle connessioni e pool dei buffer
+    uint64_t flusso;                 // Coppie del flusso in corso ancora da elaborare, 0 = nessun flusso
+    uint8_t flusso_op;               // Operazione del flusso in corso
+    int flusso_scarta;               // Flusso rifiutato: le coppie vengono lette e ignorate
+    uint32_t indirizzo;              // Indirizzo IPv4 del client (network byte order), chiave del limite di tasso
+    uint64_t attivita;               // Istante dell'ultimo progresso in ns, per le scadenze
+    int lista;                       // Lista delle scadenze che contiene la connessione (LISTA_*), -1 nessuna
+    int scaduta;                     // Chiusa per scadenza: attende solo la fine delle operazioni in corso
+    struct connessione *lista_prec, *lista_succ; // Vicine nella lista, dalla meno recente
+    // Stato usato solo dal motore io_uring, dove le operazioni si completano in modo asincrono
+    int ricezione;                   // Recv multishot armata
+    int annullata;                   // Chiesto l'annullamento della recv (uscita piena o chiusura)
+    int invio_in_corso;              // Send in volo: il buffer di uscita non può essere spostato
+    int in_volo;                     // Operazioni non ancora completate: la memoria si libera solo a 0
+    int errore;                      // Errore di I/O: la connessione va chiusa
+    int da_avanzare;                 // Già nella lista delle connessioni da far avanzare
+    struct connessione *prossima;    // Lista delle connessioni da far avanzare
+    // I buffer puntano a queste aree finché i frame sono piccoli; un lotto più grande
+    // usa temporaneamente un buffer del pool del lavoratore.
+    unsigned char in_base[DIM_BUFFER];
+    unsigned char out_base[DIM_BUFFER];
+};
+
+// Ogni lavoratore possiede il proprio socket di ascolto (SO_REUSEPORT) e la propria istanza epoll:
+// il kernel distribuisce le nuove connessioni tra i socket, quindi non serve alcun lock condiviso.
+// Dopo un passaggio da un processo con più lavoratori i socket ricevuti sono di più: ognuno ne serve alcuni.
+struct lavoratore {
+    int id;           // Indice del lavoratore (0..N-1)
+    int *ascolto;     // Socket di ascolto di questo lavoratore
+    int n_ascolto;
+    int epfd;         // Istanza epoll di questo lavoratore (-1 con il motore io_uring)
+    int cpu;          // Core a cui vincolare il thread, -1 se nessuno
+    pthread_t thread; // Thread che esegue il ciclo ad eventi
+    struct g11_metriche *metriche; // Scritte solo da questo thread
+    struct g11_memo memo;          // Partizione della cache dei risultati, usata solo da questo thread
+    struct g11_slab connessioni;   // Lastre da cui vengono prese le strutture delle connessioni
+    struct g11_pool_buffer buffer; // Buffer per i frame più grandi di DIM_BUFFER
+    uint64_t adesso;               // Istante del risveglio corrente del ciclo ad eventi, in ns
+    uint64_t prossimo_controllo;   // Istante del prossimo controllo delle scadenze
+    int in_arresto;                // Non accetta più: termina quando tutte le sue connessioni sono chiuse
+    struct lista_connessioni liste[LISTE];
+};
+
+// Configurazione del server: riga di comando, poi il file -f. Le voci "a caldo" cambiano con SIGHUP mentre
+// il server lavora; le altre determinano lavoratori, memoria e socket, e con SIGHUP passano a un nuovo processo.
+struct configurazione {
+    int backlog;                 // Coda di accept (-b)
+    int n_lavoratori;            // Thread lavoratori (-t)
+    int pinning;                 // Ogni lavoratore vincolato a un core (-c)
+    int porta_metriche;          // Porta locale delle metriche (-m), 0 = disattivata
+    int uring;                   // Motore di I/O: 1 = io_uring, 0 = epoll (-e)
+    char file_log[256];          // File di log (-L), vuoto = stderr
+    int memo_mb;                 // Memoria della cache dei risultati in MB (-M), 0 = disattivata
+    int memo_ammissione;         // Richieste ammesse nella cache (-A)
+    int memo_ttl;                // Validità dei risultati in cache in secondi (-S), 0 = illimitata
+    // A caldo
+    int livello_log;             // Livello minimo dei messaggi registrati (-v)
+    int max_connessioni;         // Connessioni aperte al massimo (-C), 0 = nessun limite
+    double tasso;                // Richieste al secondo per indirizzo del client (-r), 0 = nessun limite
+    int raffica;                 // Richieste ammesse in raffica oltre il tasso (-B), 0 = un secondo di tasso
+    int inattivita;              // Secondi senza attività prima di chiudere una connessione (-I)
+    int stallo;                  // Secondi senza progressi con un frame o risposte in sospeso (-W), 0 = come -I
+    int drenaggio;               // Secondi concessi all'arresto ordinato (-D)
+};
+
+// Limiti modificabili a caldo: scritti dal thread principale, letti dai lavoratori
+static uint32_t max_connessioni;      // Connessioni aperte al massimo in tutto il server, 0 = nessun limite
+static uint64_t scadenza[LISTE];      // Tempo massimo senza progressi per lista, in ns (0 = nessuno)
+static struct g11_tasso limite;       // Secchi di gettoni dei client, condivisi da tutti i lavoratori
+
+static uint32_t connessioni_aperte; // Connessioni aperte da tutti i lavoratori, confrontate con max_connessioni
+static int lavoratori_fermi;        // Lavoratori che durante l'arresto hanno smesso di usare i socket di ascolto
 
 // Funzione per la gestione degli errori. Stampa un messaggio di errore e termina il programma.
+// Usata solo in fase di avvio e per guasti dell'intero ciclo ad eventi: gli errori sulle singole connessioni
+// vengono registrati nel log e chiudono la connessione, non il server.
 void error(const char *msg) {
     perror(msg); // Stampa il messaggio di errore personalizzato seguito da una descrizione dell'errore di sistema
     exit(1);     // Termina il programma con un codice di stato che indica un errore
 }
 
-int main(int argc, char *argv[]) {
-    // Verifica che sia stato fornito il numero di porta come argomento da riga di comando
-    if (argc < 2) {
-        fprintf(stderr, "Errore: porta non fornita\n"); // Stampa un messaggio di errore sullo standard error
-        exit(1);                                       // Termina se la porta non è specificata
+// Alza il limite dei descrittori aperti al massimo consentito, così il server può
+// mantenere decine di migliaia di sessioni contemporanee.
+static void alza_limite_descrittori(void) {
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim); // Se fallisce si continua con il limite corrente
+    }
+}
+
+// Sostituisce un buffer con uno di capacità almeno 'dim' che conserva i byte [inizio, fine) del precedente.
+// Con dim <= DIM_BUFFER torna ad usare l'area interna alla connessione, altrimenti il buffer viene dal pool
+// del lavoratore (o resta lo stesso, compattato, se è già abbastanza grande). Ritorna -1 se manca memoria.
+static int ridimensiona_buffer(struct g11_pool_buffer *pool, unsigned char **buf, size_t *cap, unsigned char *base,
+                               size_t *inizio, size_t *fine, size_t dim) {
+    unsigned char *nuovo = *buf;
+    size_t nuova_cap = *cap;
+    if (dim <= DIM_BUFFER) {
+        nuovo = base;
+        nuova_cap = DIM_BUFFER;
+    } else if (*buf == base || dim > *cap) {
+        nuovo = g11_buffer_prendi(pool, dim, &nuova_cap);
+        if (nuovo == NULL) {
+            return -1;
+        }
+    }
+    memmove(nuovo, *buf + *inizio, *fine - *inizio);
+    if (nuovo != *buf && *buf != base) {
+        g11_buffer_rendi(pool, *buf, *cap);
+    }
+    *fine -= *inizio;
+    *inizio = 0;
+    *buf = nuovo;
+    *cap = nuova_cap;
+    return 0;
+}
+
+// Spazio ancora libero in coda al buffer di uscita. Se serve, sposta in testa i dati non ancora inviati
+// e, quando il buffer è vuoto ma troppo piccolo per la risposta, lo fa crescere.
+// Con una send io_uring in volo il kernel legge ancora il buffer: si può solo accodare dopo i dati presenti.
+static size_t spazio_uscita(struct connessione *c, size_t richiesto) {
+    if (c->invio_in_corso) {
+        return c->dim_out - c->da_inviare;
+    }
+    if (c->dim_out - c->da_inviare < richiesto) {
+        size_t pendenti = c->da_inviare - c->inviati;
+        size_t dim = pendenti == 0 && richiesto > c->dim_out ? richiesto : c->dim_out;
+        if (c->inviati > 0 || dim != c->dim_out) {
+            if (ridimensiona_buffer(&c->l->buffer, &c->out, &c->dim_out, c->out_base, &c->inviati, &c->da_inviare, dim) < 0) {
+                return 0;
+            }
+        }
+    }
+    return c->dim_out - c->da_inviare;
+}
+
+// Tutto il buffer di uscita è stato inviato: riparte dall'inizio.
+static void uscita_svuotata(struct connessione *c) {
+    c->da_inviare = c->inviati = 0;
+    if (c->out != c->out_base) {
+        // La risposta grande è partita: si libera il buffer temporaneo
+        ridimensiona_buffer(&c->l->buffer, &c->out, &c->dim_out, c->out_base, &c->inviati, &c->da_inviare, DIM_BUFFER);
+    }
+}
+
+// Invia la parte rimanente del buffer di uscita.
+// Ritorna 1 se tutto è stato inviato, 0 se il socket non accetta altri dati (EAGAIN), -1 in caso di errore.
+static int invia_pendente(struct connessione *c) {
+    while (c->inviati < c->da_inviare) {
+        G11_METRICA_INIZIO(t0);
+        ssize_t n = write(c->fd, c->out + c->inviati, c->da_inviare - c->inviati);
+        G11_METRICA_FASE(c->m, G11_FASE_SCRITTURA, t0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            G11_LOG_INFO("write fallita su fd %d: %s, connessione chiusa", c->fd, strerror(errno));
+            return -1;
+        }
+        c->inviati += (size_t) n;
+        G11_METRICA_CONTA(c->m, byte_inviati, n);
+    }
+    uscita_svuotata(c);
+    return 1;
+}
+
+// Apre un flusso di coppie grezze: risponde con l'intestazione degli esiti (o con l'errore) e da qui in
+// avanti i byte in ingresso sono coppie, finché non ne sono arrivate n. Un flusso non ammesso dal limite
+// di tasso riceve G11_STATO_OCCUPATO e le sue coppie vengono scartate come quelle di un flusso non valido.
+// Ritorna i byte scritti nel buffer di uscita, 0 se non c'è spazio.
+static size_t avvia_flusso(struct connessione *c, const struct g11_frame *req, int ammesso) {
+    if (spazio_uscita(c, G11_DIM_RISPOSTA_FLUSSO) < G11_DIM_RISPOSTA_FLUSSO) {
+        return 0;
+    }
+    unsigned char *out = c->out + c->da_inviare;
+    uint8_t op;
+    uint64_t n;
+    uint8_t stato = g11_analizza_flusso(req, &op, &n);
+    if (stato == G11_STATO_OK && !ammesso) {
+        stato = G11_STATO_OCCUPATO;
+    }
+    c->flusso = n;
+    c->flusso_op = op;
+    c->flusso_scarta = stato != G11_STATO_OK;
+    if (stato != G11_STATO_OK) {
+        if (req->dim_corpo != G11_DIM_FLUSSO) {
+            c->chiusura = 1; // Numero di coppie sconosciuto: il flusso non è più delimitabile
+        }
+        g11_codifica_risposta(out, stato, req->id, 0);
+        return G11_DIM_RISPOSTA;
+    }
+    g11_scrivi_intestazione(out, G11_DIM_RISPOSTA_FLUSSO, G11_STATO_OK, 0, req->id);
+    g11_scrivi_u64(out + G11_DIM_INTESTAZIONE, n);
+    return G11_DIM_RISPOSTA_FLUSSO;
+}
+
+// Elabora le coppie del flusso già ricevute, a blocchi di G11_FLUSSO_BLOCCO, scrivendo gli esiti nel
+// buffer di uscita senza farlo crescere: la memoria della connessione non dipende dalla lunghezza del flusso.
+// Ritorna 1 se restano coppie complete ma l'uscita è piena, 0 altrimenti.
+static int elabora_flusso(struct connessione *c) {
+    uint64_t coppie = (c->letti - c->consumati) / G11_DIM_COPPIA;
+    if (coppie > c->flusso) {
+        coppie = c->flusso;
+    }
+    if (c->flusso_scarta) {
+        c->consumati += coppie * G11_DIM_COPPIA;
+        c->flusso -= coppie;
+        return 0;
+    }
+    while (coppie > 0) {
+        uint32_t k = coppie < G11_FLUSSO_BLOCCO ? (uint32_t) coppie : G11_FLUSSO_BLOCCO;
+        size_t liberi = spazio_uscita(c, (size_t) k * G11_DIM_ESITO) / G11_DIM_ESITO;
+        if (liberi == 0) {
+            return 1;
+        }
+        if (k > liberi) {
+            k = (uint32_t) liberi;
+        }
+        g11_elabora_coppie(c->flusso_op, c->in + c->consumati, k, c->out + c->da_inviare);
+        G11_METRICA_ESITI(c->m, c->out + c->da_inviare, k);
+        c->da_inviare += (size_t) k * G11_DIM_ESITO;
+        c->consumati += (size_t) k * G11_DIM_COPPIA;
+        c->flusso -= k;
+        coppie -= k;
+    }
+    return 0;
+}
+
+// Verifica il limite di tasso del client per una nuova richiesta (sempre ammessa senza -r).
+static int richiesta_ammessa(struct connessione *c) {
+    return g11_tasso_ammetti(&limite, c->indirizzo, c->l->adesso);
+}
+
+// Elabora tutti i frame completi presenti nel buffer di ingresso, finché c'è spazio per le risposte.
+// Ritorna 1 se nel buffer resta un frame completo non ancora elaborato (uscita piena), 0 altrimenti.
+static int elabora_frame(struct connessione *c) {
+    int restano = 0;
+    uint32_t elaborati = 0;
+    G11_METRICA_INIZIO(t0);
+
+    while (!c->chiusura) {
+        if (c->flusso > 0) {
+            if (elabora_flusso(c)) {
+                restano = 1; // Uscita piena: si riprende dopo l'invio
+                break;
+            }
+            if (c->flusso > 0) {
+                break;       // Il resto del flusso non è ancora arrivato
+            }
+            continue;
+        }
+        struct g11_frame req;
+        int esito = g11_analizza_frame(c->in + c->consumati, c->letti - c->consumati, G11_MAX_FRAME, &req);
+        if (esito == G11_FRAME_INCOMPLETO) {
+            break; // Lettura parziale: il frame verrà completato dai prossimi byte
+        }
+        if (esito == G11_FRAME_ERRATO) {
+            c->chiusura = 1; // Lunghezza non valida: il flusso non è più delimitabile
+            G11_LOG_AVVISO("frame non valido su fd %d, connessione chiusa dopo le risposte pendenti", c->fd);
+            G11_METRICA_CONTA(c->m, frame_scartati, 1);
+            break;
+        }
+        int flusso = req.codice == G11_OP_FLUSSO && req.versione == G11_VERSIONE;
+        size_t serve = flusso ? G11_DIM_RISPOSTA_FLUSSO : g11_dim_risposta(&req);
+        size_t spazio = spazio_uscita(c, serve);
+        if (spazio < serve) {
+            restano = 1; // Buffer di uscita pieno: si riprende dopo l'invio
+            break;
+        }
+        // Lo spazio per la risposta c'è: la richiesta verrà servita ora, quindi può consumare il suo gettone
+        int ammessa = richiesta_ammessa(c);
+        int memo = G11_MEMO_SPENTA;
+        size_t scritti;
+        if (flusso) {
+            scritti = avvia_flusso(c, &req, ammessa);
+        } else if (!ammessa) {
+            g11_codifica_risposta(c->out + c->da_inviare, G11_STATO_OCCUPATO, req.id, 0);
+            scritti = G11_DIM_RISPOSTA;
+        } else {
+            scritti = g11_memo_elabora(c->memo, &req, c->out + c->da_inviare, spazio, &memo);
+        }
+        if (ammessa) {
+            G11_METRICA_CONTA(c->m, memo_trovate, memo == G11_MEMO_TROVATA);
+            G11_METRICA_CONTA(c->m, memo_mancate, memo == G11_MEMO_MANCATA);
+            G11_METRICA_RICHIESTA(c->m, &req, c->out + c->da_inviare);
+        } else {
+            G11_METRICA_CONTA(c->m, rifiuti[G11_RIF_TASSO], 1);
+        }
+        c->da_inviare += scritti;
+        c->consumati += req.lunghezza;
+        elaborati++;
+    }
+    if (elaborati > 0) {
+        G11_METRICA_VALORE(c->m, coda, elaborati);
+        G11_METRICA_FASE(c->m, G11_FASE_ELABORAZIONE, t0);
+    }
+    return restano;
+}
+
+// Prepara il buffer di ingresso per la prossima lettura. L'eventuale frame parziale viene spostato
+// in testa solo quando non c'è più spazio dopo di esso; se il frame annunciato non entra nel buffer,
+// il buffer cresce fino alla sua lunghezza (al massimo G11_MAX_FRAME). Ritorna -1 se manca memoria.
+static int prepara_ingresso(struct connessione *c) {
+    size_t parziale = c->letti - c->consumati;
+    // Durante un flusso arrivano coppie grezze, non frame: non c'è una lunghezza da rispettare
+    size_t annunciata = c->flusso > 0 ? 0 : g11_lunghezza_annunciata(c->in + c->consumati, parziale);
+    size_t dim = c->dim_in;
+
+    if (annunciata > G11_MAX_FRAME) {
+        return -1;          // Lunghezza fuori dai limiti del protocollo: il flusso non è valido
+    }
+    if (annunciata > c->dim_in) {
+        dim = annunciata;   // Lotto più grande del buffer: si prepara lo spazio per riceverlo tutto
+    } else if (c->in != c->in_base && annunciata <= DIM_BUFFER && parziale <= DIM_BUFFER) {
+        dim = DIM_BUFFER;   // Il lotto grande è stato elaborato: si torna al buffer interno
+    }
+    if (dim != c->dim_in || parziale == 0 || c->letti == c->dim_in ||
+        (annunciata > 0 && c->dim_in - c->consumati < annunciata)) {
+        return ridimensiona_buffer(&c->l->buffer, &c->in, &c->dim_in, c->in_base, &c->consumati, &c->letti, dim);
+    }
+    return 0;
+}
+
+// Fa avanzare la connessione finché il socket lo consente: elabora le richieste, invia le risposte
+// e legge altri dati. Quando il buffer di uscita è pieno smette di leggere (backpressure)
+// e riprende al successivo evento EPOLLOUT.
+// Ritorna 0 se la connessione resta aperta in attesa di nuovi eventi, -1 se va chiusa.
+static int gestisci_connessione(struct connessione *c) {
+    for (;;) {
+        int restano = elabora_frame(c);
+        int esito = invia_pendente(c);
+        if (esito < 0) return -1;
+        if (esito == 0 && restano) return 0; // Uscita piena: si attende EPOLLOUT prima di leggere altro
+        if (restano) continue;               // Uscita svuotata: si elaborano i frame rimasti
+
+        if (c->chiusura || c->eof) {
+            // Nessun altro frame arriverà: si chiude dopo aver inviato tutte le risposte
+            return esito == 0 ? 0 : -1;
+        }
+
+        if (prepara_ingresso(c) < 0) {
+            G11_LOG_AVVISO("memoria insufficiente per il buffer di fd %d, connessione chiusa", c->fd);
+            return -1;
+        }
+
+        G11_METRICA_INIZIO(t0);
+        ssize_t n = read(c->fd, c->in + c->letti, c->dim_in - c->letti);
+        G11_METRICA_FASE(c->m, G11_FASE_LETTURA, t0);
+        if (n > 0) {
+            c->letti += (size_t) n;
+            G11_METRICA_CONTA(c->m, byte_ricevuti, n);
+        } else if (n == 0) {
+            c->eof = 1; // Il client ha chiuso il suo lato: si risponde alle richieste già arrivate
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        } else if (errno != EINTR) {
+            G11_LOG_INFO("read fallita su fd %d: %s, connessione chiusa", c->fd, strerror(errno));
+            return -1;
+        }
+    }
+}
+
+// Toglie la connessione dalla sua lista delle scadenze.
+static void togli_da_lista(struct connessione *c) {
+    if (c->lista < 0) {
+        return;
     }
+    struct lista_connessioni *li = &c->l->liste[c->lista];
+    if (c->lista_prec != NULL) c->lista_prec->lista_succ = c->lista_succ; else li->testa = c->lista_succ;
+    if (c->lista_succ != NULL) c->lista_succ->lista_prec = c->lista_prec; else li->coda = c->lista_prec;
+    c->lista = -1;
+}
 
-    int sockfd, newsockfd, portno;              // Descrittori per i socket e variabile per la porta
-    struct sockaddr_in serv_addr, cli_addr;     // Strutture per l'indirizzo del server e del client
-    socklen_t clilen;                           // Lunghezza della struttura dell'indirizzo del client
-    int n;                                      // Variabile per i valori di ritorno delle chiamate di sistema (read/write)
+// Registra un progresso della connessione: passa in coda alla lista che corrisponde al suo stato, così
+// ogni lista resta ordinata dall'attività meno recente e il controllo delle scadenze ne guarda solo la testa.
+static void segna_attivita(struct connessione *c) {
+    struct lavoratore *l = c->l;
+    togli_da_lista(c);
+    int in_attesa = c->letti > c->consumati || c->da_inviare > c->inviati || c->flusso > 0;
+    struct lista_connessioni *li = &l->liste[in_attesa ? LISTA_IN_ATTESA : LISTA_INATTIVE];
+    c->lista = in_attesa ? LISTA_IN_ATTESA : LISTA_INATTIVE;
+    c->attivita = l->adesso;
+    c->lista_succ = NULL;
+    c->lista_prec = li->coda;
+    if (li->coda != NULL) li->coda->lista_succ = c; else li->testa = c;
+    li->coda = c;
+}
 
-    // 1. Creazione del socket TCP
+static void chiudi_connessione(struct connessione *c) {
+    G11_METRICA_CONTA(c->m, connessioni_chiuse, 1);
+    G11_LOG_DEBUG("connessione chiusa: fd %d", c->fd);
+    togli_da_lista(c);
+    __atomic_sub_fetch(&connessioni_aperte, 1, __ATOMIC_RELAXED);
+    close(c->fd); // La chiusura rimuove automaticamente il descrittore dall'insieme di epoll
+    if (c->in != c->in_base) g11_buffer_rendi(&c->l->buffer, c->in, c->dim_in);
+    if (c->out != c->out_base) g11_buffer_rendi(&c->l->buffer, c->out, c->dim_out);
+    g11_slab_rendi(&c->l->connessioni, c);
+}
+
+// Risponde G11_STATO_OCCUPATO (id 0) a una connessione oltre il limite e la chiude. I byte che il client
+// ha già inviato vengono scartati: chiudendo con dati non letti il kernel invierebbe un reset, che può
+// far perdere al client la risposta.
+static void rifiuta_connessione(int fd) {
+    unsigned char risposta[G11_DIM_RISPOSTA];
+    g11_codifica_risposta(risposta, G11_STATO_OCCUPATO, 0, 0);
+    if (send(fd, risposta, sizeof(risposta), MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+        G11_LOG_DEBUG("risposta di rifiuto non inviata su fd %d: %s", fd, strerror(errno));
+    }
+    shutdown(fd, SHUT_WR);
+    recv(fd, NULL, 1u << 16, MSG_TRUNC | MSG_DONTWAIT);
+    close(fd);
+}
+
+// Crea lo stato di una connessione appena accettata da 'indirizzo'. Oltre il limite di connessioni la
+// connessione viene rifiutata; in quel caso, o se manca memoria, il socket viene chiuso e si ritorna NULL.
+static struct connessione *nuova_connessione(int fd, struct lavoratore *l, uint32_t indirizzo) {
+    static const int uno = 1;
+    uint32_t aperte = __atomic_add_fetch(&connessioni_aperte, 1, __ATOMIC_RELAXED);
+    uint32_t massimo = __atomic_load_n(&max_connessioni, __ATOMIC_RELAXED);
+    if (massimo > 0 && aperte > massimo) {
+        __atomic_sub_fetch(&connessioni_aperte, 1, __ATOMIC_RELAXED);
+        G11_METRICA_CONTA(l->metriche, rifiuti[G11_RIF_CONNESSIONI], 1);
+        rifiuta_connessione(fd);
+        return NULL;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &uno, sizeof(uno));
+
+    // Dalle lastre del lavoratore, senza azzerarla: i buffer vengono toccati solo quando servono davvero
+    struct connessione *c = g11_slab_prendi(&l->connessioni);
+    if (c == NULL) {
+        __atomic_sub_fetch(&connessioni_aperte, 1, __ATOMIC_RELAXED);
+        close(fd);
+        return NULL;
+    }
+    memset(c, 0, offsetof(struct connessione, in_base)); // Azzera solo l'intestazione, non i buffer
+    c->fd = fd;
+    c->indirizzo = indirizzo;
+    c->lista = -1;
+    c->in = c->in_base;
+    c->out = c->out_base;
+    c->dim_in = c->dim_out = DIM_BUFFER;
+    c->m = l->metriche;
+    c->memo = &l->memo;
+    c->l = l;
+    segna_attivita(c);
+    G11_METRICA_CONTA(c->m, connessioni_accettate, 1);
+    G11_LOG_DEBUG("connessione accettata: fd %d", fd);
+    return c;
+}
+
+// Accetta tutte le connessioni in coda sui socket di ascolto del lavoratore (non bloccante).
+static void accetta_connessioni(struct lavoratore *l) {
+    struct sockaddr_in cli_addr;
+    socklen_t clilen;
+
+    for (int s = 0; s < l->n_ascolto; ) {
+        clilen = sizeof(cli_addr);
+        int newsockfd = accept4(l->ascolto[s], (struct sockaddr *) &cli_addr, &clilen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (newsockfd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                // Es. EMFILE: si riprova al prossimo evento, il server non termina
+                G11_LOG_AVVISO("accept fallita: %s", strerror(errno));
+            }
+            s++; // Coda vuota: si passa al socket successivo
+            continue;
+        }
+        struct connessione *c = nuova_connessione(newsockfd, l, cli_addr.sin_addr.s_addr);
+        if (c == NULL) {
+            continue;
+        }
+
+        // Registrazione edge-triggered: la macchina a stati consuma ogni evento fino a EAGAIN
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = c;
+        if (epoll_ctl(l->epfd, EPOLL_CTL_ADD, newsockfd, &ev) < 0) {
+            G11_LOG_ERRORE("epoll_ctl fallita su fd %d: %s", c->fd, strerror(errno));
+            chiudi_connessione(c);
+        }
+    }
+}
+
+// Crea un socket di ascolto non bloccante sulla porta indicata.
+// Con SO_REUSEPORT più socket possono condividere la stessa porta, uno per lavoratore.
+static int crea_socket_ascolto(int portno, int backlog) {
+    struct sockaddr_in serv_addr; // Struttura per l'indirizzo del server
+    int uno = 1;
+
+    // 1. Creazione del socket TCP non bloccante
     // AF_INET indica che useremo indirizzi IPv4.
     // SOCK_STREAM specifica che il socket sarà di tipo TCP (orientato alla connessione).
-    // Il terzo argomento, 0, lascia al sistema la scelta del protocollo appropriato (TCP in questo caso).
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    int sockfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (sockfd < 0) {
         error("ERRORE apertura socket"); // Se la creazione fallisce, chiama la funzione di errore
     }
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &uno, sizeof(uno)); // Riavvio immediato anche con connessioni in TIME_WAIT
+    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &uno, sizeof(uno)) < 0) {
+        error("ERRORE in SO_REUSEPORT");
+    }
 
     // 2. Setup dell'indirizzo del server
     bzero((char *) &serv_addr, sizeof(serv_addr)); // Inizializza la struttura dell'indirizzo a zero
-    portno = atoi(argv[1]);                        // Converte il numero di porta da stringa a intero
-
     serv_addr.sin_family = AF_INET;                // Imposta la famiglia di indirizzi a IPv4
     serv_addr.sin_addr.s_addr = INADDR_ANY;        // Accetta connessioni da qualsiasi interfaccia di rete del server
     serv_addr.sin_port = htons(portno);            // Converte il numero di porta in network byte order (big-endian)
 
     // 3. Binding del socket all'indirizzo e alla porta specificati
-    // Associa il socket 'sockfd' all'indirizzo 'serv_addr'.
     if (bind(sockfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0) {
         error("ERRORE in binding"); // Se il binding fallisce (es. porta già in uso), chiama la funzione di errore
     }
 
-    // 4. Mette il server in ascolto di connessioni in ingresso
-    // Il secondo argomento, 5, è la dimensione della coda di connessioni in attesa.
-    listen(sockfd, 5);
-    printf("Server TCP avviato sulla porta %d...\n", portno);
+    // 4. Mette il server in ascolto con la coda configurata
+    if (listen(sockfd, backlog) < 0) {
+        error("ERRORE in listen");
+    }
+    return sockfd;
+}
 
-    // Ciclo infinito per accettare e gestire le connessioni dei client (server iterativo)
-    while (1) {
-        clilen = sizeof(cli_addr); // Imposta la dimensione della struttura dell'indirizzo del client
+// Prepara un socket di ascolto ricevuto dal processo precedente (o da systemd): non bloccante come quelli
+// creati qui, con la coda configurata (listen su un socket già in ascolto cambia solo la coda).
+// Ritorna 1 se il socket ha SO_REUSEPORT, cioè se se ne possono aggiungere altri sulla stessa porta.
+static int prepara_socket_ereditato(int sockfd, int backlog) {
+    int riuso = 0;
+    socklen_t dim = sizeof(riuso);
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+    if (listen(sockfd, backlog) < 0) {
+        error("ERRORE in listen sul socket ricevuto");
+    }
+    return getsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &riuso, &dim) == 0 && riuso;
+}
 
-        // 5. Accetta una nuova connessione
-        // Estrae la prima richiesta di connessione dalla coda e crea un nuovo socket per comunicare con il client.
-        // La chiamata è bloccante: il programma si ferma qui finché un client non si connette.
-        newsockfd = accept(sockfd, (struct sockaddr *) &cli_addr, &clilen);
-        if (newsockfd < 0) {
-            error("ERRORE in accept"); // Se l'accettazione fallisce, chiama la funzione di errore
+// Vincola il thread del lavoratore al suo core, se richiesto con -c
+static void vincola_cpu(struct lavoratore *l) {
+    if (l->cpu >= 0) {
+        cpu_set_t insieme;
+        CPU_ZERO(&insieme);
+        CPU_SET(l->cpu, &insieme);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(insieme), &insieme) != 0) {
+            G11_LOG_AVVISO("lavoratore %d: impossibile vincolare il thread alla CPU %d", l->id, l->cpu);
         }
+    }
+}
 
-        // 6. Invia un messaggio di conferma al client
-        // Informa il client che la connessione è stata stabilita con successo.
-        n = write(newsockfd, "connessione avvenuta", 20);
-        if (n < 0) {
-            error("ERRORE scrittura socket"); // Gestisce errori di scrittura sul socket
+// Prepara gli allocatori del lavoratore dal suo thread, dopo il vincolo al core: le pagine dei buffer
+// preallocati vengono toccate qui e restano sul nodo NUMA del lavoratore. Da questo punto le richieste
+// non chiamano più malloc né free (con -DG11_CONTA_ALLOC le chiamate del thread vengono contate).
+static void prepara_memoria(struct lavoratore *l) {
+    g11_slab_crea(&l->connessioni, sizeof(struct connessione), G11_SLAB_LASTRA);
+    g11_pool_buffer_crea(&l->buffer, BUFFER_TRATTENUTI);
+    if (g11_buffer_prealloca(&l->buffer, BUFFER_PREALLOCATI, 2) < 0 || g11_espr_prepara() < 0) {
+        error("ERRORE memoria insufficiente per i buffer");
+    }
+    G11_CONTA_ALLOC_IN(&l->metriche->allocazioni, &l->metriche->liberazioni);
+}
+
+// Chiude le connessioni rimaste senza progressi oltre la scadenza della loro lista (-I per le inattive,
+// -W per quelle in attesa di un frame o di inviare risposte). Le liste sono ordinate dall'attività meno
+// recente, quindi il controllo si ferma alla prima connessione ancora valida. La connessione non viene
+// liberata qui: lo shutdown fa fallire le operazioni in corso e la chiusura segue il percorso consueto,
+// sia con epoll sia con le operazioni ancora in volo su io_uring.
+// Durante l'arresto le connessioni inattive da ARRESTO_INATTIVE_MS vengono chiuse allo stesso modo: non hanno
+// richieste in sospeso, e il breve margine lascia arrivare una richiesta appena inviata dal client.
+static void controlla_scadenze(struct lavoratore *l) {
+    if (l->adesso < l->prossimo_controllo) {
+        return;
+    }
+    l->prossimo_controllo = l->adesso + CONTROLLO_MS * 1000000ULL;
+    for (int k = 0; k < LISTE; k++) {
+        int arresto = l->in_arresto && k == LISTA_INATTIVE;
+        uint64_t massimo = arresto ? ARRESTO_INATTIVE_MS * 1000000ULL : __atomic_load_n(&scadenza[k], __ATOMIC_RELAXED);
+        struct connessione *c;
+        while (massimo > 0 && (c = l->liste[k].testa) != NULL && l->adesso - c->attivita > massimo) {
+            if (arresto) {
+                G11_LOG_DEBUG("arresto: fd %d inattiva, connessione chiusa", c->fd);
+            } else {
+                G11_LOG_INFO("fd %d %s da %llu ms: connessione chiusa", c->fd, k == LISTA_IN_ATTESA ? "in stallo" : "inattiva",
+                             (unsigned long long) ((l->adesso - c->attivita) / 1000000));
+                G11_METRICA_CONTA(l->metriche, scadute[k == LISTA_IN_ATTESA ? G11_SCAD_STALLO : G11_SCAD_INATTIVA], 1);
+            }
+            togli_da_lista(c);
+            c->scaduta = 1;
+            c->chiusura = 1; // Le richieste già ricevute non vengono più elaborate
+            shutdown(c->fd, SHUT_RDWR);
+        }
+    }
+}
+
+// Arresto forzato (scaduto -D): chiude come controlla_scadenze tutte le connessioni ancora aperte, con le
+// richieste in sospeso. Il ciclo termina quando l'ultima ha concluso le operazioni in corso.
+static void chiudi_rimaste(struct lavoratore *l) {
+    l->in_arresto = 2;
+    for (int k = 0; k < LISTE; k++) {
+        struct connessione *c;
+        while ((c = l->liste[k].testa) != NULL) {
+            G11_LOG_DEBUG("arresto forzato: fd %d chiusa", c->fd);
+            togli_da_lista(c);
+            c->scaduta = 1;
+            c->chiusura = 1;
+            shutdown(c->fd, SHUT_RDWR);
         }
+    }
+}
 
-        // 7. Riceve il comando dal client
-        char command;
-        // Legge un singolo byte (il carattere del comando) dal socket del client.
-        n = read(newsockfd, &command, 1);
+// Inizio dell'arresto ordinato: il lavoratore smette di accettare (il socket resta aperto, può essere
+// condiviso con altri lavoratori o con il nuovo processo) e controlla subito le connessioni inattive.
+static void smetti_di_accettare(struct lavoratore *l) {
+    l->in_arresto = 1;
+    l->prossimo_controllo = 0;
+    for (int s = 0; s < l->n_ascolto; s++) {
+        epoll_ctl(l->epfd, EPOLL_CTL_DEL, l->ascolto[s], NULL);
+    }
+    __atomic_add_fetch(&lavoratori_fermi, 1, __ATOMIC_RELEASE);
+}
+
+// Ciclo ad eventi di un lavoratore: nessuna chiamata è bloccante tranne epoll_wait,
+// quindi un client lento non ferma più gli altri. Termina dopo l'arresto, chiusa l'ultima connessione.
+static void *ciclo_lavoratore(void *arg) {
+    struct lavoratore *l = arg;
+    struct epoll_event eventi[MAX_EVENTI];
+
+    vincola_cpu(l);
+    prepara_memoria(l);
+
+    while (!l->in_arresto || l->connessioni.presi > 0) {
+        // Risveglio almeno ogni CONTROLLO_MS anche senza eventi, per le scadenze e per l'arresto
+        int n = epoll_wait(l->epfd, eventi, MAX_EVENTI, CONTROLLO_MS);
         if (n < 0) {
-            error("ERRORE lettura socket"); // Gestisce errori di lettura dal socket
+            if (errno == EINTR) continue;
+            error("ERRORE in epoll_wait");
+        }
+        l->adesso = g11_tasso_adesso();
+        for (int i = 0; i < n; i++) {
+            struct connessione *c = eventi[i].data.ptr;
+            if (c == NULL) {
+                accetta_connessioni(l);
+                continue;
+            }
+            // Errori e chiusure vengono rilevati dalla read/write nella macchina a stati
+            if (gestisci_connessione(c) < 0) {
+                chiudi_connessione(c);
+            } else if (!c->scaduta) {
+                segna_attivita(c);
+            }
+        }
+        if (!l->in_arresto && g11_in_arresto()) {
+            smetti_di_accettare(l);
         }
+        if (l->in_arresto == 1 && g11_arresto_forzato()) {
+            chiudi_rimaste(l);
+        }
+        controlla_scadenze(l);
+    }
+    close(l->epfd);
+    return NULL;
+}
 
-        char response_msg[100]; // Buffer per il messaggio di risposta
-        int valid_op = 1;       // Flag per indicare se l'operazione richiesta è valida
+// --- Motore io_uring (-e uring) ---
+// Ogni lavoratore ha un proprio anello. Una accept multishot resta armata su ogni socket di ascolto e ogni
+// connessione ha una recv multishot che preleva i buffer dall'anello dei buffer forniti; le send di tutte
+// le connessioni preparate in un giro vengono consegnate insieme. Una sola io_uring_enter per giro invia
+// le nuove richieste e raccoglie i completamenti, quindi sotto carico le chiamate di sistema per
+// richiesta scendono ben sotto una.
+struct motore_uring {
+    struct g11_uring anello;
+    struct g11_buffer_forniti buffer;
+    struct connessione *da_avanzare; // Connessioni toccate dai completamenti di questo giro
+    struct lavoratore *l;
+    struct __kernel_timespec attesa; // Intervallo del timer che risveglia il ciclo per scadenze e arresto
+    int timer;                       // Timer armato e non ancora scaduto
+};
 
-        // 8. Interpreta il comando e prepara una risposta
-        switch(command) {
-            case 'A': case 'a': strcpy(response_msg, "ADDIZIONE"); break;
-            case 'S': case 's': strcpy(response_msg, "SOTTRAZIONE"); break;
-            case 'M': case 'm': strcpy(response_msg, "MOLTIPLICAZIONE"); break;
-            case 'D': case 'd': strcpy(response_msg, "DIVISIONE"); break;
-            default:
-                // Se il comando non è uno dei precedenti, il client verrà terminato
-                strcpy(response_msg, "TERMINE PROCESSO CLIENT");
-                valid_op = 0; // Imposta il flag a 0 per indicare un'operazione non valida
-        }
-
-        // Invia la risposta testuale (es. "ADDIZIONE" o "TERMINE PROCESSO CLIENT")
-        n = write(newsockfd, response_msg, strlen(response_msg) + 1); // +1 per includere il terminatore nullo
-
-        // Se l'operazione è valida, procede a ricevere i numeri ed eseguire il calcolo
-        if (valid_op) {
-            int numbers[2];
-            // 9. Riceve i due interi dal client
-            // Legge 2 * sizeof(int) byte dal socket, che corrispondono ai due numeri.
-            n = read(newsockfd, numbers, sizeof(int) * 2);
-            if (n < 0) {
-                error("ERRORE lettura interi"); // Gestisce errori di lettura
+static void segna_connessione(struct motore_uring *mu, struct connessione *c) {
+    if (!c->da_avanzare) {
+        c->da_avanzare = 1;
+        c->prossima = mu->da_avanzare;
+        mu->da_avanzare = c;
+    }
+}
+
+static int arma_accettazione(struct motore_uring *mu, int indice) {
+    struct io_uring_sqe *s = g11_uring_sqe(&mu->anello);
+    if (s == NULL) return -1;
+    g11_prep_accetta_multishot(s, mu->l->ascolto[indice], URING_ASCOLTO(indice));
+    return 0;
+}
+
+static int arma_ricezione(struct motore_uring *mu, struct connessione *c) {
+    struct io_uring_sqe *s = g11_uring_sqe(&mu->anello);
+    if (s == NULL) return -1;
+    g11_prep_ricevi_multishot(s, c->fd, mu->buffer.gruppo, URING_DATO(c, URING_RICEVI));
+    c->ricezione = 1;
+    c->in_volo++;
+    return 0;
+}
+
+static int arma_invio(struct motore_uring *mu, struct connessione *c) {
+    struct io_uring_sqe *s = g11_uring_sqe(&mu->anello);
+    if (s == NULL) return -1;
+    g11_prep_invia(s, c->fd, c->out + c->inviati, c->da_inviare - c->inviati, URING_DATO(c, URING_INVIA));
+    c->invio_in_corso = 1;
+    c->in_volo++;
+    return 0;
+}
+
+// Il timer usa il tipo degli annullamenti, che non hanno bisogno del proprio completamento: si riconosce
+// dall'esito -ETIME, che un annullamento non restituisce mai.
+static void arma_timer(struct motore_uring *mu) {
+    struct io_uring_sqe *s = g11_uring_sqe(&mu->anello);
+    if (s != NULL) {
+        g11_prep_timer(s, &mu->attesa, URING_DATO(NULL, URING_ANNULLA));
+        mu->timer = 1;
+    }
+}
+
+static void annulla_ricezione(struct motore_uring *mu, struct connessione *c) {
+    struct io_uring_sqe *s = g11_uring_sqe(&mu->anello);
+    if (s != NULL) {
+        g11_prep_annulla(s, URING_DATO(c, URING_RICEVI), URING_DATO(NULL, URING_ANNULLA));
+        c->annullata = 1;
+    }
+}
+
+// Copia in coda al buffer di ingresso i byte ricevuti in un buffer fornito, facendolo crescere se serve.
+static int accoda_ingresso(struct connessione *c, const unsigned char *dati, size_t n) {
+    if (c->dim_in - c->letti < n) {
+        size_t parziale = c->letti - c->consumati;
+        size_t dim = c->dim_in;
+        while (dim < parziale + n) {
+            dim *= 2;
+        }
+        if (ridimensiona_buffer(&c->l->buffer, &c->in, &c->dim_in, c->in_base, &c->consumati, &c->letti, dim) < 0) {
+            return -1;
+        }
+    }
+    memcpy(c->in + c->letti, dati, n);
+    c->letti += n;
+    return 0;
+}
+
+// Equivalente di gestisci_connessione per il motore io_uring: elabora i frame arrivati, prepara la send
+// delle risposte e decide se la ricezione va riarmata, sospesa (uscita piena) o se la connessione è finita.
+// La memoria viene liberata solo quando nessuna operazione sulla connessione è più in volo.
+static void avanza_connessione(struct motore_uring *mu, struct connessione *c) {
+    int restano = 0;
+    if (!c->errore) {
+        restano = elabora_frame(c);
+        if (c->inviati < c->da_inviare && !c->invio_in_corso && arma_invio(mu, c) < 0) {
+            G11_LOG_ERRORE("coda di sottomissione piena, fd %d chiuso", c->fd);
+            c->errore = 1;
+        }
+        if (c->letti == c->consumati || (c->in != c->in_base && c->letti - c->consumati <= DIM_BUFFER)) {
+            ridimensiona_buffer(&c->l->buffer, &c->in, &c->dim_in, c->in_base, &c->consumati, &c->letti, DIM_BUFFER);
+        }
+        if (!c->scaduta) {
+            segna_attivita(c);
+        }
+    }
+
+    int finita = c->errore ||
+                 ((c->chiusura || c->eof) && !restano && !c->invio_in_corso && c->inviati == c->da_inviare);
+    if (finita || restano) {
+        // Chiusura, oppure uscita piena (backpressure): si smette di ricevere finché la send non termina
+        if (c->ricezione && !c->annullata) {
+            annulla_ricezione(mu, c);
+        }
+        if (finita && c->in_volo == 0) {
+            chiudi_connessione(c);
+        }
+        return;
+    }
+    if (!c->ricezione && !c->eof && !c->chiusura && arma_ricezione(mu, c) < 0) {
+        G11_LOG_ERRORE("coda di sottomissione piena, fd %d chiuso", c->fd);
+        c->errore = 1;
+        segna_connessione(mu, c);
+    }
+}
+
+// Aggiorna lo stato della connessione in base a un completamento.
+static void completamento(struct motore_uring *mu, struct io_uring_cqe *cqe, int *restituiti) {
+    struct connessione *c = URING_CONNESSIONE(cqe->user_data);
+    int altri = cqe->flags & IORING_CQE_F_MORE; // La richiesta multishot resta armata
+
+    switch (URING_TIPO(cqe->user_data)) {
+        case URING_ACCETTA:
+            if (cqe->res >= 0) {
+                // La accept multishot non riporta l'indirizzo del client: serve al limite di tasso, che una
+                // ricarica della configurazione può attivare in ogni momento
+                struct sockaddr_in cli_addr = { 0 };
+                socklen_t clilen = sizeof(cli_addr);
+                getpeername(cqe->res, (struct sockaddr *) &cli_addr, &clilen);
+                c = nuova_connessione(cqe->res, mu->l, cli_addr.sin_addr.s_addr);
+                if (c != NULL) {
+                    segna_connessione(mu, c); // Il primo avanzamento arma la ricezione
+                }
+            } else if (cqe->res != -EINTR && cqe->res != -ECONNABORTED && cqe->res != -ECANCELED) {
+                G11_LOG_AVVISO("accept fallita: %s", strerror(-cqe->res)); // Es. EMFILE: si riprova
+            }
+            // Annullata per l'arresto: non si riarma
+            if (!altri && !mu->l->in_arresto && arma_accettazione(mu, (int) (cqe->user_data >> 2)) < 0) {
+                error("ERRORE nel riarmo della accept");
+            }
+            return;
+
+        case URING_RICEVI:
+            if (!altri) {
+                c->ricezione = c->annullata = 0;
+                c->in_volo--;
+            }
+            if (cqe->flags & IORING_CQE_F_BUFFER) {
+                uint16_t id = (uint16_t) (cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+                if (cqe->res > 0) {
+                    if (accoda_ingresso(c, g11_buffer_dati(&mu->buffer, id), (size_t) cqe->res) < 0) {
+                        G11_LOG_AVVISO("memoria insufficiente per il buffer di fd %d, connessione chiusa", c->fd);
+                        c->errore = 1;
+                    }
+                    G11_METRICA_CONTA(c->m, byte_ricevuti, cqe->res);
+                }
+                g11_buffer_restituisci(&mu->buffer, id);
+                (*restituiti)++;
+            }
+            if (cqe->res == 0) {
+                c->eof = 1; // Il client ha chiuso il suo lato: si risponde alle richieste già arrivate
+            } else if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED) {
+                // ENOBUFS: buffer esauriti, la ricezione viene riarmata dopo averli restituiti
+                G11_LOG_INFO("recv fallita su fd %d: %s, connessione chiusa", c->fd, strerror(-cqe->res));
+                c->errore = 1;
             }
+            break;
 
-            // Esegue l'operazione richiesta
-            int result = 0;
-            if (command == 'A' || command == 'a') result = numbers[0] + numbers[1];
-            if (command == 'S' || command == 's') result = numbers[0] - numbers[1];
-            if (command == 'M' || command == 'm') result = numbers[0] * numbers[1];
-            if (command == 'D' || command == 'd') {
-                // Controlla la divisione per zero
-                if(numbers[1] != 0) {
-                    result = numbers[0] / numbers[1];
-                } else {
-                    result = 0; // In caso di divisione per zero, il risultato è 0
+        case URING_INVIA:
+            c->invio_in_corso = 0;
+            c->in_volo--;
+            if (cqe->res < 0) {
+                G11_LOG_INFO("send fallita su fd %d: %s, connessione chiusa", c->fd, strerror(-cqe->res));
+                c->errore = 1;
+            } else {
+                c->inviati += (size_t) cqe->res;
+                G11_METRICA_CONTA(c->m, byte_inviati, cqe->res);
+                if (c->inviati == c->da_inviare) {
+                    uscita_svuotata(c);
                 }
             }
+            break;
 
-            // 10. Invia il risultato del calcolo al client
-            n = write(newsockfd, &result, sizeof(int));
-            if (n < 0) {
-                error("ERRORE scrittura risultato");
+        default:
+            if (cqe->res == -ETIME) {
+                mu->timer = 0; // Timer scaduto: il ciclo controlla le scadenze e lo riarma
             }
+            return; // Esito di un annullamento: conta solo il completamento della recv annullata
+    }
+    segna_connessione(mu, c);
+}
+
+// Inizio dell'arresto con io_uring: annulla le accept multishot, poi come smetti_di_accettare.
+static void smetti_di_accettare_uring(struct motore_uring *mu) {
+    struct lavoratore *l = mu->l;
+    l->in_arresto = 1;
+    l->prossimo_controllo = 0;
+    for (int s = 0; s < l->n_ascolto; s++) {
+        struct io_uring_sqe *sqe = g11_uring_sqe(&mu->anello);
+        if (sqe != NULL) {
+            g11_prep_annulla(sqe, URING_ASCOLTO(s), URING_DATO(NULL, URING_ANNULLA));
         }
+    }
+    g11_uring_invia(&mu->anello, 0); // Annullate prima che il socket possa essere chiuso
+    __atomic_add_fetch(&lavoratori_fermi, 1, __ATOMIC_RELEASE);
+}
 
-        // 11. Chiude la connessione con il client corrente
-        close(newsockfd);
+static void *ciclo_uring(void *arg) {
+    struct motore_uring mu;
+    mu.l = arg;
+    mu.da_avanzare = NULL;
+    mu.attesa.tv_sec = 0;
+    mu.attesa.tv_nsec = CONTROLLO_MS * 1000000LL;
+    mu.timer = 0;
+
+    vincola_cpu(mu.l);
+    prepara_memoria(mu.l);
+
+    // L'anello va creato dal thread che lo usa (IORING_SETUP_SINGLE_ISSUER)
+    int r = g11_uring_crea(&mu.anello, URING_VOCI, URING_VOCI_CQ);
+    if (r == 0) {
+        r = g11_buffer_crea(&mu.anello, &mu.buffer, URING_GRUPPO, URING_BUFFER, URING_DIM_BUFFER);
     }
+    if (r < 0) {
+        errno = -r;
+        error("ERRORE nella creazione dell'anello io_uring");
+    }
+    for (int s = 0; s < mu.l->n_ascolto; s++) {
+        if (arma_accettazione(&mu, s) < 0) {
+            error("ERRORE nella accept io_uring");
+        }
+    }
+
+    while (!mu.l->in_arresto || mu.l->connessioni.presi > 0) {
+        if (!mu.timer) {
+            arma_timer(&mu); // L'attesa dei completamenti non è illimitata: scadenze e arresto vanno controllati
+        }
+        // Consegna le richieste preparate nel giro precedente e attende almeno un completamento
+        r = g11_uring_invia(&mu.anello, 1);
+        if (r < 0 && r != -EINTR && r != -EBUSY && r != -EAGAIN) {
+            errno = -r;
+            error("ERRORE in io_uring_enter");
+        }
+
+        mu.l->adesso = g11_tasso_adesso();
+        int restituiti = 0;
+        struct io_uring_cqe *cqe;
+        while ((cqe = g11_uring_cqe(&mu.anello)) != NULL) {
+            completamento(&mu, cqe, &restituiti);
+            g11_uring_cqe_fatto(&mu.anello);
+        }
+        if (restituiti > 0) {
+            g11_buffer_pubblica(&mu.buffer); // I dati sono stati copiati: i buffer tornano al kernel
+        }
+
+        while (mu.da_avanzare != NULL) {
+            struct connessione *c = mu.da_avanzare;
+            mu.da_avanzare = c->prossima;
+            c->da_avanzare = 0;
+            avanza_connessione(&mu, c);
+        }
+        if (!mu.l->in_arresto && g11_in_arresto()) {
+            smetti_di_accettare_uring(&mu);
+        }
+        if (mu.l->in_arresto == 1 && g11_arresto_forzato()) {
+            chiudi_rimaste(mu.l);
+        }
+        controlla_scadenze(mu.l);
+    }
+    return NULL;
+}
+
+// Restituisce l'elenco delle CPU su cui il processo può girare, usato per il pinning dei lavoratori.
+static int cpu_disponibili(int *cpu, int max) {
+    cpu_set_t insieme;
+    int n = 0;
+    if (sched_getaffinity(0, sizeof(insieme), &insieme) < 0) {
+        return 0;
+    }
+    for (int i = 0; i < CPU_SETSIZE && n < max; i++) {
+        if (CPU_ISSET(i, &insieme)) {
+            cpu[n++] = i;
+        }
+    }
+    return n;
+}
 
-    // 12. Chiude il socket di ascolto (questa parte di codice non viene mai raggiunta a causa del ciclo infinito)
-    close(sockfd);
-    return 0; // Termina il programma (non raggiungibile)
-}
\ No newline at end of file
+static void uso(const char *programma) {
+    fprintf(stderr, "Uso: %s porta [-b backlog] [-t thread] [-c] [-m porta_metriche] [-e epoll|uring]"
+                    " [-L file_log] [-v livello]\n"
+                    "       [-M MB_cache] [-A tutti|costosi|ripetuti] [-S ttl_secondi]\n"
+                    "       [-C max_connessioni] [-r richieste_al_secondo] [-B raffica] [-I secondi_inattivita] [-W secondi_stallo]\n"
+                    "       [-D secondi_arresto] [-f file_configurazione]\n",
+            programma);
+    exit(1);
+}
+
+// Voci del file di configurazione (-f) e opzioni corrispondenti
+static const struct g11_nome_opzione nomi_opzioni[] = {
+    { "backlog", 'b' }, { "thread", 't' }, { "cpu", 'c' }, { "metriche", 'm' }, { "motore", 'e' },
+    { "log", 'L' }, { "livello", 'v' }, { "cache_mb", 'M' }, { "cache_ammissione", 'A' }, { "cache_ttl", 'S' },
+    { "max_connessioni", 'C' }, { "tasso", 'r' }, { "raffica", 'B' }, { "inattivita", 'I' }, { "stallo", 'W' },
+    { "arresto", 'D' }, { NULL, 0 }
+};
+
+static void configurazione_predefinita(struct configurazione *c) {
+    memset(c, 0, sizeof(*c));
+    c->backlog = BACKLOG_PREDEFINITO;
+    c->n_lavoratori = 1;
+    c->memo_ammissione = G11_MEMO_COSTOSI;
+    c->livello_log = G11_LOG_INFO;
+    c->drenaggio = DRENAGGIO_PREDEFINITO;
+}
+
+// Interpreta un'opzione della riga di comando o una voce del file di configurazione. Ritorna 1 se
+// l'opzione è stata riconosciuta, 0 se non esiste, -1 se il valore non è valido. -c sulla riga di comando
+// non ha valore; nel file "cpu" vale 0 o 1.
+static int opzione(struct configurazione *c, int opt, const char *arg) {
+    switch (opt) {
+        case 'b':
+            c->backlog = atoi(arg);
+            if (c->backlog <= 0) c->backlog = BACKLOG_PREDEFINITO;
+            break;
+        case 't': c->n_lavoratori = atoi(arg); break;
+        case 'c': c->pinning = arg == NULL || atoi(arg) != 0; break;
+        case 'm': c->porta_metriche = atoi(arg); break;
+        case 'M': c->memo_mb = atoi(arg); break;
+        case 'S': c->memo_ttl = atoi(arg); break;
+        case 'C': c->max_connessioni = atoi(arg); break;
+        case 'r': c->tasso = atof(arg); break;
+        case 'B': c->raffica = atoi(arg); break;
+        case 'I': c->inattivita = atoi(arg); break;
+        case 'W': c->stallo = atoi(arg); break;
+        case 'D': c->drenaggio = atoi(arg); break;
+        case 'L':
+            if (strlen(arg) >= sizeof(c->file_log)) return -1;
+            strcpy(c->file_log, arg);
+            break;
+        case 'v':
+            c->livello_log = g11_log_livello(arg);
+            if (c->livello_log < 0) return -1;
+            break;
+        case 'A':
+            c->memo_ammissione = g11_memo_politica(arg);
+            if (c->memo_ammissione < 0) return -1;
+            break;
+        case 'e':
+            if (strcmp(arg, "uring") == 0) c->uring = 1;
+            else if (strcmp(arg, "epoll") == 0) c->uring = 0;
+            else return -1;
+            break;
+        default: return 0;
+    }
+    return 1;
+}
+
+static int applica_voce(void *c, int opt, const char *valore) {
+    return opzione(c, opt, valore);
+}
+
+// Controlla la coerenza della configurazione; ritorna il messaggio d'errore oppure NULL.
+static const char *verifica(const struct configurazione *c) {
+    if (c->n_lavoratori <= 0 || c->n_lavoratori > MAX_LAVORATORI) {
+        return "il numero di thread deve essere compreso tra 1 e 256 (-t)";
+    }
+    if (c->memo_mb < 0 || c->memo_ttl < 0) {
+        return "memoria e validità della cache non possono essere negative";
+    }
+    if (c->max_connessioni < 0 || c->tasso < 0 || c->raffica < 0 || c->inattivita < 0 || c->stallo < 0 || c->drenaggio < 0) {
+        return "limiti e scadenze non possono essere negativi";
+    }
+    return NULL;
+}
+
+// Le due configurazioni differiscono in una voce che non si può cambiare a caldo
+static int richiede_nuovo_processo(const struct configurazione *a, const struct configurazione *b) {
+    return a->backlog != b->backlog || a->n_lavoratori != b->n_lavoratori || a->pinning != b->pinning ||
+           a->porta_metriche != b->porta_metriche || a->uring != b->uring || strcmp(a->file_log, b->file_log) != 0 ||
+           a->memo_mb != b->memo_mb || a->memo_ammissione != b->memo_ammissione || a->memo_ttl != b->memo_ttl;
+}
+
+// Pubblica ai lavoratori le voci a caldo. Ritorna -1, senza cambiare nulla, se manca memoria per il limite di tasso.
+static int applica_limiti(const struct configurazione *c) {
+    if (g11_tasso_imposta(&limite, c->tasso, c->raffica > 0 ? (uint32_t) c->raffica : (uint32_t) (c->tasso + 0.5)) < 0) {
+        return -1;
+    }
+    g11_log_imposta_livello(c->livello_log);
+    __atomic_store_n(&max_connessioni, (uint32_t) c->max_connessioni, __ATOMIC_RELAXED);
+    __atomic_store_n(&scadenza[LISTA_INATTIVE], (uint64_t) c->inattivita * 1000000000ULL, __ATOMIC_RELAXED);
+    __atomic_store_n(&scadenza[LISTA_IN_ATTESA], (uint64_t) (c->stallo > 0 ? c->stallo : c->inattivita) * 1000000000ULL,
+                     __ATOMIC_RELAXED);
+    return 0;
+}
+
+static const char *eseguibile;              // Programma avviato dal passaggio dei socket
+static char **argomenti;                    // Argomenti con cui è stato avviato questo processo
+static int socket_ascolto[MAX_LAVORATORI];  // Tutti i socket di ascolto, ricevuti o creati
+static int n_socket;
+
+// Passa i socket di ascolto e quello delle metriche a una nuova istanza del programma, con gli stessi
+// argomenti, e ne attende l'avvio. Ritorna 0 se il nuovo processo è pronto e questo deve arrestarsi.
+static int passa_al_nuovo_processo(void) {
+    int fd[MAX_LAVORATORI + 1];
+    const char *nomi[MAX_LAVORATORI + 1];
+    int n = 0;
+    char errore[256];
+    for (int i = 0; i < n_socket; i++) {
+        fd[n] = socket_ascolto[i];
+        nomi[n++] = "ascolto";
+    }
+    if (g11_metriche_socket() >= 0) {
+        fd[n] = g11_metriche_socket();
+        nomi[n++] = "metriche";
+    }
+    pid_t pid = g11_passa_socket(eseguibile, argomenti, fd, nomi, n, errore, sizeof(errore));
+    if (pid < 0) {
+        G11_LOG_ERRORE("passaggio dei socket non riuscito, il server continua: %s", errore);
+        return -1;
+    }
+    G11_LOG_INFO("socket di ascolto passati al processo %d", (int) pid);
+    return 0;
+}
+
+// Rilegge il file di configurazione (SIGHUP) a partire dalla riga di comando. Le voci a caldo vengono
+// applicate subito; se cambia altro i socket passano a un nuovo processo, che parte con la nuova
+// configurazione. Una configurazione non valida viene ignorata. Ritorna 1 se questo processo deve arrestarsi.
+static int ricarica(struct configurazione *attuale, const struct configurazione *riga_comando, const char *file_config) {
+    struct configurazione nuova = *riga_comando;
+    char errore[512];
+    const char *motivo;
+
+    if (file_config == NULL) {
+        G11_LOG_AVVISO("SIGHUP ignorato: nessun file di configurazione (-f)");
+        return 0;
+    }
+    if (g11_config_leggi(file_config, nomi_opzioni, applica_voce, &nuova, errore, sizeof(errore)) < 0) {
+        G11_LOG_ERRORE("configurazione non ricaricata: %s", errore);
+        return 0;
+    }
+    if ((motivo = verifica(&nuova)) != NULL) {
+        G11_LOG_ERRORE("configurazione non ricaricata: %s", motivo);
+        return 0;
+    }
+    if (richiede_nuovo_processo(attuale, &nuova)) {
+        G11_LOG_INFO("configurazione cambiata oltre i limiti: passaggio a un nuovo processo");
+        return passa_al_nuovo_processo() == 0;
+    }
+    if (applica_limiti(&nuova) < 0) {
+        G11_LOG_ERRORE("configurazione non ricaricata: memoria insufficiente per il limite di tasso");
+        return 0;
+    }
+    *attuale = nuova;
+    G11_LOG_INFO("configurazione ricaricata: log %s, al più %d connessioni, %g richieste/s (raffica %u),"
+                 " scadenze %d/%d s, arresto %d s", g11_log_nomi[nuova.livello_log], nuova.max_connessioni,
+                 nuova.tasso, g11_tasso_raffica(&limite), nuova.inattivita,
+                 nuova.stallo > 0 ? nuova.stallo : nuova.inattivita, nuova.drenaggio);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int portno;                                 // Variabile per la porta
+    struct configurazione cfg;                  // Configurazione in uso
+    struct configurazione riga_comando;         // Solo la riga di comando: base di ogni ricarica del file
+    const char *file_config = NULL;             // File di configurazione (-f), riletto con SIGHUP
+    char errore[512];
+    int opt;
+
+    configurazione_predefinita(&cfg);
+
+    // Lettura delle opzioni:
+    //   -b <backlog>  coda di accept
+    //   -t <N>        numero di thread lavoratori, ciascuno con socket SO_REUSEPORT ed epoll propri
+    //   -c            vincola ogni lavoratore a un core distinto
+    //   -m <porta>    espone le metriche in formato Prometheus su 127.0.0.1:<porta>
+    //   -e <motore>   motore di I/O: epoll (predefinito) oppure uring
+    //   -L <file>     scrive il log nel file indicato invece che su stderr
+    //   -v <livello>  livello minimo del log: debug, info (predefinito), avviso, errore
+    //   -M <MB>       attiva la cache dei risultati con al più MB megabyte, divisi tra i lavoratori
+    //   -A <politica> richieste ammesse nella cache: tutti, costosi (predefinito), ripetuti
+    //   -S <secondi>  validità di un risultato in cache, 0 (predefinito) = finché non viene sostituito
+    //   -C <N>        connessioni aperte al massimo: le successive ricevono lo stato OCCUPATO e vengono chiuse
+    //   -r <N>        richieste al secondo ammesse per indirizzo del client, oltre si risponde OCCUPATO
+    //   -B <N>        raffica ammessa dopo un periodo di silenzio (predefinita: un secondo al tasso -r)
+    //   -I <secondi>  chiude le connessioni inattive da più dei secondi indicati
+    //   -W <secondi>  chiude le connessioni ferme a metà di un frame o di una risposta (predefinito: come -I)
+    //   -D <secondi>  tempo concesso all'arresto ordinato per finire le richieste in corso (predefinito 30)
+    //   -f <file>     file di configurazione con le stesse voci ("tasso = 5000"), prevale sulla riga di
+    //                 comando e viene riletto con SIGHUP
+    while ((opt = getopt(argc, argv, "b:t:cm:e:L:v:M:A:S:C:r:B:I:W:D:f:")) != -1) {
+        switch (opt) {
+            case 'f': file_config = optarg; break;
+            default:
+                if (opzione(&cfg, opt, optarg) <= 0) uso(argv[0]);
+        }
+    }
+
+    // Verifica che sia stato fornito il numero di porta come argomento da riga di comando
+    if (optind >= argc) {
+        fprintf(stderr, "Errore: porta non fornita\n"); // Stampa un messaggio di errore sullo standard error
+        exit(1);                                       // Termina se la porta non è specificata
+    }
+    riga_comando = cfg;
+    if (file_config != NULL && g11_config_leggi(file_config, nomi_opzioni, applica_voce, &cfg, errore, sizeof(errore)) < 0) {
+        fprintf(stderr, "Errore: %s\n", errore);
+        exit(1);
+    }
+    const char *motivo = verifica(&cfg);
+    if (motivo != NULL) {
+        fprintf(stderr, "Errore: %s\n", motivo);
+        exit(1);
+    }
+    portno = atoi(argv[optind]); // Converte il numero di porta da stringa a intero
+    // Il passaggio dei socket riavvia il programma dallo stesso percorso, risolto ora: la directory corrente
+    // o PATH possono cambiare, e dopo un aggiornamento il percorso porta al nuovo eseguibile
+    eseguibile = g11_percorso_eseguibile(argv[0]);
+    argomenti = argv;
+
+    // Limiti a caldo e tabella dei secchi di gettoni, unica per tutti i lavoratori: un client con più
+    // connessioni distribuite su lavoratori diversi ha comunque un solo limite
+    if (applica_limiti(&cfg) < 0) {
+        error("ERRORE memoria insufficiente per il limite di tasso");
+    }
+
+    // I segnali del ciclo di vita vengono bloccati prima di creare qualsiasi thread: li riceve solo il ciclo finale
+    sigset_t segnali;
+    g11_blocca_segnali(&segnali);
+    signal(SIGPIPE, SIG_IGN); // Una write verso un client già chiuso deve restituire EPIPE, non terminare il server
+    alza_limite_descrittori();
+    if (g11_log_avvia(cfg.file_log[0] != '\0' ? cfg.file_log : NULL, cfg.livello_log, "tcp") < 0) {
+        error("ERRORE apertura del file di log");
+    }
+
+    int uring = cfg.uring;
+    if (uring) {
+        // Kernel troppo vecchio o io_uring disattivato (es. kernel.io_uring_disabled): si usa epoll
+        int r = g11_uring_supportato();
+        if (r < 0) {
+            fprintf(stderr, "io_uring non disponibile (%s): uso epoll\n", strerror(-r));
+            uring = 0;
+        }
+    }
+
+    // 4. Socket di ascolto: prima quelli ricevuti dal processo precedente (o da systemd), che conservano le
+    //    connessioni in coda, poi quelli nuovi fino a uno per lavoratore. Se i socket ricevuti non hanno
+    //    SO_REUSEPORT non se ne possono aggiungere: i lavoratori li condividono.
+    int ereditati = n_socket = g11_prendi_ereditati("ascolto", SOCK_STREAM, socket_ascolto, MAX_LAVORATORI);
+    int aggiungibili = 1;
+    for (int i = 0; i < n_socket; i++) {
+        aggiungibili = prepara_socket_ereditato(socket_ascolto[i], cfg.backlog) && aggiungibili;
+    }
+    while (n_socket < cfg.n_lavoratori && aggiungibili) {
+        socket_ascolto[n_socket++] = crea_socket_ascolto(portno, cfg.backlog);
+    }
+
+    int cpu[CPU_SETSIZE];
+    int n_cpu = cfg.pinning ? cpu_disponibili(cpu, CPU_SETSIZE) : 0;
+
+    static struct lavoratore lavoratori[MAX_LAVORATORI];
+    int n_lavoratori = cfg.n_lavoratori;
+    for (int i = 0; i < n_lavoratori; i++) {
+        struct lavoratore *l = &lavoratori[i];
+        l->id = i;
+        l->cpu = n_cpu > 0 ? cpu[i % n_cpu] : -1;
+        int condiviso = n_socket < n_lavoratori;
+        if (condiviso) {
+            l->ascolto = &socket_ascolto[i % n_socket];
+            l->n_ascolto = 1;
+        } else {
+            l->ascolto = &socket_ascolto[i * n_socket / n_lavoratori];
+            l->n_ascolto = (i + 1) * n_socket / n_lavoratori - i * n_socket / n_lavoratori;
+        }
+        l->metriche = g11_metriche_nuove();
+        if (l->metriche == NULL) {
+            error("ERRORE memoria insufficiente per le metriche");
+        }
+        memset(&l->memo, 0, sizeof(l->memo));
+        if (cfg.memo_mb > 0 && g11_memo_crea(&l->memo, (size_t) cfg.memo_mb * 1024 * 1024 / n_lavoratori,
+                                             (uint32_t) cfg.memo_ttl, cfg.memo_ammissione) < 0) {
+            error("ERRORE memoria insufficiente per la cache dei risultati");
+        }
+
+        // 5. Creazione dell'istanza epoll del lavoratore e registrazione dei suoi socket di ascolto
+        //    (con io_uring l'anello viene creato dal thread del lavoratore)
+        l->epfd = -1;
+        if (uring) {
+            continue;
+        }
+        l->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (l->epfd < 0) {
+            error("ERRORE in epoll_create1");
+        }
+        for (int s = 0; s < l->n_ascolto; s++) {
+            struct epoll_event ev;
+            ev.events = EPOLLIN | (condiviso ? EPOLLEXCLUSIVE : 0); // Un socket condiviso sveglia un solo lavoratore
+            ev.data.ptr = NULL; // data.ptr NULL identifica i socket di ascolto
+            if (epoll_ctl(l->epfd, EPOLL_CTL_ADD, l->ascolto[s], &ev) < 0) {
+                error("ERRORE in epoll_ctl");
+            }
+        }
+    }
+
+    int metriche_ereditate = -1;
+    g11_prendi_ereditati("metriche", SOCK_STREAM, &metriche_ereditate, 1);
+    if (cfg.porta_metriche > 0) {
+        if (g11_metriche_avvia(cfg.porta_metriche, "tcp", metriche_ereditate) < 0) {
+            fprintf(stderr, "Impossibile aprire la porta delle metriche %d\n", cfg.porta_metriche);
+        }
+    } else if (metriche_ereditate >= 0) {
+        close(metriche_ereditate);
+    }
+
+    printf("Server TCP avviato sulla porta %d (backlog %d, %d thread%s, I/O %s, kernel lotti %s)...\n",
+           portno, cfg.backlog, n_lavoratori, n_cpu > 0 ? ", CPU pinning" : "", uring ? "io_uring" : "epoll",
+           g11_nome_kernel());
+    if (ereditati > 0) {
+        printf("Socket di ascolto ricevuti: %d, totale %d\n", ereditati, n_socket);
+    }
+    if (cfg.memo_mb > 0) {
+        printf("Cache dei risultati: %d MB, %u voci per lavoratore, validità %d s (0 = illimitata)\n", cfg.memo_mb,
+               lavoratori[0].memo.maschera + 1, cfg.memo_ttl);
+    }
+    if (cfg.max_connessioni > 0 || cfg.tasso > 0 || cfg.inattivita > 0 || cfg.stallo > 0) {
+        printf("Ammissione: al più %d connessioni (0 = nessun limite), %g richieste/s per client (raffica %u),"
+               " scadenze %d s inattiva / %d s in stallo (0 = nessuna)\n", cfg.max_connessioni, cfg.tasso,
+               g11_tasso_raffica(&limite), cfg.inattivita, cfg.stallo > 0 ? cfg.stallo : cfg.inattivita);
+    }
+    fflush(stdout);
+
+    // 6. Avvio dei lavoratori: i socket sono tutti già in ascolto, quindi nessuna connessione va persa.
+    //    Il processo che ha passato i socket può ora smettere di accettare.
+    for (int i = 0; i < n_lavoratori; i++) {
+        if (pthread_create(&lavoratori[i].thread, NULL, uring ? ciclo_uring : ciclo_lavoratore, &lavoratori[i]) != 0) {
+            error("ERRORE in pthread_create");
+        }
+    }
+    g11_dichiara_pronto();
+
+    // 7. Il thread principale attende i segnali: SIGHUP ricarica la configurazione, SIGUSR2 passa i socket
+    //    a una nuova istanza del programma (aggiornamento), SIGTERM e SIGINT arrestano il server
+    for (int fine = 0; !fine; ) {
+        int sig = sigwaitinfo(&segnali, NULL);
+        if (sig == SIGHUP) {
+            fine = ricarica(&cfg, &riga_comando, file_config);
+        } else if (sig == SIGUSR2) {
+            G11_LOG_INFO("SIGUSR2: avvio di %s con i socket di ascolto", eseguibile);
+            fine = passa_al_nuovo_processo() == 0;
+        } else if (sig == SIGTERM || sig == SIGINT) {
+            fine = 1;
+        }
+    }
+
+    // 8. Arresto ordinato: i lavoratori smettono di accettare, rispondono alle richieste già ricevute e
+    //    terminano quando le loro connessioni sono chiuse. I socket di ascolto si chiudono appena nessun
+    //    lavoratore li usa (se sono passati a un nuovo processo restano aperti là); oltre il tempo concesso
+    //    (-D) le connessioni rimaste vengono chiuse e il processo termina con esito di errore.
+    G11_LOG_INFO("arresto ordinato: %u connessioni aperte, al più %d s",
+                 __atomic_load_n(&connessioni_aperte, __ATOMIC_RELAXED), cfg.drenaggio);
+    g11_avvia_arresto();
+    struct timespec scadenza_arresto, pausa = { 0, 10000000 };
+    clock_gettime(CLOCK_REALTIME, &scadenza_arresto);
+    scadenza_arresto.tv_sec += cfg.drenaggio;
+    while (__atomic_load_n(&lavoratori_fermi, __ATOMIC_ACQUIRE) < n_lavoratori) {
+        nanosleep(&pausa, NULL); // Ogni lavoratore se ne accorge entro CONTROLLO_MS
+    }
+    for (int i = 0; i < n_socket; i++) {
+        close(socket_ascolto[i]);
+    }
+    int conclusi = 0;
+    while (conclusi < n_lavoratori && pthread_timedjoin_np(lavoratori[conclusi].thread, NULL, &scadenza_arresto) == 0) {
+        conclusi++;
+    }
+    if (conclusi == n_lavoratori) {
+        G11_LOG_INFO("arresto completato");
+    } else {
+        G11_LOG_AVVISO("arresto: %u connessioni ancora aperte dopo %d s vengono chiuse",
+                       __atomic_load_n(&connessioni_aperte, __ATOMIC_RELAXED), cfg.drenaggio);
+        g11_forza_arresto(); // Ogni lavoratore se ne accorge entro CONTROLLO_MS
+        for (int i = conclusi; i < n_lavoratori; i++) {
+            pthread_join(lavoratori[i].thread, NULL);
+        }
+    }
+
+    // 9. Ultimo stato delle metriche sullo standard output, con quanto è cambiato dopo l'ultima lettura
+    //    della porta; il log viene scaricato da exit
+    if (g11_metriche_socket() >= 0) {
+        printf("Metriche finali:\n");
+        g11_metriche_esporta(stdout, "tcp");
+    }
+    return conclusi == n_lavoratori ? 0 : 1;
+}
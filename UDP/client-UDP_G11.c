@@ -1,9 +1,19 @@
+#define _GNU_SOURCE     // Necessario per ppoll nel generatore di carico
 #include <stdio.h>      // Libreria standard per l'input/output (printf, scanf, perror)
 #include <stdlib.h>     // Libreria per funzioni di utilità generale (atoi, exit)
-#include <string.h>     // Libreria per la manipolazione di stringhe (bzero, bcopy, strlen)
-#include <unistd.h>     // Fornisce accesso alle API POSIX (close)
+#include <string.h>     // Libreria per la manipolazione di stringhe (bzero, bcopy)
+#include <unistd.h>     // Fornisce accesso alle API POSIX (close, getopt)
+#include <errno.h>      // Codici di errore (EINTR, ECONNREFUSED)
+#include <poll.h>       // Attesa della risposta con timeout
+#include <sys/socket.h> // sendto, recvfrom
 #include <netdb.h>      // Definizioni per le operazioni di network database (gethostbyname)
 #include <arpa/inet.h>  // Definizioni per le operazioni su indirizzi Internet (sockaddr_in, htons)
+#include "../common/protocollo_G11.h"   // Formato dei frame condiviso con il server
+#include "../common/affidabilita_G11.h" // Timeout adattivi e ritrasmissioni
+#include "../common/carico_G11.h"       // Generatore di carico (-g)
+
+#define USO "Uso: %s hostname porta [-r tentativi] [-T timeout_ms] [-g [-P udp|tcp] [-C connessioni] [-j thread] " \
+            "[-q profondita] [-R richieste_al_s] [-x miscela] [-d secondi] [-l coppie_per_richiesta]]\n"
 
 // Funzione per la gestione degli errori. Stampa un messaggio e termina il programma.
 void error(const char *msg) {
@@ -11,18 +21,127 @@ void error(const char *msg) {
     exit(0);     // Termina il programma
 }
 
+// Statistiche dello scambio, stampate al termine
+struct statistiche {
+    unsigned long richieste;       // Richieste inviate (senza contare le ritrasmissioni)
+    unsigned long ritrasmissioni;  // Datagrammi inviati di nuovo per timeout scaduto
+    unsigned long perse;           // Richieste rimaste senza risposta dopo tutti i tentativi
+    int64_t latenza_max;           // Latenza più alta osservata, ritrasmissioni comprese (us)
+};
+
+// Invia una richiesta e attende la risposta con lo stesso id proveniente dal server.
+// Se la risposta non arriva entro il timeout corrente la richiesta viene ritrasmessa (stesso id, così il
+// server la riconosce come duplicato) raddoppiando il timeout, per al massimo 'tentativi' invii.
+// Ritorna la lunghezza della risposta copiata in 'risposta', oppure 0 se non è mai arrivata.
+static size_t scambia(int sockfd, const struct sockaddr_in *serv_addr, const uint8_t *richiesta, size_t len,
+                      uint32_t id, uint8_t *risposta, size_t max, int tentativi,
+                      struct g11_stima_rtt *rtt, struct statistiche *st, int64_t *latenza) {
+    struct sockaddr_in from; // Indirizzo del mittente della risposta
+    int64_t inizio = g11_adesso_us();
+    int64_t rto = rtt->rto;
+
+    st->richieste++;
+    for (int tentativo = 0; tentativo < tentativi; tentativo++) {
+        if (tentativo > 0) {
+            st->ritrasmissioni++;
+            rto = g11_rto_backoff(rto);
+        }
+        // Con UDP ogni messaggio deve specificare l'indirizzo di destinazione
+        int64_t invio = g11_adesso_us();
+        if (sendto(sockfd, richiesta, len, 0, (const struct sockaddr *) serv_addr, sizeof(*serv_addr)) < 0) {
+            error("ERRORE in sendto (richiesta)");
+        }
+        int64_t scadenza = invio + rto;
+        for (;;) {
+            int64_t adesso = g11_adesso_us();
+            if (adesso >= scadenza) {
+                break; // Timeout scaduto: si ritrasmette
+            }
+            struct pollfd pfd = { .fd = sockfd, .events = POLLIN };
+            int pronti = poll(&pfd, 1, (int) ((scadenza - adesso + 999) / 1000));
+            if (pronti < 0) {
+                if (errno == EINTR) continue;
+                error("ERRORE in poll");
+            }
+            if (pronti == 0) {
+                continue; // Ricontrolla la scadenza
+            }
+            socklen_t length = sizeof(from);
+            ssize_t n = recvfrom(sockfd, risposta, max, 0, (struct sockaddr *) &from, &length);
+            if (n < 0) {
+                if (errno == EINTR || errno == ECONNREFUSED) continue; // ICMP di porta chiusa: si attende comunque
+                error("ERRORE in recvfrom (risposta)");
+            }
+            // Si scartano i datagrammi che non vengono dal server o che non rispondono a questa richiesta
+            // (ad esempio le risposte tardive a richieste precedenti già ritrasmesse)
+            struct g11_frame f;
+            if (from.sin_addr.s_addr != serv_addr->sin_addr.s_addr || from.sin_port != serv_addr->sin_port ||
+                g11_analizza_frame(risposta, (size_t) n, max, &f) != G11_FRAME_COMPLETO || f.id != id) {
+                continue;
+            }
+            adesso = g11_adesso_us();
+            // Algoritmo di Karn: l'RTT si misura solo se la richiesta non è stata ritrasmessa
+            if (tentativo == 0) {
+                g11_rtt_campione(rtt, adesso - invio);
+            }
+            *latenza = adesso - inizio;
+            if (*latenza > st->latenza_max) {
+                st->latenza_max = *latenza;
+            }
+            return (size_t) n;
+        }
+    }
+    st->perse++;
+    *latenza = g11_adesso_us() - inizio;
+    if (*latenza > st->latenza_max) {
+        st->latenza_max = *latenza;
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
+    int tentativi = 5;                     // Invii massimi per ogni richiesta (-r)
+    int64_t rto_iniziale = G11_RTO_INIZIALE_US; // Timeout prima della prima misura dell'RTT (-T, in ms)
+    long lotto = 1;                        // Coppie per richiesta del generatore di carico (-l)
+    struct g11_carico carico;              // Parametri del generatore di carico (-g e seguenti)
+    int opt;
+    g11_carico_predefinito(&carico, G11_CARICO_UDP);
+
+    // Lettura delle opzioni:
+    //   -r <N>   numero massimo di invii di ogni richiesta (primo invio + ritrasmissioni)
+    //   -T <ms>  timeout iniziale, usato finché non c'è una misura dell'RTT
+    //   -g       generatore di carico, con le stesse opzioni del client TCP (-P, -C, -j, -q, -R, -x, -d, -l)
+    while ((opt = getopt(argc, argv, "r:T:l:" G11_CARICO_OPZIONI)) != -1) {
+        switch (opt) {
+            case 'r': tentativi = atoi(optarg); break;
+            case 'T': rto_iniziale = (int64_t) atoi(optarg) * 1000; break;
+            case 'l': lotto = atol(optarg); break;
+            default:
+                if (g11_carico_opzione(&carico, opt, optarg) > 0) break;
+                fprintf(stderr, USO, argv[0]);
+                exit(0);
+        }
+    }
+    argc -= optind - 1; // hostname e porta diventano argv[1] e argv[2]
+    argv += optind - 1;
+
     // Controlla che siano stati forniti hostname e porta del server come argomenti
     if (argc < 3) {
-        fprintf(stderr, "Uso: %s hostname porta\n", argv[0]);
+        fprintf(stderr, USO, argv[0]);
+        exit(0);
+    }
+    if (tentativi <= 0 || rto_iniziale <= 0) {
+        fprintf(stderr, "Errore: tentativi e timeout devono essere positivi\n");
+        exit(0);
+    }
+    if (lotto < 1 || lotto > (long) G11_MAX_LOTTO) {
+        fprintf(stderr, "Errore: il lotto deve contenere tra 1 e %u coppie\n", G11_MAX_LOTTO);
         exit(0);
     }
 
-    int sockfd, portno, n;                  // Descrittore socket, porta, valore di ritorno
-    unsigned int length;                    // Lunghezza della struttura dell'indirizzo (necessaria per recvfrom)
-    struct sockaddr_in serv_addr, from;     // Strutture per l'indirizzo del server e per l'indirizzo del mittente
+    int sockfd, portno;                     // Descrittore socket, porta
+    struct sockaddr_in serv_addr;           // Struttura per l'indirizzo del server
     struct hostent *server;                 // Struttura per memorizzare informazioni sull'host
-    char buffer[256];                       // Buffer per la comunicazione
 
     // 1. Creazione del socket UDP
     // AF_INET per indirizzi IPv4, SOCK_DGRAM per UDP.
@@ -45,74 +164,75 @@ int main(int argc, char *argv[]) {
     bcopy((char *)server->h_addr, (char *)&serv_addr.sin_addr.s_addr, server->h_length);
     serv_addr.sin_port = htons(portno); // Converte la porta in network byte order
 
-    length = sizeof(struct sockaddr_in); // Lunghezza della struttura dell'indirizzo
-
-    // 3. Handshake simulato: invia un primo messaggio per "iniziare" la comunicazione
-    char *handshake = "HELLO";
-    // Invia il messaggio "HELLO" al server. Con UDP, ogni messaggio deve specificare l'indirizzo di destinazione.
-    n = sendto(sockfd, handshake, strlen(handshake), 0, (struct sockaddr *) &serv_addr, length);
-    if (n < 0) {
-        error("ERRORE in sendto (handshake)");
-    }
-
-    // 4. Riceve la conferma di "connessione" dal server
-    bzero(buffer, 256); // Pulisce il buffer
-    // Attende di ricevere un messaggio. L'indirizzo del mittente verrà salvato in 'from'.
-    n = recvfrom(sockfd, buffer, 255, 0, (struct sockaddr *) &from, &length);
-    if (n < 0) {
-        error("ERRORE in recvfrom (conferma)");
-    }
-    printf("Server: %s\n", buffer); // Stampa il messaggio ricevuto
-
-    // 5. Chiede all'utente di inserire un comando
-    char command;
-    printf("Inserisci operazione (A, S, M, D) o altro per terminare: ");
-    scanf(" %c", &command);
-
-    // 6. Invia il comando al server
-    n = sendto(sockfd, &command, 1, 0, (struct sockaddr *) &serv_addr, length);
-    if (n < 0) {
-        error("ERRORE in sendto (comando)");
-    }
-
-    // 7. Riceve la risposta del server al comando
-    bzero(buffer, 256);
-    n = recvfrom(sockfd, buffer, 255, 0, (struct sockaddr *) &from, &length);
-    if (n < 0) {
-        error("ERRORE in recvfrom (risposta comando)");
-    }
-    printf("Stato Server: %s\n", buffer);
-
-    // Controlla se il server ha indicato la terminazione del processo
-    if (strstr(buffer, "TERMINE") != NULL) {
-        printf("Processo terminato come richiesto.\n");
+    // Il generatore di carico apre i propri socket, anche TCP (-P tcp)
+    if (carico.attivo) {
         close(sockfd);
-        return 0;
+        carico.lotto = (uint32_t) lotto;
+        return g11_carico_esegui(&carico, &serv_addr) == 0 ? 0 : 1;
     }
 
-    // Se il comando è valido, chiede i numeri all'utente
-    int numbers[2];
-    printf("Inserisci primo intero: ");
-    scanf("%d", &numbers[0]);
-    printf("Inserisci secondo intero: ");
-    scanf("%d", &numbers[1]);
-
-    // 8. Invia i due interi al server
-    n = sendto(sockfd, numbers, sizeof(int) * 2, 0, (struct sockaddr *) &serv_addr, length);
-    if (n < 0) {
-        error("ERRORE in sendto (numeri)");
+    // 3. Scambio senza stato: ogni operazione è un solo datagramma di richiesta e un solo datagramma di risposta.
+    // L'id iniziale è casuale, così le risposte in ritardo di un'esecuzione precedente non vengono scambiate
+    // per quelle attese.
+    static uint8_t risposta[G11_MAX_DATAGRAMMA];
+    uint32_t id = (uint32_t) getpid() * 2654435761u ^ (uint32_t) g11_adesso_us();
+    struct g11_stima_rtt rtt;
+    struct statistiche st = {0};
+    g11_rtt_inizializza(&rtt, rto_iniziale);
+    for (;;) {
+        // 4. Chiede all'utente di inserire un comando
+        char command;
+        printf("Inserisci operazione (A, S, M, D) o altro per terminare: ");
+        if (scanf(" %c", &command) != 1) {
+            break;
+        }
+        uint8_t op = g11_opcode_da_comando(command);
+        if (op == 0) {
+            printf("Processo terminato come richiesto.\n");
+            break;
+        }
+        printf("Operazione: %s\n", g11_nome_operazione(op));
+
+        // Se il comando è valido, chiede i numeri all'utente
+        int numbers[2];
+        printf("Inserisci primo intero: ");
+        if (scanf("%d", &numbers[0]) != 1) break;
+        printf("Inserisci secondo intero: ");
+        if (scanf("%d", &numbers[1]) != 1) break;
+
+        // 5. Invia operazione e operandi in un unico frame e riceve il frame di risposta con stato e risultato
+        uint8_t richiesta[G11_DIM_RICHIESTA];
+        g11_codifica_richiesta(richiesta, op, ++id, numbers[0], numbers[1]);
+        unsigned long ritrasmesse = st.ritrasmissioni;
+        int64_t latenza;
+        size_t n = scambia(sockfd, &serv_addr, richiesta, sizeof(richiesta), id, risposta, sizeof(risposta),
+                           tentativi, &rtt, &st, &latenza);
+        if (n == 0) {
+            printf("Nessuna risposta dal server dopo %d tentativi (%.1f ms)\n", tentativi, latenza / 1000.0);
+            continue;
+        }
+        if (st.ritrasmissioni > ritrasmesse) {
+            printf("Risposta ricevuta dopo %lu ritrasmissioni (%.1f ms)\n", st.ritrasmissioni - ritrasmesse,
+                   latenza / 1000.0);
+        }
+
+        struct g11_frame f = {0}; // Il frame è già stato verificato da scambia()
+        g11_analizza_frame(risposta, n, sizeof(risposta), &f);
+        printf("Stato Server: %s\n", g11_descrizione_stato(f.codice));
+        if (f.codice == G11_STATO_OK) {
+            printf("Risultato ricevuto dal server: %d\n", (int32_t) g11_leggi_u32(f.corpo));
+        }
     }
 
-    // 9. Riceve il risultato del calcolo
-    int result;
-    n = recvfrom(sockfd, &result, sizeof(int), 0, (struct sockaddr *) &from, &length);
-    if (n < 0) {
-        error("ERRORE in recvfrom (risultato)");
+    // 6. Riepilogo dell'affidabilità dello scambio
+    if (st.richieste > 0) {
+        printf("Richieste: %lu, ritrasmissioni: %lu, senza risposta: %lu, RTT medio: %.2f ms, "
+               "timeout corrente: %.2f ms, latenza massima: %.2f ms\n",
+               st.richieste, st.ritrasmissioni, st.perse, rtt.srtt / 1000.0, rtt.rto / 1000.0,
+               st.latenza_max / 1000.0);
     }
 
-    printf("Risultato ricevuto dal server: %d\n", result);
-
-    // 10. Chiude il socket
+    // 7. Chiude il socket
     close(sockfd);
     return 0;
-}
\ No newline at end of file
+}
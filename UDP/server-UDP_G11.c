@@ -1,133 +1,670 @@
+#define _GNU_SOURCE     // Necessario per recvmmsg/sendmmsg e per l'affinità dei thread
+#include <stdint.h>     // Tipi a dimensione fissa
 #include <stdio.h>      // Libreria standard per l'input/output (printf, perror)
 #include <stdlib.h>     // Libreria per funzioni di utilità generale (atoi, exit)
-#include <string.h>     // Libreria per la manipolazione di stringhe (bzero, strcpy, strlen)
-#include <unistd.h>     // Fornisce accesso alle API POSIX (non usata direttamente qui ma buona norma)
+#include <string.h>     // Libreria per la manipolazione di stringhe (bzero)
+#include <unistd.h>     // Fornisce accesso alle API POSIX (close)
+#include <errno.h>      // Codici di errore (EINTR)
+#include <time.h>       // clock_gettime, per il tempo passato in coda dai datagrammi
+#include <pthread.h>    // Thread lavoratori, uno per core
+#include <sched.h>      // Affinità dei thread ai core (CPU pinning)
+#include <sys/socket.h> // recvmmsg, sendmmsg
 #include <arpa/inet.h>  // Definizioni per le operazioni su indirizzi Internet (sockaddr_in, htons)
+#include "../common/protocollo_G11.h" // Formato dei frame condiviso con i client
+#include "../common/calcolo_G11.h"    // Esecuzione delle operazioni
+#include "../common/memo_G11.h"       // Cache dei risultati per lavoratore (-M)
+#include "../common/pool_G11.h"       // Pool dei buffer di ogni lavoratore
+#include "../common/ammissione_G11.h" // Limite di richieste al secondo per client (-r, -B)
+#include "../common/affidabilita_G11.h" // Cache delle risposte per le richieste ritrasmesse
+#include "../common/metriche_G11.h"     // Contatori e istogrammi per thread, porta delle metriche (-m)
+#include "../common/log_G11.h"          // Registro asincrono: nessuna scrittura su stdio nei lavoratori
+#include "../common/servizio_G11.h"     // Arresto ordinato, ricarica della configurazione, passaggio dei socket
+
+#define DATAGRAMMI_PER_LOTTO 64     // Datagrammi ricevuti e inviati con una sola chiamata di sistema
+#define MAX_LAVORATORI 256          // Numero massimo di thread lavoratori (-t)
+#define DIM_BUFFER_SOCKET (4 << 20) // Buffer di ricezione del socket, per assorbire i picchi di traffico
+#define CONTROLLO_MS 250            // Attesa massima di recvmmsg prima di controllare l'arresto
+#define DRENAGGIO_PREDEFINITO 30    // Secondi concessi all'arresto ordinato (-D)
+
+// Ogni lavoratore possiede il proprio socket (SO_REUSEPORT): il kernel distribuisce i datagrammi
+// in base all'indirizzo del mittente, quindi i lavoratori non condividono nulla. Solo un socket ricevuto
+// senza SO_REUSEPORT (es. da systemd) viene condiviso da tutti i lavoratori.
+struct lavoratore {
+    int id;           // Indice del lavoratore (0..N-1)
+    int sockfd;       // Socket di questo lavoratore
+    int cpu;          // Core a cui vincolare il thread, -1 se nessuno
+    pthread_t thread; // Thread che esegue il ciclo di ricezione
+    struct g11_cache_risposte cache; // Risposte recenti: un mittente resta sempre sullo stesso lavoratore
+    struct g11_metriche *metriche;   // Scritte solo da questo thread
+    struct g11_memo memo;            // Partizione della cache dei risultati, usata solo da questo thread
+    struct g11_pool_buffer buffer;   // Pool da cui vengono i buffer dei datagrammi
+};
+
+// Configurazione letta dalla riga di comando e dal file -f. Livello del log, limite di tasso, attesa
+// in coda e tempo di arresto si applicano a caldo; il resto richiede un nuovo processo.
+struct configurazione {
+    int n_lavoratori;        // Numero di thread lavoratori (-t)
+    int pinning;             // Se 1 ogni lavoratore viene vincolato a un core (-c)
+    int voci_cache;          // Voci della cache delle risposte per lavoratore (-R)
+    int porta_metriche;      // Porta locale delle metriche (-m), 0 = disattivata
+    char file_log[256];      // File di log (-L), vuoto = stderr
+    int livello_log;         // Livello minimo dei messaggi registrati (-v)
+    int memo_mb;             // Memoria della cache dei risultati in MB (-M), 0 = disattivata
+    int memo_ammissione;     // Richieste ammesse nella cache dei risultati (-A)
+    int memo_ttl;            // Validità dei risultati in cache in secondi (-S), 0 = illimitata
+    double tasso;            // Richieste al secondo per indirizzo del client (-r), 0 = nessun limite
+    int raffica;             // Richieste ammesse in raffica oltre il tasso (-B), 0 = un secondo di tasso
+    int max_attesa_ms;       // Millisecondi massimi in coda nel socket (-Q), 0 = nessun limite
+    int drenaggio;           // Secondi concessi all'arresto ordinato (-D)
+};
+
+// Limiti condivisi da tutti i lavoratori, cambiati a caldo dalla ricarica della configurazione
+static struct g11_tasso limite;     // Limite di richieste per client
+static int64_t max_attesa;          // Tempo massimo in coda nel socket in ns (-Q), 0 = nessun limite
 
 // Funzione per la gestione degli errori. Stampa un messaggio e termina il programma.
+// Usata solo in fase di avvio: gli errori sui singoli datagrammi vengono registrati nel log.
 void error(const char *msg) {
     perror(msg); // Stampa il messaggio di errore personalizzato e la descrizione dell'errore di sistema
     exit(1);     // Termina il programma con un codice di stato di errore
 }
 
-int main(int argc, char *argv[]) {
-    // Verifica che sia stata fornita la porta come argomento
-    if (argc < 2) {
-        fprintf(stderr, "Errore: porta non fornita\n");
-        exit(1);
-    }
-
-    int sockfd, portno, n;                  // Descrittore del socket, porta, valore di ritorno delle funzioni
-    struct sockaddr_in serv_addr, cli_addr; // Strutture per l'indirizzo del server e del client
-    socklen_t clilen;                       // Lunghezza della struttura dell'indirizzo del client
-    char buffer[256];                       // Buffer generico (usato per il primo handshake)
+// Crea il socket UDP di un lavoratore, associato alla porta condivisa. Con 'istanti' il kernel allega
+// a ogni datagramma l'istante di arrivo (SO_TIMESTAMPNS), usato per misurarne l'attesa in coda.
+// La ricezione attende al più CONTROLLO_MS, così il lavoratore si accorge dell'arresto.
+static int crea_socket(int portno, int istanti) {
+    struct sockaddr_in serv_addr; // Struttura per l'indirizzo del server
+    int uno = 1, dim = DIM_BUFFER_SOCKET;
 
     // 1. Creazione del socket UDP
     // AF_INET per indirizzi IPv4.
     // SOCK_DGRAM specifica che il socket sarà di tipo UDP (datagram, non orientato alla connessione).
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    int sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
     if (sockfd < 0) {
         error("ERRORE apertura socket");
     }
+    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &uno, sizeof(uno)) < 0) {
+        error("ERRORE in SO_REUSEPORT");
+    }
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &dim, sizeof(dim)); // Se fallisce resta il valore predefinito
+    if (istanti && setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &uno, sizeof(uno)) < 0) {
+        error("ERRORE in SO_TIMESTAMPNS");
+    }
+    struct timeval attesa = { 0, CONTROLLO_MS * 1000 };
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &attesa, sizeof(attesa)) < 0) {
+        error("ERRORE in SO_RCVTIMEO");
+    }
 
     // 2. Setup dell'indirizzo del server
     bzero((char *) &serv_addr, sizeof(serv_addr)); // Azzera la struttura
-    portno = atoi(argv[1]);                        // Converte la porta da stringa a intero
-
     serv_addr.sin_family = AF_INET;                // Famiglia di indirizzi IPv4
     serv_addr.sin_addr.s_addr = INADDR_ANY;        // Accetta pacchetti da qualsiasi interfaccia di rete
     serv_addr.sin_port = htons(portno);            // Converte la porta in network byte order
 
     // 3. Binding del socket all'indirizzo e alla porta
-    // Associa il socket 'sockfd' all'indirizzo 'serv_addr' per poter ricevere pacchetti su quella porta.
+    // Associa il socket all'indirizzo 'serv_addr' per poter ricevere pacchetti su quella porta.
     if (bind(sockfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0) {
         error("ERRORE in binding");
     }
+    return sockfd;
+}
 
-    printf("Server UDP avviato sulla porta %d...\n", portno);
-
-    // Ciclo infinito per ricevere e rispondere ai datagrammi dei client
-    while (1) {
-        clilen = sizeof(cli_addr); // Imposta la dimensione della struttura dell'indirizzo del client
+// Prepara un socket ricevuto dal processo precedente (o da systemd) come quelli creati qui. Ritorna 1 se
+// il socket ha SO_REUSEPORT, cioè se se ne possono aggiungere altri sulla stessa porta.
+static int prepara_socket_ereditato(int sockfd, int istanti) {
+    int uno = 1, riuso = 0;
+    socklen_t dim = sizeof(riuso);
+    struct timeval attesa = { 0, CONTROLLO_MS * 1000 };
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &attesa, sizeof(attesa)) < 0) {
+        error("ERRORE in SO_RCVTIMEO sul socket ricevuto");
+    }
+    if (istanti && setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &uno, sizeof(uno)) < 0) {
+        error("ERRORE in SO_TIMESTAMPNS");
+    }
+    return getsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &riuso, &dim) == 0 && riuso;
+}
 
-        // 4. Handshake simulato: riceve il primo messaggio dal client
-        // recvfrom è una chiamata bloccante: attende l'arrivo di un datagramma.
-        // Salva l'indirizzo del mittente in 'cli_addr' per poter rispondere.
-        n = recvfrom(sockfd, buffer, 255, 0, (struct sockaddr *) &cli_addr, &clilen);
-        if (n < 0) {
-            error("ERRORE in recvfrom (handshake)");
+// Decide se una richiesta va respinta con G11_STATO_OCCUPATO senza eseguirla. Ritorna il motivo
+// (G11_RIF_*) oppure -1 se va servita. Un datagramma rimasto in coda oltre -Q viene respinto prima di
+// consumare un gettone del mittente: la risposta rapida svuota la coda e limita l'attesa dei successivi.
+static int motivo_rifiuto(const struct msghdr *h, uint32_t ip, int64_t attesa_massima,
+                          const struct timespec *orologio, uint64_t adesso) {
+    if (attesa_massima > 0) {
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(h); cm != NULL; cm = CMSG_NXTHDR((struct msghdr *) h, cm)) {
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPNS) {
+                struct timespec arrivo;
+                memcpy(&arrivo, CMSG_DATA(cm), sizeof(arrivo));
+                int64_t attesa = (int64_t) (orologio->tv_sec - arrivo.tv_sec) * 1000000000LL +
+                                 (orologio->tv_nsec - arrivo.tv_nsec);
+                if (attesa > attesa_massima) {
+                    return G11_RIF_CODA;
+                }
+            }
         }
-        buffer[n] = '\0'; // Aggiunge il terminatore di stringa per sicurezza
-        printf("Handshake ricevuto da un client.\n");
+    }
+    if (!g11_tasso_ammetti(&limite, ip, adesso)) {
+        return G11_RIF_TASSO;
+    }
+    return -1;
+}
 
-        // 5. Invia la conferma di "connessione" (handshake) al client
-        char *msg_conn = "connessione avvenuta";
-        // Usa sendto per inviare la risposta all'indirizzo del client memorizzato in 'cli_addr'.
-        n = sendto(sockfd, msg_conn, strlen(msg_conn) + 1, 0, (struct sockaddr *) &cli_addr, clilen);
-        if (n < 0) {
-            error("ERRORE in sendto (handshake)");
-        }
+// Ciclo di un lavoratore. Lo scambio è senza stato: ogni datagramma contiene una richiesta completa
+// e riceve un datagramma di risposta indirizzato al suo mittente, quindi client diversi non possono
+// più mescolare i rispettivi dialoghi. I datagrammi vengono ricevuti e inviati a lotti (recvmmsg/sendmmsg).
+// All'arresto il lavoratore serve i datagrammi già in coda nel socket e termina quando la coda è vuota.
+static void *ciclo_lavoratore(void *arg) {
+    struct lavoratore *l = arg;
 
-        // 6. Riceve il comando dal client
-        char command;
-        n = recvfrom(sockfd, &command, 1, 0, (struct sockaddr *) &cli_addr, &clilen);
-        if (n < 0) {
-            error("ERRORE in recvfrom (comando)");
+    if (l->cpu >= 0) {
+        cpu_set_t insieme;
+        CPU_ZERO(&insieme);
+        CPU_SET(l->cpu, &insieme);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(insieme), &insieme) != 0) {
+            G11_LOG_AVVISO("lavoratore %d: impossibile vincolare il thread alla CPU %d", l->id, l->cpu);
         }
+    }
+
+    // Buffer e descrittori dei lotti, presi una sola volta dal pool del lavoratore dopo il vincolo al core:
+    // le pagine vengono toccate da questo thread e restano sul suo nodo NUMA
+    size_t cap_richieste, cap_risposte;
+    g11_pool_buffer_crea(&l->buffer, 0);
+    uint8_t *richieste = g11_buffer_prendi(&l->buffer, (size_t) DATAGRAMMI_PER_LOTTO * G11_MAX_DATAGRAMMA, &cap_richieste);
+    uint8_t *risposte = g11_buffer_prendi(&l->buffer, (size_t) DATAGRAMMI_PER_LOTTO * G11_MAX_DATAGRAMMA, &cap_risposte);
+    if (richieste == NULL || risposte == NULL || g11_espr_prepara() < 0) {
+        error("ERRORE memoria insufficiente");
+    }
+    G11_CONTA_ALLOC_IN(&l->metriche->allocazioni, &l->metriche->liberazioni); // Da qui nessuna malloc
+    struct mmsghdr ingresso[DATAGRAMMI_PER_LOTTO], uscita[DATAGRAMMI_PER_LOTTO];
+    struct iovec iov_in[DATAGRAMMI_PER_LOTTO], iov_out[DATAGRAMMI_PER_LOTTO];
+    struct sockaddr_in mittenti[DATAGRAMMI_PER_LOTTO];
+    // Dati ausiliari di ogni datagramma: l'istante di arrivo, richiesto solo con -Q
+    _Alignas(struct cmsghdr) unsigned char ausiliari[DATAGRAMMI_PER_LOTTO][CMSG_SPACE(sizeof(struct timespec))];
 
-        char response_msg[100]; // Buffer per il messaggio di risposta testuale
-        int valid_op = 1;       // Flag per operazione valida
+    memset(ingresso, 0, sizeof(ingresso));
+    memset(uscita, 0, sizeof(uscita));
+    for (int i = 0; i < DATAGRAMMI_PER_LOTTO; i++) {
+        iov_in[i].iov_base = richieste + (size_t) i * G11_MAX_DATAGRAMMA;
+        iov_in[i].iov_len = G11_MAX_DATAGRAMMA;
+        ingresso[i].msg_hdr.msg_iov = &iov_in[i];
+        ingresso[i].msg_hdr.msg_iovlen = 1;
+        ingresso[i].msg_hdr.msg_name = &mittenti[i];
+    }
 
-        // 7. Interpreta il comando e prepara la risposta
-        switch(command) {
-            case 'A': case 'a': strcpy(response_msg, "ADDIZIONE"); break;
-            case 'S': case 's': strcpy(response_msg, "SOTTRAZIONE"); break;
-            case 'M': case 'm': strcpy(response_msg, "MOLTIPLICAZIONE"); break;
-            case 'D': case 'd': strcpy(response_msg, "DIVISIONE"); break;
-            default:
-                strcpy(response_msg, "TERMINE PROCESSO CLIENT");
-                valid_op = 0; // Comando non valido
+    while (1) {
+        // -Q può cambiare con la ricarica: letto una volta per lotto
+        int64_t attesa_massima = __atomic_load_n(&max_attesa, __ATOMIC_RELAXED);
+        int arresto = g11_in_arresto();
+        if (arresto && g11_arresto_forzato()) {
+            break; // Scaduto -D: i datagrammi ancora in coda non ricevono risposta
+        }
+        for (int i = 0; i < DATAGRAMMI_PER_LOTTO; i++) {
+            ingresso[i].msg_hdr.msg_namelen = sizeof(mittenti[i]);
+            ingresso[i].msg_hdr.msg_control = attesa_massima > 0 ? ausiliari[i] : NULL;
+            ingresso[i].msg_hdr.msg_controllen = attesa_massima > 0 ? sizeof(ausiliari[i]) : 0;
         }
 
-        // Invia la risposta testuale al client
-        n = sendto(sockfd, response_msg, strlen(response_msg) + 1, 0, (struct sockaddr *) &cli_addr, clilen);
+        // 4. Riceve un lotto di datagrammi: attende il primo (al più CONTROLLO_MS), poi prende quelli già
+        //    in coda senza bloccare. Durante l'arresto non attende: la coda vuota conclude il lavoratore.
+        int n = recvmmsg(l->sockfd, ingresso, DATAGRAMMI_PER_LOTTO, arresto ? MSG_DONTWAIT : MSG_WAITFORONE, NULL);
         if (n < 0) {
-            error("ERRORE in sendto (risposta comando)");
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (arresto) break;
+                continue;
+            }
+            if (errno == EINTR) continue;
+            G11_LOG_AVVISO("recvmmsg fallita: %s", strerror(errno));
+            continue; // Un errore transitorio non deve fermare il server
         }
+        G11_METRICA_INIZIO(t0); // recvmmsg comprende l'attesa del primo datagramma: la lettura non viene misurata
+        G11_METRICA_VALORE(l->metriche, coda, n);
 
-        // Se l'operazione è valida, procede a ricevere i numeri e a calcolare
-        if (valid_op) {
-            int numbers[2];
-            // 8. Riceve i due interi dal client
-            n = recvfrom(sockfd, numbers, sizeof(int) * 2, 0, (struct sockaddr *) &cli_addr, &clilen);
-            if (n < 0) {
-                error("ERRORE in recvfrom (numeri)");
+        // 5. Elabora ogni richiesta e prepara la risposta per il rispettivo mittente.
+        // Un datagramma che non contiene un frame completo viene scartato. Una richiesta ritrasmessa
+        // dal client (stesso mittente, stesso id, stesso contenuto) riceve la risposta conservata in cache.
+        // Una richiesta rimasta troppo in coda o oltre il tasso del mittente riceve subito G11_STATO_OCCUPATO.
+        int m = 0;
+        int64_t adesso = l->cache.voci != NULL ? g11_adesso_us() : 0;
+        // Orologi letti una volta per lotto: quello degli istanti di arrivo (CLOCK_REALTIME) e quello dei gettoni
+        struct timespec orologio = { 0, 0 };
+        if (attesa_massima > 0) {
+            clock_gettime(CLOCK_REALTIME, &orologio);
+        }
+        uint64_t istante = g11_tasso_attivo(&limite) ? g11_tasso_adesso() : 0;
+        for (int i = 0; i < n; i++) {
+            struct g11_frame req;
+            G11_METRICA_CONTA(l->metriche, byte_ricevuti, ingresso[i].msg_len);
+            if (g11_analizza_frame(iov_in[i].iov_base, ingresso[i].msg_len, G11_MAX_DATAGRAMMA, &req) != G11_FRAME_COMPLETO ||
+                req.lunghezza != ingresso[i].msg_len) {
+                G11_METRICA_CONTA(l->metriche, frame_scartati, 1);
+                char ip[INET_ADDRSTRLEN];
+                G11_LOG_DEBUG("datagramma non valido da %s:%d (%u byte) scartato",
+                              inet_ntop(AF_INET, &mittenti[i].sin_addr, ip, sizeof(ip)), ntohs(mittenti[i].sin_port),
+                              ingresso[i].msg_len);
+                continue;
             }
-
-            // Esegue l'operazione
-            int result = 0;
-            if (command == 'A' || command == 'a') result = numbers[0] + numbers[1];
-            if (command == 'S' || command == 's') result = numbers[0] - numbers[1];
-            if (command == 'M' || command == 'm') result = numbers[0] * numbers[1];
-            if (command == 'D' || command == 'd') {
-                // Controllo divisione per zero
-                if (numbers[1] != 0) {
-                    result = numbers[0] / numbers[1];
+            uint8_t *risposta = risposte + (size_t) m * G11_MAX_DATAGRAMMA;
+            size_t dim = 0;
+            int rifiuto = motivo_rifiuto(&ingresso[i].msg_hdr, mittenti[i].sin_addr.s_addr, attesa_massima, &orologio,
+                                         istante);
+            if (rifiuto >= 0) {
+                g11_codifica_risposta(risposta, G11_STATO_OCCUPATO, req.id, 0);
+                dim = G11_DIM_RISPOSTA;
+                G11_METRICA_CONTA(l->metriche, rifiuti[rifiuto], 1);
+            } else {
+                uint64_t impronta = 0;
+                int memorizzabile = l->cache.voci != NULL && g11_dim_risposta(&req) <= G11_CACHE_MAX_RISPOSTA;
+                if (memorizzabile) {
+                    impronta = g11_impronta(iov_in[i].iov_base, ingresso[i].msg_len);
+                    dim = g11_cache_risposte_cerca(&l->cache, &mittenti[i], req.id, impronta, adesso, risposta);
+                }
+                if (dim > 0) {
+                    G11_METRICA_CONTA(l->metriche, risposte_cache, 1);
                 } else {
-                    result = 0; // Risultato in caso di divisione per zero
+                    int memo;
+                    dim = g11_memo_elabora(&l->memo, &req, risposta, G11_MAX_DATAGRAMMA, &memo);
+                    if (dim == 0) {
+                        continue;
+                    }
+                    G11_METRICA_CONTA(l->metriche, memo_trovate, memo == G11_MEMO_TROVATA);
+                    G11_METRICA_CONTA(l->metriche, memo_mancate, memo == G11_MEMO_MANCATA);
+                    if (memorizzabile) {
+                        g11_cache_risposte_inserisci(&l->cache, &mittenti[i], req.id, impronta, adesso, risposta, dim);
+                    }
+                    G11_METRICA_RICHIESTA(l->metriche, &req, risposta);
                 }
             }
+            G11_METRICA_CONTA(l->metriche, byte_inviati, dim);
+            iov_out[m].iov_base = risposta;
+            iov_out[m].iov_len = dim;
+            uscita[m].msg_hdr.msg_iov = &iov_out[m];
+            uscita[m].msg_hdr.msg_iovlen = 1;
+            uscita[m].msg_hdr.msg_name = &mittenti[i];
+            uscita[m].msg_hdr.msg_namelen = ingresso[i].msg_hdr.msg_namelen;
+            m++;
+        }
+
+        G11_METRICA_FASE(l->metriche, G11_FASE_ELABORAZIONE, t0);
 
-            // 9. Invia il risultato del calcolo al client
-            n = sendto(sockfd, &result, sizeof(int), 0, (struct sockaddr *) &cli_addr, clilen);
-            if (n < 0) {
-                error("ERRORE in sendto (risultato)");
+        // 6. Invia tutte le risposte del lotto con una sola chiamata (ripetuta se il kernel ne accetta solo una parte)
+        G11_METRICA_INIZIO(t1);
+        for (int inviati = 0; inviati < m; ) {
+            int k = sendmmsg(l->sockfd, uscita + inviati, (unsigned) (m - inviati), 0);
+            if (k < 0) {
+                if (errno == EINTR) continue;
+                char ip[INET_ADDRSTRLEN];
+                const struct sockaddr_in *dest = uscita[inviati].msg_hdr.msg_name;
+                G11_LOG_INFO("sendmmsg fallita verso %s:%d: %s",
+                             inet_ntop(AF_INET, &dest->sin_addr, ip, sizeof(ip)), ntohs(dest->sin_port), strerror(errno));
+                inviati++; // Si salta il datagramma che ha causato l'errore (es. destinazione irraggiungibile)
+                continue;
             }
+            inviati += k;
+        }
+        G11_METRICA_FASE(l->metriche, G11_FASE_SCRITTURA, t1);
+    }
+    G11_LOG_DEBUG("lavoratore %d: coda del socket vuota, terminato", l->id);
+    return NULL;
+}
+
+// Restituisce l'elenco delle CPU su cui il processo può girare, usato per il pinning dei lavoratori.
+static int cpu_disponibili(int *cpu, int max) {
+    cpu_set_t insieme;
+    int n = 0;
+    if (sched_getaffinity(0, sizeof(insieme), &insieme) < 0) {
+        return 0;
+    }
+    for (int i = 0; i < CPU_SETSIZE && n < max; i++) {
+        if (CPU_ISSET(i, &insieme)) {
+            cpu[n++] = i;
+        }
+    }
+    return n;
+}
+
+static void uso(const char *programma) {
+    fprintf(stderr, "Uso: %s porta [-t thread] [-c] [-R voci_cache] [-m porta_metriche] [-L file_log] [-v livello]\n"
+                    "       [-M MB_cache] [-A tutti|costosi|ripetuti] [-S ttl_secondi]\n"
+                    "       [-r richieste_al_secondo] [-B raffica] [-Q ms_in_coda]\n"
+                    "       [-D secondi_arresto] [-f file_configurazione]\n", programma);
+    exit(1);
+}
+
+// Voci del file di configurazione (-f) e opzioni corrispondenti
+static const struct g11_nome_opzione nomi_opzioni[] = {
+    { "thread", 't' }, { "cpu", 'c' }, { "cache_risposte", 'R' }, { "metriche", 'm' }, { "log", 'L' },
+    { "livello", 'v' }, { "cache_mb", 'M' }, { "cache_ammissione", 'A' }, { "cache_ttl", 'S' },
+    { "tasso", 'r' }, { "raffica", 'B' }, { "attesa_coda", 'Q' }, { "arresto", 'D' }, { NULL, 0 }
+};
+
+static void configurazione_predefinita(struct configurazione *c) {
+    memset(c, 0, sizeof(*c));
+    c->n_lavoratori = 1;
+    c->voci_cache = G11_CACHE_RISPOSTE_PREDEFINITA;
+    c->livello_log = G11_LOG_INFO;
+    c->memo_ammissione = G11_MEMO_COSTOSI;
+    c->drenaggio = DRENAGGIO_PREDEFINITO;
+}
+
+// Interpreta un'opzione della riga di comando o una voce del file di configurazione. Ritorna 1 se
+// l'opzione è stata riconosciuta, 0 se non esiste, -1 se il valore non è valido. -c sulla riga di comando
+// non ha valore; nel file "cpu" vale 0 o 1.
+static int opzione(struct configurazione *c, int opt, const char *arg) {
+    switch (opt) {
+        case 't': c->n_lavoratori = atoi(arg); break;
+        case 'c': c->pinning = arg == NULL || atoi(arg) != 0; break;
+        case 'R': c->voci_cache = atoi(arg); break;
+        case 'm': c->porta_metriche = atoi(arg); break;
+        case 'M': c->memo_mb = atoi(arg); break;
+        case 'S': c->memo_ttl = atoi(arg); break;
+        case 'r': c->tasso = atof(arg); break;
+        case 'B': c->raffica = atoi(arg); break;
+        case 'Q': c->max_attesa_ms = atoi(arg); break;
+        case 'D': c->drenaggio = atoi(arg); break;
+        case 'L':
+            if (strlen(arg) >= sizeof(c->file_log)) return -1;
+            strcpy(c->file_log, arg);
+            break;
+        case 'A':
+            c->memo_ammissione = g11_memo_politica(arg);
+            if (c->memo_ammissione < 0) return -1;
+            break;
+        case 'v':
+            c->livello_log = g11_log_livello(arg);
+            if (c->livello_log < 0) return -1;
+            break;
+        default: return 0;
+    }
+    return 1;
+}
+
+static int applica_voce(void *c, int opt, const char *valore) {
+    return opzione(c, opt, valore);
+}
+
+// Controlla la coerenza della configurazione; ritorna il messaggio d'errore oppure NULL.
+static const char *verifica(const struct configurazione *c) {
+    if (c->n_lavoratori <= 0 || c->n_lavoratori > MAX_LAVORATORI) {
+        return "il numero di thread deve essere compreso tra 1 e 256 (-t)";
+    }
+    if (c->voci_cache < 0 || c->voci_cache > (1 << 20)) {
+        return "la cache delle risposte deve avere tra 0 e 1048576 voci (-R)";
+    }
+    if (c->memo_mb < 0 || c->memo_ttl < 0) {
+        return "memoria e validità della cache non possono essere negative";
+    }
+    if (c->tasso < 0 || c->raffica < 0 || c->max_attesa_ms < 0 || c->drenaggio < 0) {
+        return "limiti di tasso e di attesa non possono essere negativi";
+    }
+    return NULL;
+}
+
+// Le due configurazioni differiscono in una voce che non si può cambiare a caldo
+static int richiede_nuovo_processo(const struct configurazione *a, const struct configurazione *b) {
+    return a->n_lavoratori != b->n_lavoratori || a->pinning != b->pinning || a->voci_cache != b->voci_cache ||
+           a->porta_metriche != b->porta_metriche || strcmp(a->file_log, b->file_log) != 0 ||
+           a->memo_mb != b->memo_mb || a->memo_ammissione != b->memo_ammissione || a->memo_ttl != b->memo_ttl;
+}
+
+static int socket_dati[MAX_LAVORATORI];     // Tutti i socket della porta, ricevuti o creati
+static int n_socket;
+
+// Pubblica ai lavoratori le voci a caldo. Ritorna -1, senza cambiare nulla, se manca memoria per il limite di tasso.
+static int applica_limiti(const struct configurazione *c) {
+    if (g11_tasso_imposta(&limite, c->tasso, c->raffica > 0 ? (uint32_t) c->raffica : (uint32_t) (c->tasso + 0.5)) < 0) {
+        return -1;
+    }
+    g11_log_imposta_livello(c->livello_log);
+    if (c->max_attesa_ms > 0) {
+        // I socket devono allegare l'istante di arrivo prima che i lavoratori lo cerchino
+        int uno = 1;
+        for (int i = 0; i < n_socket; i++) {
+            setsockopt(socket_dati[i], SOL_SOCKET, SO_TIMESTAMPNS, &uno, sizeof(uno));
         }
-        // A differenza di TCP, non c'è una connessione da chiudere per ogni client.
-        // Il server resta semplicemente in attesa del prossimo datagramma.
     }
+    __atomic_store_n(&max_attesa, (int64_t) c->max_attesa_ms * 1000000, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static const char *eseguibile;              // Programma avviato dal passaggio dei socket
+static char **argomenti;                    // Argomenti con cui è stato avviato questo processo
+
+// Passa i socket della porta e quello delle metriche a una nuova istanza del programma, con gli stessi
+// argomenti, e ne attende l'avvio. Ritorna 0 se il nuovo processo è pronto e questo deve arrestarsi.
+static int passa_al_nuovo_processo(void) {
+    int fd[MAX_LAVORATORI + 1];
+    const char *nomi[MAX_LAVORATORI + 1];
+    int n = 0;
+    char errore[256];
+    for (int i = 0; i < n_socket; i++) {
+        fd[n] = socket_dati[i];
+        nomi[n++] = "ascolto";
+    }
+    if (g11_metriche_socket() >= 0) {
+        fd[n] = g11_metriche_socket();
+        nomi[n++] = "metriche";
+    }
+    pid_t pid = g11_passa_socket(eseguibile, argomenti, fd, nomi, n, errore, sizeof(errore));
+    if (pid < 0) {
+        G11_LOG_ERRORE("passaggio dei socket non riuscito, il server continua: %s", errore);
+        return -1;
+    }
+    G11_LOG_INFO("socket passati al processo %d", (int) pid);
+    return 0;
+}
+
+// Rilegge il file di configurazione (SIGHUP) a partire dalla riga di comando. Le voci a caldo vengono
+// applicate subito; se cambia altro i socket passano a un nuovo processo, che parte con la nuova
+// configurazione. Una configurazione non valida viene ignorata. Ritorna 1 se questo processo deve arrestarsi.
+static int ricarica(struct configurazione *attuale, const struct configurazione *riga_comando, const char *file_config) {
+    struct configurazione nuova = *riga_comando;
+    char errore[512];
+    const char *motivo;
 
-    close(sockfd); // Questa parte non è raggiungibile a causa del ciclo infinito
+    if (file_config == NULL) {
+        G11_LOG_AVVISO("SIGHUP ignorato: nessun file di configurazione (-f)");
+        return 0;
+    }
+    if (g11_config_leggi(file_config, nomi_opzioni, applica_voce, &nuova, errore, sizeof(errore)) < 0) {
+        G11_LOG_ERRORE("configurazione non ricaricata: %s", errore);
+        return 0;
+    }
+    if ((motivo = verifica(&nuova)) != NULL) {
+        G11_LOG_ERRORE("configurazione non ricaricata: %s", motivo);
+        return 0;
+    }
+    if (richiede_nuovo_processo(attuale, &nuova)) {
+        G11_LOG_INFO("configurazione cambiata oltre i limiti: passaggio a un nuovo processo");
+        return passa_al_nuovo_processo() == 0;
+    }
+    if (applica_limiti(&nuova) < 0) {
+        G11_LOG_ERRORE("configurazione non ricaricata: memoria insufficiente per il limite di tasso");
+        return 0;
+    }
+    *attuale = nuova;
+    G11_LOG_INFO("configurazione ricaricata: log %s, %g richieste/s (raffica %u), al più %d ms in coda, arresto %d s",
+                 g11_log_nomi[nuova.livello_log], nuova.tasso, g11_tasso_raffica(&limite), nuova.max_attesa_ms,
+                 nuova.drenaggio);
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char *argv[]) {
+    int portno;                          // Porta del server
+    struct configurazione cfg;           // Configurazione in uso
+    struct configurazione riga_comando;  // Solo la riga di comando: base di ogni ricarica del file
+    const char *file_config = NULL;      // File di configurazione (-f), riletto con SIGHUP
+    char errore[512];
+    int opt;
+
+    configurazione_predefinita(&cfg);
+
+    // Lettura delle opzioni:
+    //   -t <N>  numero di thread lavoratori, ciascuno con il proprio socket SO_REUSEPORT
+    //   -c      vincola ogni lavoratore a un core distinto
+    //   -R <N>  voci della cache delle risposte di ogni lavoratore (0 la disattiva)
+    //   -m <porta>  espone le metriche in formato Prometheus su 127.0.0.1:<porta> (TCP)
+    //   -L <file>   scrive il log nel file indicato invece che su stderr
+    //   -v <livello> livello minimo del log: debug, info (predefinito), avviso, errore
+    //   -M <MB>      attiva la cache dei risultati con al più MB megabyte, divisi tra i lavoratori
+    //   -A <politica> richieste ammesse nella cache dei risultati: tutti, costosi (predefinito), ripetuti
+    //   -S <secondi> validità di un risultato in cache, 0 (predefinito) = finché non viene sostituito
+    //   -r <N>       richieste al secondo ammesse per indirizzo del client, oltre si risponde OCCUPATO
+    //   -B <N>       raffica ammessa dopo un periodo di silenzio (predefinita: un secondo al tasso -r)
+    //   -Q <ms>      un datagramma rimasto in coda più a lungo riceve OCCUPATO invece di essere eseguito
+    //   -D <secondi> tempo concesso all'arresto ordinato per servire i datagrammi in coda (predefinito 30)
+    //   -f <file>    file di configurazione con le stesse voci ("tasso = 5000"), prevale sulla riga di
+    //                comando e viene riletto con SIGHUP
+    while ((opt = getopt(argc, argv, "t:cR:m:L:v:M:A:S:r:B:Q:D:f:")) != -1) {
+        switch (opt) {
+            case 'f': file_config = optarg; break;
+            default:
+                if (opzione(&cfg, opt, optarg) <= 0) uso(argv[0]);
+        }
+    }
+
+    // Verifica che sia stata fornita la porta come argomento
+    if (optind >= argc) {
+        fprintf(stderr, "Errore: porta non fornita\n");
+        exit(1);
+    }
+    riga_comando = cfg;
+    if (file_config != NULL && g11_config_leggi(file_config, nomi_opzioni, applica_voce, &cfg, errore, sizeof(errore)) < 0) {
+        fprintf(stderr, "Errore: %s\n", errore);
+        exit(1);
+    }
+    const char *motivo = verifica(&cfg);
+    if (motivo != NULL) {
+        fprintf(stderr, "Errore: %s\n", motivo);
+        exit(1);
+    }
+    portno = atoi(argv[optind]); // Converte la porta da stringa a intero
+    // Il passaggio dei socket riavvia il programma dallo stesso percorso, risolto ora: la directory corrente
+    // o PATH possono cambiare, e dopo un aggiornamento il percorso porta al nuovo eseguibile
+    eseguibile = g11_percorso_eseguibile(argv[0]);
+    argomenti = argv;
+
+    // I segnali del ciclo di vita vengono bloccati prima di creare qualsiasi thread: li riceve solo il ciclo finale
+    sigset_t segnali;
+    g11_blocca_segnali(&segnali);
+    if (g11_log_avvia(cfg.file_log[0] != '\0' ? cfg.file_log : NULL, cfg.livello_log, "udp") < 0) {
+        error("ERRORE apertura del file di log");
+    }
+
+    // Socket della porta: prima quelli ricevuti dal processo precedente (o da systemd), con i datagrammi
+    // già in coda, poi quelli nuovi fino a uno per lavoratore. I socket ricevuti in più dei lavoratori
+    // vengono chiusi: il kernel distribuisce i datagrammi successivi tra quelli rimasti.
+    int ereditati = n_socket = g11_prendi_ereditati("ascolto", SOCK_DGRAM, socket_dati, MAX_LAVORATORI);
+    int aggiungibili = 1;
+    for (int i = 0; i < n_socket; i++) {
+        aggiungibili = prepara_socket_ereditato(socket_dati[i], cfg.max_attesa_ms > 0) && aggiungibili;
+    }
+    while (n_socket > cfg.n_lavoratori) {
+        close(socket_dati[--n_socket]);
+    }
+    while (n_socket < cfg.n_lavoratori && aggiungibili) {
+        socket_dati[n_socket++] = crea_socket(portno, cfg.max_attesa_ms > 0);
+    }
+
+    // Limiti a caldo e tabella dei secchi di gettoni, unica per tutti i lavoratori
+    if (applica_limiti(&cfg) < 0) {
+        error("ERRORE memoria insufficiente per il limite di tasso");
+    }
+
+    int cpu[CPU_SETSIZE];
+    int n_cpu = cfg.pinning ? cpu_disponibili(cpu, CPU_SETSIZE) : 0;
+
+    static struct lavoratore lavoratori[MAX_LAVORATORI];
+    int n_lavoratori = cfg.n_lavoratori;
+    for (int i = 0; i < n_lavoratori; i++) {
+        lavoratori[i].id = i;
+        lavoratori[i].cpu = n_cpu > 0 ? cpu[i % n_cpu] : -1;
+        lavoratori[i].sockfd = socket_dati[i % n_socket];
+        if (g11_cache_risposte_crea(&lavoratori[i].cache, (uint32_t) cfg.voci_cache) < 0) {
+            error("ERRORE memoria insufficiente per la cache delle risposte");
+        }
+        lavoratori[i].metriche = g11_metriche_nuove();
+        if (lavoratori[i].metriche == NULL) {
+            error("ERRORE memoria insufficiente per le metriche");
+        }
+        if (cfg.memo_mb > 0 && g11_memo_crea(&lavoratori[i].memo, (size_t) cfg.memo_mb * 1024 * 1024 / n_lavoratori,
+                                             (uint32_t) cfg.memo_ttl, cfg.memo_ammissione) < 0) {
+            error("ERRORE memoria insufficiente per la cache dei risultati");
+        }
+    }
+
+    int metriche_ereditate = -1;
+    g11_prendi_ereditati("metriche", SOCK_STREAM, &metriche_ereditate, 1);
+    if (cfg.porta_metriche > 0) {
+        if (g11_metriche_avvia(cfg.porta_metriche, "udp", metriche_ereditate) < 0) {
+            fprintf(stderr, "Impossibile aprire la porta delle metriche %d\n", cfg.porta_metriche);
+        }
+    } else if (metriche_ereditate >= 0) {
+        close(metriche_ereditate);
+    }
+
+    printf("Server UDP avviato sulla porta %d (%d thread%s, kernel lotti %s)...\n",
+           portno, n_lavoratori, n_cpu > 0 ? ", CPU pinning" : "", g11_nome_kernel());
+    if (ereditati > 0) {
+        printf("Socket ricevuti: %d, in uso %d\n", ereditati, n_socket);
+    }
+    if (cfg.memo_mb > 0) {
+        printf("Cache dei risultati: %d MB, %u voci per lavoratore, validità %d s (0 = illimitata)\n", cfg.memo_mb,
+               lavoratori[0].memo.maschera + 1, cfg.memo_ttl);
+    }
+    if (cfg.tasso > 0 || cfg.max_attesa_ms > 0) {
+        printf("Ammissione: %g richieste/s per client (raffica %u, 0 = nessun limite), al più %d ms in coda\n",
+               cfg.tasso, g11_tasso_raffica(&limite), cfg.max_attesa_ms);
+    }
+    fflush(stdout);
+
+    for (int i = 0; i < n_lavoratori; i++) {
+        if (pthread_create(&lavoratori[i].thread, NULL, ciclo_lavoratore, &lavoratori[i]) != 0) {
+            error("ERRORE in pthread_create");
+        }
+    }
+    g11_dichiara_pronto();
+
+    // Il thread principale attende i segnali: SIGHUP ricarica la configurazione, SIGUSR2 passa i socket
+    // a una nuova istanza del programma (aggiornamento), SIGTERM e SIGINT arrestano il server
+    for (int fine = 0; !fine; ) {
+        int sig = sigwaitinfo(&segnali, NULL);
+        if (sig == SIGHUP) {
+            fine = ricarica(&cfg, &riga_comando, file_config);
+        } else if (sig == SIGUSR2) {
+            G11_LOG_INFO("SIGUSR2: avvio di %s con i socket della porta", eseguibile);
+            fine = passa_al_nuovo_processo() == 0;
+        } else if (sig == SIGTERM || sig == SIGINT) {
+            fine = 1;
+        }
+    }
+
+    // Arresto ordinato: i lavoratori servono i datagrammi già in coda e terminano; oltre il tempo
+    // concesso (-D) smettono subito e il processo termina con esito di errore
+    G11_LOG_INFO("arresto ordinato: al più %d s", cfg.drenaggio);
+    g11_avvia_arresto();
+    struct timespec scadenza_arresto;
+    clock_gettime(CLOCK_REALTIME, &scadenza_arresto);
+    scadenza_arresto.tv_sec += cfg.drenaggio;
+    int conclusi = 0;
+    while (conclusi < n_lavoratori && pthread_timedjoin_np(lavoratori[conclusi].thread, NULL, &scadenza_arresto) == 0) {
+        conclusi++;
+    }
+    if (conclusi < n_lavoratori) {
+        G11_LOG_AVVISO("arresto: datagrammi ancora in arrivo dopo %d s, il server termina", cfg.drenaggio);
+        g11_forza_arresto(); // recvmmsg attende al più CONTROLLO_MS
+        for (int i = conclusi; i < n_lavoratori; i++) {
+            pthread_join(lavoratori[i].thread, NULL);
+        }
+    } else {
+        G11_LOG_INFO("arresto completato");
+    }
+    for (int i = 0; i < n_socket; i++) {
+        close(socket_dati[i]);
+    }
+
+    // Ultimo stato delle metriche sullo standard output; il log viene scaricato da exit
+    if (g11_metriche_socket() >= 0) {
+        printf("Metriche finali:\n");
+        g11_metriche_esporta(stdout, "udp");
+    }
+    return conclusi == n_lavoratori ? 0 : 1;
+}
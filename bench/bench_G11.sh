@@ -0,0 +1,256 @@
+#!/usr/bin/env bash
+# Benchmark dei server TCP e UDP su loopback.
+#
+# Avvia ogni server, lo misura con il generatore di carico dei client (-g) variando protocollo, numero di
+# client, profondità della pipeline e dimensione dei lotti, e scrive una riga CSV per ogni combinazione:
+# richieste/s, percentili di latenza, CPU del server per richiesta (da /proc/<pid>/stat), chiamate di
+# sistema per richiesta (con perf o strace, altrimenti NA) e cambi di contesto per richiesta.
+#
+# Uso:
+#   bench/bench_G11.sh [-o risultati.csv] [-d secondi]        esegue il benchmark
+#   bench/bench_G11.sh -c riferimento.csv risultati.csv       confronta con un riferimento salvato
+#   bench/bench_G11.sh -a [-d secondi]                        verifica che a regime i server non allochino
+#
+# La sequenza di prove si cambia con le variabili d'ambiente (valori separati da spazi):
+#   PROTOCOLLI (tcp udp)  CLIENTI (1 8 32)  PROFONDITA (1 16)  LOTTI (1 64)
+#   THREAD_SERVER (1)  MOTORE (epoll o uring, per il server TCP)  PORTA (9700)  SOGLIA (percentuale di peggioramento tollerata nel confronto, 10)
+set -u
+
+RADICE=$(cd "$(dirname "$0")/.." && pwd)
+RISULTATI="$RADICE/bench/risultati.csv"
+DURATA=3
+CONFRONTO=""
+ALLOCAZIONI=0
+
+PROTOCOLLI=${PROTOCOLLI:-"tcp udp"}
+CLIENTI=${CLIENTI:-"1 8 32"}
+PROFONDITA=${PROFONDITA:-"1 16"}
+LOTTI=${LOTTI:-"1 64"}
+THREAD_SERVER=${THREAD_SERVER:-1}
+MOTORE=${MOTORE:-epoll}
+PORTA=${PORTA:-9700}
+SOGLIA=${SOGLIA:-10}
+
+INTESTAZIONE="data,commit,protocollo,clienti,profondita,lotto,thread_server,durata_s,req_s,op_s,p50_us,p99_us,p999_us,max_us,cpu_us_req,syscall_req,ctxsw_req,errori,perse"
+
+while getopts "o:d:c:a" opt; do
+    case $opt in
+        o) RISULTATI=$OPTARG ;;
+        d) DURATA=$OPTARG ;;
+        c) CONFRONTO=$OPTARG ;;
+        a) ALLOCAZIONI=1 ;;
+        *) sed -n '9,12p' "$0" >&2; exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+# --- Confronto con il riferimento ---
+# Per ogni combinazione presente in entrambi i file segnala una regressione se le richieste/s calano
+# o la latenza p99 cresce più della soglia. Esce con 1 se ne trova almeno una.
+if [ -n "$CONFRONTO" ]; then
+    NUOVI=${1:-$RISULTATI}
+    awk -F, -v soglia="$SOGLIA" '
+        FNR == 1 { next }
+        { chiave = $3 "," $4 "," $5 "," $6 "," $7 }
+        NR == FNR { rif_req[chiave] = $9; rif_p99[chiave] = $12; next }
+        !(chiave in rif_req) { next }
+        {
+            d_req = rif_req[chiave] > 0 ? ($9 - rif_req[chiave]) * 100 / rif_req[chiave] : 0
+            d_p99 = rif_p99[chiave] > 0 ? ($12 - rif_p99[chiave]) * 100 / rif_p99[chiave] : 0
+            esito = (d_req < -soglia || d_p99 > soglia) ? "REGRESSIONE" : "ok"
+            if (esito != "ok") regressioni++
+            printf "%-4s clienti=%-4s prof=%-4s lotto=%-5s thread=%-3s req/s %12.0f -> %12.0f (%+6.1f%%)  p99 %9.1f -> %9.1f us (%+6.1f%%)  %s\n",
+                   $3, $4, $5, $6, $7, rif_req[chiave], $9, d_req, rif_p99[chiave], $12, d_p99, esito
+            confrontate++
+        }
+        END {
+            printf "%d combinazioni confrontate, %d regressioni (soglia %s%%)\n", confrontate, regressioni, soglia
+            exit regressioni > 0
+        }' "$CONFRONTO" "$NUOVI"
+    exit $?
+fi
+
+# --- Verifica delle allocazioni ---
+# Usa i server compilati con -DG11_CONTA_ALLOC (make verifica-alloc), che espongono nelle metriche le
+# chiamate a malloc e free dei lavoratori. Un primo giro di carico scalda gli allocatori (lastre delle
+# connessioni, buffer dei lotti grandi, aree degli interi grandi, cache delle espressioni); il secondo giro
+# ripete lo stesso carico e non deve fare nessuna allocazione. Ogni server viene provato anche con la cache
+# dei risultati (-M), che a regime sostituisce voci di continuo. Esce con 1 se ne trova.
+if [ "$ALLOCAZIONI" = 1 ]; then
+    CLIENT="$RADICE/TCP/client-TCP_G11"
+    for p in TCP/server-TCP_G11-conta UDP/server-UDP_G11-conta TCP/client-TCP_G11; do
+        if [ ! -x "$RADICE/$p" ]; then
+            echo "Manca $p: eseguire make verifica-alloc" >&2
+            exit 1
+        fi
+    done
+    SERVER_PID=""
+    trap '[ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null' EXIT
+
+    # Chiamate a malloc e free dei lavoratori, lette dalla porta delle metriche
+    allocazioni() {
+        exec 3<>"/dev/tcp/127.0.0.1/$1" || return 1
+        printf 'GET /metrics HTTP/1.0\r\n\r\n' >&3
+        awk '/^g11_allocazioni_totale/ { s += $2 } END { print s + 0 }' <&3
+        exec 3<&-
+    }
+
+    # Un giro di carico: operazioni singole e lotti, più lotti grandi, interi grandi ed espressioni su TCP
+    giro() {
+        for lotto in 1 64; do
+            "$CLIENT" 127.0.0.1 "$PORTA" -g -P "$1" -C 8 -j 2 -q 16 -l "$lotto" -d "$DURATA" > /dev/null
+        done
+        if [ "$1" = tcp ]; then
+            "$CLIENT" 127.0.0.1 "$PORTA" -g -P tcp -C 2 -j 1 -q 4 -l 8192 -d "$DURATA" > /dev/null
+            printf 'M 123456789012345678901234567890123456789 98765432109876543210987654321\nD 1%0300d 7\n' 0 |
+                "$CLIENT" 127.0.0.1 "$PORTA" -s -T grande > /dev/null
+            printf '1 2 3\n4 5 6\n' | "$CLIENT" 127.0.0.1 "$PORTA" -E "(a+b)*c" > /dev/null
+        fi
+    }
+
+    esito=0
+    for protocollo in $PROTOCOLLI; do for cache in "" "-M 16 -A tutti"; do
+        nome="$protocollo${cache:+ $cache}"
+        if [ "$protocollo" = tcp ]; then
+            "$RADICE/TCP/server-TCP_G11-conta" "$PORTA" -t "$THREAD_SERVER" -e "$MOTORE" -m $((PORTA + 1)) $cache > /dev/null &
+        else
+            "$RADICE/UDP/server-UDP_G11-conta" "$PORTA" -t "$THREAD_SERVER" -m $((PORTA + 1)) $cache > /dev/null &
+        fi
+        SERVER_PID=$!
+        sleep 0.3
+        giro "$protocollo"
+        a1=$(allocazioni $((PORTA + 1)))
+        giro "$protocollo"
+        a2=$(allocazioni $((PORTA + 1)))
+        kill "$SERVER_PID"
+        wait "$SERVER_PID" 2>/dev/null
+        SERVER_PID=""
+        if [ -z "$a1" ] || [ -z "$a2" ]; then
+            echo "$nome: metriche non disponibili" >&2
+            esito=1
+            continue
+        fi
+        if [ "$a2" -eq "$a1" ]; then
+            echo "$nome: $a1 allocazioni nel riscaldamento, 0 a regime: ok"
+        else
+            echo "$nome: $((a2 - a1)) allocazioni a regime (dopo $a1 nel riscaldamento): ALLOCAZIONI"
+            esito=1
+        fi
+    done; done
+    exit $esito
+fi
+
+# --- Esecuzione del benchmark ---
+for p in TCP/server-TCP_G11 TCP/client-TCP_G11 UDP/server-UDP_G11; do
+    if [ ! -x "$RADICE/$p" ]; then
+        echo "Manca $p: eseguire prima make" >&2
+        exit 1
+    fi
+done
+
+TICK=$(getconf CLK_TCK)
+COMMIT=$(git -C "$RADICE" rev-parse --short HEAD 2>/dev/null || echo NA)
+DATA=$(date -u +%Y-%m-%dT%H:%M:%SZ)
+NCPU=$(nproc)
+STRUMENTO=NA
+if command -v perf >/dev/null 2>&1; then
+    STRUMENTO=perf
+elif command -v strace >/dev/null 2>&1; then
+    STRUMENTO=strace
+fi
+TMP=$(mktemp -d)
+SERVER_PID=""
+trap '[ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null; rm -rf "$TMP"' EXIT
+
+echo "$INTESTAZIONE" > "$RISULTATI"
+
+# Tempo di CPU del processo (utente + sistema, tutti i thread) in tick
+cpu_server() {
+    awk '{ print $14 + $15 }' "/proc/$1/stat"
+}
+
+# Cambi di contesto volontari e involontari di tutti i thread del processo
+ctxsw_server() {
+    cat /proc/"$1"/task/*/status 2>/dev/null | awk '/ctxt_switches/ { s += $2 } END { print s + 0 }'
+}
+
+# Avvia il contatore di chiamate di sistema sul server, se disponibile
+avvia_contatore() {
+    case $STRUMENTO in
+        perf) perf stat -e raw_syscalls:sys_enter -x, -p "$1" -o "$TMP/syscall" & ;;
+        strace) strace -c -f -p "$1" -o "$TMP/syscall" 2>/dev/null & ;;
+        *) return ;;
+    esac
+    CONTATORE_PID=$!
+    sleep 0.2
+}
+
+# Ferma il contatore e stampa il numero di chiamate di sistema osservate (NA se non disponibile)
+ferma_contatore() {
+    if [ "$STRUMENTO" = NA ]; then
+        echo NA
+        return
+    fi
+    kill -INT "$CONTATORE_PID" 2>/dev/null
+    wait "$CONTATORE_PID" 2>/dev/null
+    case $STRUMENTO in
+        perf) awk -F, '/raw_syscalls/ { print $1 + 0; exit }' "$TMP/syscall" ;;
+        # Riga "total" di strace -c: % time, seconds, usecs/call, calls, [errors,] total. La colonna
+        # degli errori compare solo se ce ne sono (EAGAIN è continuo con i socket non bloccanti)
+        strace) awk '$NF == "total" { print $4 + 0 }' "$TMP/syscall" ;;
+    esac
+}
+
+# Estrae il valore di una chiave dalla riga RISULTATO del generatore di carico
+campo() {
+    tr ' ' '\n' < "$TMP/client" | awk -F= -v k="$1" '$1 == k { print $2 }'
+}
+
+for protocollo in $PROTOCOLLI; do
+    if [ "$protocollo" = tcp ]; then
+        "$RADICE/TCP/server-TCP_G11" "$PORTA" -t "$THREAD_SERVER" -e "$MOTORE" > /dev/null &
+    else
+        "$RADICE/UDP/server-UDP_G11" "$PORTA" -t "$THREAD_SERVER" > /dev/null &
+    fi
+    SERVER_PID=$!
+    sleep 0.3
+    if ! kill -0 "$SERVER_PID" 2>/dev/null; then
+        echo "Il server $protocollo non si è avviato sulla porta $PORTA" >&2
+        exit 1
+    fi
+
+    for clienti in $CLIENTI; do
+        for profondita in $PROFONDITA; do
+            for lotto in $LOTTI; do
+                thread=$(( clienti < NCPU ? clienti : NCPU ))
+                avvia_contatore "$SERVER_PID"
+                cpu0=$(cpu_server "$SERVER_PID")
+                cs0=$(ctxsw_server "$SERVER_PID")
+                "$RADICE/TCP/client-TCP_G11" 127.0.0.1 "$PORTA" -g -P "$protocollo" -C "$clienti" -j "$thread" \
+                    -q "$profondita" -l "$lotto" -d "$DURATA" | grep '^RISULTATO' > "$TMP/client"
+                cpu1=$(cpu_server "$SERVER_PID")
+                cs1=$(ctxsw_server "$SERVER_PID")
+                syscall=$(ferma_contatore)
+
+                completate=$(campo completate)
+                if [ -z "$completate" ]; then
+                    echo "Prova fallita: $protocollo clienti=$clienti profondita=$profondita lotto=$lotto" >&2
+                    continue
+                fi
+                riga=$(awk -v c="$completate" -v cpu=$((cpu1 - cpu0)) -v tick="$TICK" -v cs=$((cs1 - cs0)) -v sc="$syscall" 'BEGIN {
+                    if (c == 0) c = 1
+                    printf "%.3f,%s,%.3f", cpu / tick * 1e6 / c, sc == "NA" ? "NA" : sprintf("%.3f", sc / c), cs / c
+                }')
+                echo "$DATA,$COMMIT,$protocollo,$clienti,$profondita,$lotto,$THREAD_SERVER,$(campo durata),$(campo req_s),$(campo op_s),$(campo p50_us),$(campo p99_us),$(campo p999_us),$(campo max_us),$riga,$(campo errori),$(campo perse)" >> "$RISULTATI"
+                printf '%-4s clienti=%-4s prof=%-4s lotto=%-5s %12s req/s  p99 %8s us\n' \
+                    "$protocollo" "$clienti" "$profondita" "$lotto" "$(campo req_s)" "$(campo p99_us)"
+            done
+        done
+    done
+
+    kill "$SERVER_PID"
+    wait "$SERVER_PID" 2>/dev/null
+    SERVER_PID=""
+done
+
+echo "Risultati in $RISULTATI (chiamate di sistema: $STRUMENTO)"
@@ -0,0 +1,206 @@
+// Verifica degli interi grandi (common/grandi_G11.h) con "make verifica-grandi".
+//
+// Confronta i risultati di g11_grandi_esegui con valori noti:
+// - una tabella di casi decimali: segni, zero, troncamento dei quozienti negativi e divisori che nell'algoritmo
+//   D di Knuth richiedono la correzione della stima qhat (D3) e la risomma del divisore (D6);
+// - i quadrati di B^n - 1 (B = 2^32), di cui si conoscono le cifre, a cavallo di G11_KARATSUBA_SOGLIA;
+// - prodotti con Karatsuba e operandi di lunghezze diverse, confrontati con il prodotto scolastico;
+// - quozienti di a = q·b + r con 0 <= r < b, che devono valere q (e -q con a negativo).
+// Termina con stato 1 se un risultato è errato.
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "../common/grandi_G11.h"
+
+#define MAX_CIFRE 512               // Cifre massime degli operandi usati dalle verifiche
+
+static int verifiche, errate;
+
+// Operandi, risultati attesi e testo di lavoro
+static uint32_t cifre_a[MAX_CIFRE], cifre_b[MAX_CIFRE], cifre_q[MAX_CIFRE], atteso[2 * MAX_CIFRE];
+static char testo[10 * 2 * MAX_CIFRE + 2];
+
+// Generatore xorshift: sequenze ripetibili senza dipendere da rand
+static uint64_t stato_generatore = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t casuale(void) {
+    stato_generatore ^= stato_generatore << 13;
+    stato_generatore ^= stato_generatore >> 7;
+    stato_generatore ^= stato_generatore << 17;
+    return (uint32_t) (stato_generatore >> 32);
+}
+
+static void riempi(uint32_t *x, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        x[i] = casuale();
+    }
+    if (n > 0 && x[n - 1] == 0) {
+        x[n - 1] = 1; // Cifra più alta non nulla: l'operando ha proprio n cifre
+    }
+}
+
+static void segnala(const char *cosa, int esito) {
+    verifiche++;
+    if (!esito) {
+        errate++;
+        printf("ERRATA: %s\n", cosa);
+    }
+}
+
+// Esegue 'op' e prepara l'arena come fanno i server
+static uint8_t esegui(uint8_t op, const struct g11_grande *a, const struct g11_grande *b, struct g11_grande *r) {
+    if (g11_pool_prepara(g11_grandi_spazio(op, a->n, b->n)) < 0) {
+        fprintf(stderr, "memoria insufficiente\n");
+        exit(1);
+    }
+    return g11_grandi_esegui(op, a, b, r);
+}
+
+// --- Casi decimali ---
+
+struct caso {
+    char op;
+    const char *a, *b;
+    const char *risultato;          // NULL: divisione per zero
+};
+
+static const struct caso casi[] = {
+    { 'A', "0", "0", "0" },
+    { 'A', "-5", "5", "0" },
+    { 'A', "4294967295", "1", "4294967296" },
+    { 'A', "-18446744073709551615", "-1", "-18446744073709551616" },
+    { 'S', "5", "8", "-3" },
+    { 'S', "-5", "-8", "3" },
+    { 'S', "18446744073709551616", "1", "18446744073709551615" },
+    { 'M', "-3", "0", "0" },
+    { 'M', "-4294967296", "4294967296", "-18446744073709551616" },
+    { 'M', "18446744073709551615", "18446744073709551615", "340282366920938463426481119284349108225" },
+    { 'M', "-12345678901234567890", "-98765432109876543210", "1219326311370217952237463801111263526900" },
+    { 'D', "7", "2", "3" },
+    { 'D', "-7", "2", "-3" },
+    { 'D', "7", "-2", "-3" },
+    { 'D', "-7", "-2", "3" },
+    { 'D', "-1", "2", "0" },
+    { 'D', "3", "18446744073709551616", "0" },
+    { 'D', "1", "0", NULL },
+    { 'D', "0", "-0", NULL },
+    { 'D', "79228162514264337593543950336", "4294967297", "18446744069414584320" },
+    // Stima qhat da correggere in D3 e sottrazione da non trattare con segno (cifre 0x80000000, 0x7fffffff)
+    { 'D', "170141183420855150474555134919112130560", "39614081257132168796771975169", "4294967294" },
+    { 'D', "-170141183420855150474555134919112130560", "39614081257132168796771975169", "-4294967294" },
+    // Stima qhat più grande di uno dopo D3: serve la risomma del divisore in D6
+    { 'D', "2596148429267413814546714551386112", "604462909807314587418623", "4294967295" },
+    { 'D', "2596069201709362459734969208012800", "604462909807314587353089", "4294836224" },
+    { 'D', "604462909807314587353091", "151115727451828646838273", "3" },
+};
+
+static void verifica_casi(void) {
+    for (size_t i = 0; i < sizeof(casi) / sizeof(casi[0]); i++) {
+        const struct caso *c = &casi[i];
+        struct g11_grande a, b, r;
+        g11_grande_da_testo(c->a, &a, cifre_a, MAX_CIFRE);
+        g11_grande_da_testo(c->b, &b, cifre_b, MAX_CIFRE);
+        uint8_t stato = esegui((uint8_t) c->op, &a, &b, &r);
+        char cosa[256];
+        snprintf(cosa, sizeof(cosa), "%s %c %s", c->a, c->op, c->b);
+        if (c->risultato == NULL) {
+            segnala(cosa, stato == G11_STATO_DIV_ZERO);
+        } else {
+            segnala(cosa, stato == G11_STATO_OK && strcmp(g11_grande_a_testo(&r, testo), c->risultato) == 0);
+        }
+    }
+}
+
+// --- Quadrati di B^n - 1 ---
+
+// (B^n - 1)^2 = B^2n - 2·B^n + 1: cifre 1, n - 1 zeri, 0xfffffffe e n - 1 volte 0xffffffff.
+static void verifica_quadrati(void) {
+    static const uint32_t lunghezze[] = { 1, 2, 31, 32, 33, 63, 64, 65, 97, 128, 130, 257 };
+    for (size_t k = 0; k < sizeof(lunghezze) / sizeof(lunghezze[0]); k++) {
+        uint32_t n = lunghezze[k];
+        for (uint32_t i = 0; i < n; i++) {
+            cifre_a[i] = 0xFFFFFFFFu;
+        }
+        memset(atteso, 0, 2 * n * sizeof(uint32_t));
+        atteso[0] = 1;
+        atteso[n] = 0xFFFFFFFEu;
+        for (uint32_t i = n + 1; i < 2 * n; i++) {
+            atteso[i] = 0xFFFFFFFFu;
+        }
+        struct g11_grande a = { cifre_a, n, 0 }, r;
+        esegui(G11_OP_MOLTIPLICAZIONE, &a, &a, &r);
+        char cosa[64];
+        snprintf(cosa, sizeof(cosa), "(B^%u - 1)^2", n);
+        segnala(cosa, r.n == 2 * n && memcmp(r.cifre, atteso, 2 * n * sizeof(uint32_t)) == 0);
+    }
+}
+
+// --- Karatsuba contro prodotto scolastico ---
+
+static void verifica_prodotti(void) {
+    static const uint32_t lunghezze[] = { 1, 31, 32, 33, 48, 64, 65, 100, 200 };
+    const size_t m = sizeof(lunghezze) / sizeof(lunghezze[0]);
+    for (size_t i = 0; i < m; i++) {
+        for (size_t j = 0; j < m; j++) {
+            uint32_t na = lunghezze[i], nb = lunghezze[j];
+            riempi(cifre_a, na);
+            riempi(cifre_b, nb);
+            g11_cifre_prodotto_scuola(atteso, cifre_a, na, cifre_b, nb);
+            struct g11_grande a = { cifre_a, na, 1 }, b = { cifre_b, nb, 0 }, r;
+            esegui(G11_OP_MOLTIPLICAZIONE, &a, &b, &r);
+            char cosa[64];
+            snprintf(cosa, sizeof(cosa), "prodotto di %u e %u cifre", na, nb);
+            segnala(cosa, r.negativo && r.n == g11_cifre_normalizza(atteso, na + nb) &&
+                          memcmp(r.cifre, atteso, r.n * sizeof(uint32_t)) == 0);
+        }
+    }
+}
+
+// --- Quozienti noti ---
+
+// a = q·b + r con 0 <= r < b: la divisione deve dare q, e -q (troncato verso zero) con a negativo.
+static void verifica_quozienti(void) {
+    static const uint32_t divisori[] = { 1, 2, 3, 17, 32, 33, 100 };
+    static const uint32_t alte[] = { 1, 0x7FFFFFFFu, 0x80000000u, 0xFFFFFFFFu }; // Spostamento di D1
+    for (size_t i = 0; i < sizeof(divisori) / sizeof(divisori[0]); i++) {
+        for (size_t k = 0; k < sizeof(alte) / sizeof(alte[0]); k++) {
+            for (uint32_t nq = 1; nq <= 40; nq += 13) {
+                uint32_t nb = divisori[i];
+                riempi(cifre_b, nb);
+                cifre_b[nb - 1] = alte[k];
+                riempi(cifre_q, nq);
+                // a = q·b, poi + r con r = b - 1 (il resto più grande) oppure 0
+                uint32_t na = nq + nb;
+                g11_cifre_prodotto_scuola(cifre_a, cifre_q, nq, cifre_b, nb);
+                int con_resto = (nq + k) % 2;
+                if (con_resto) {
+                    memcpy(atteso, cifre_b, nb * sizeof(uint32_t));
+                    atteso[0]--; // b ha una cifra alta non nulla, quindi b - 1 non va sotto zero
+                    for (uint32_t c = 0; atteso[c] == 0xFFFFFFFFu && c + 1 < nb; c++) {
+                        atteso[c + 1]--;
+                    }
+                    g11_cifre_somma(cifre_a, cifre_a, na, atteso, g11_cifre_normalizza(atteso, nb));
+                }
+                na = g11_cifre_normalizza(cifre_a, na);
+                for (int negativo = 0; negativo <= 1; negativo++) {
+                    struct g11_grande a = { cifre_a, na, negativo }, b = { cifre_b, nb, 0 }, r;
+                    uint8_t stato = esegui(G11_OP_DIVISIONE, &a, &b, &r);
+                    char cosa[96];
+                    snprintf(cosa, sizeof(cosa), "%s(%u cifre, resto %s) / %u cifre (alta %08x)", negativo ? "-" : "",
+                             na, con_resto ? "b - 1" : "0", nb, alte[k]);
+                    segnala(cosa, stato == G11_STATO_OK && r.negativo == negativo && r.n == nq &&
+                                  memcmp(r.cifre, cifre_q, nq * sizeof(uint32_t)) == 0);
+                }
+            }
+        }
+    }
+}
+
+int main(void) {
+    verifica_casi();
+    verifica_quadrati();
+    verifica_prodotti();
+    verifica_quozienti();
+    printf("grandi: %d verifiche, %d errate%s\n", verifiche, errate, errate == 0 ? ": ok" : "");
+    return errate == 0 ? 0 : 1;
+}
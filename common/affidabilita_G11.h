@@ -0,0 +1,159 @@
+// Affidabilità dello scambio su UDP.
+//
+// Lato client: stima del tempo di andata e ritorno (RTT) e calcolo del timeout di ritrasmissione (RTO)
+// secondo l'algoritmo di Jacobson/Karels (RFC 6298), con raddoppio del timeout a ogni ritrasmissione.
+// Lato server: piccola cache delle risposte già inviate, indicizzata da mittente e id della richiesta,
+// così una richiesta ritrasmessa riceve la stessa risposta senza essere ricalcolata.
+#ifndef AFFIDABILITA_G11_H
+#define AFFIDABILITA_G11_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+
+#define G11_RTO_INIZIALE_US 100000  // Timeout prima del primo campione di RTT (100 ms)
+#define G11_RTO_MIN_US 2000         // Limite inferiore del timeout (2 ms): le risposte del calcolatore sono immediate
+#define G11_RTO_MAX_US 2000000      // Limite superiore del timeout (2 s)
+#define G11_RTO_GRANULARITA_US 1000 // Granularità dell'orologio usata nel calcolo dell'RTO
+
+// Tempo monotono in microsecondi
+static inline int64_t g11_adesso_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// --- Stima dell'RTT (client) ---
+
+struct g11_stima_rtt {
+    int64_t srtt;    // RTT medio smussato (us), 0 finché non arriva il primo campione
+    int64_t rttvar;  // Variazione media dell'RTT (us)
+    int64_t rto;     // Timeout di ritrasmissione corrente (us)
+};
+
+static inline void g11_rtt_inizializza(struct g11_stima_rtt *s, int64_t rto_iniziale) {
+    s->srtt = 0;
+    s->rttvar = 0;
+    s->rto = rto_iniziale > 0 ? rto_iniziale : G11_RTO_INIZIALE_US;
+}
+
+static inline int64_t g11_rtt_limita(int64_t rto) {
+    return rto < G11_RTO_MIN_US ? G11_RTO_MIN_US : rto > G11_RTO_MAX_US ? G11_RTO_MAX_US : rto;
+}
+
+// Aggiorna la stima con un nuovo campione. Per l'algoritmo di Karn vanno usati solo i campioni
+// delle richieste mai ritrasmesse, altrimenti non si sa a quale invio corrisponde la risposta.
+static inline void g11_rtt_campione(struct g11_stima_rtt *s, int64_t r) {
+    if (s->srtt == 0) {
+        s->srtt = r;
+        s->rttvar = r / 2;
+    } else {
+        int64_t diff = s->srtt > r ? s->srtt - r : r - s->srtt;
+        s->rttvar = (3 * s->rttvar + diff) / 4;
+        s->srtt = (7 * s->srtt + r) / 8;
+    }
+    int64_t var = 4 * s->rttvar;
+    s->rto = g11_rtt_limita(s->srtt + (var > G11_RTO_GRANULARITA_US ? var : G11_RTO_GRANULARITA_US));
+}
+
+// Timeout del tentativo successivo di una stessa richiesta (backoff esponenziale). Il raddoppio resta
+// locale alla richiesta: quella seguente riparte dall'RTO stimato, così una raffica di perdite non
+// lascia il client con timeout gonfiati fino al limite superiore.
+static inline int64_t g11_rto_backoff(int64_t rto) {
+    return g11_rtt_limita(rto * 2);
+}
+
+// --- Cache delle risposte (server) ---
+
+#define G11_CACHE_RISPOSTE_PREDEFINITA 4096 // Voci della cache di ogni lavoratore
+#define G11_CACHE_MAX_RISPOSTA 256          // Risposte più lunghe (lotti grandi) non vengono conservate
+#define G11_CACHE_DURATA_US 5000000         // Una voce vale 5 s, oltre la finestra di ritrasmissione del client
+
+// Impronta a 64 bit di un blocco di byte (FNV-1a), usata per distinguere richieste diverse con lo stesso id
+static inline uint64_t g11_impronta(const uint8_t *p, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+struct g11_voce_risposta {
+    uint32_t indirizzo;   // Indirizzo IPv4 del mittente (network order)
+    uint16_t porta;       // Porta del mittente (network order)
+    uint16_t lunghezza;   // Byte della risposta, 0 se la voce è libera
+    uint32_t id;          // Id della richiesta
+    uint64_t impronta;    // Impronta della richiesta
+    int64_t scadenza;     // Istante oltre il quale la voce non è più valida
+    uint8_t risposta[G11_CACHE_MAX_RISPOSTA];
+};
+
+// Cache a indirizzamento diretto, una per lavoratore: nessun lock, una collisione sostituisce la voce precedente.
+struct g11_cache_risposte {
+    struct g11_voce_risposta *voci;
+    uint32_t maschera;    // Numero di voci - 1 (le voci sono una potenza di 2)
+    uint64_t colpi;       // Richieste duplicate servite dalla cache
+};
+
+// Prepara una cache di almeno 'voci' elementi (0 la disattiva). Ritorna -1 se manca memoria.
+static inline int g11_cache_risposte_crea(struct g11_cache_risposte *c, uint32_t voci) {
+    memset(c, 0, sizeof(*c));
+    if (voci == 0) {
+        return 0;
+    }
+    uint32_t n = 1;
+    while (n < voci) {
+        n <<= 1;
+    }
+    c->voci = calloc(n, sizeof(*c->voci));
+    if (c->voci == NULL) {
+        return -1;
+    }
+    c->maschera = n - 1;
+    return 0;
+}
+
+static inline struct g11_voce_risposta *g11_cache_risposte_voce(struct g11_cache_risposte *c,
+                                                                const struct sockaddr_in *da, uint32_t id) {
+    uint64_t h = ((uint64_t) da->sin_addr.s_addr << 16 | da->sin_port) * 0x9E3779B97F4A7C15ULL ^ id;
+    h ^= h >> 29;
+    return &c->voci[(uint32_t) (h * 0xBF58476D1CE4E5B9ULL >> 32) & c->maschera];
+}
+
+// Cerca la risposta già inviata a questa richiesta. Ritorna la sua lunghezza (copiandola in 'out')
+// oppure 0 se la richiesta non è un duplicato recente.
+static inline size_t g11_cache_risposte_cerca(struct g11_cache_risposte *c, const struct sockaddr_in *da,
+                                              uint32_t id, uint64_t impronta, int64_t adesso, uint8_t *out) {
+    if (c->voci == NULL) {
+        return 0;
+    }
+    struct g11_voce_risposta *v = g11_cache_risposte_voce(c, da, id);
+    if (v->lunghezza == 0 || v->id != id || v->impronta != impronta || v->scadenza < adesso ||
+        v->indirizzo != da->sin_addr.s_addr || v->porta != da->sin_port) {
+        return 0;
+    }
+    memcpy(out, v->risposta, v->lunghezza);
+    c->colpi++;
+    return v->lunghezza;
+}
+
+// Conserva la risposta appena calcolata, se abbastanza corta.
+static inline void g11_cache_risposte_inserisci(struct g11_cache_risposte *c, const struct sockaddr_in *da,
+                                                uint32_t id, uint64_t impronta, int64_t adesso,
+                                                const uint8_t *risposta, size_t len) {
+    if (c->voci == NULL || len > G11_CACHE_MAX_RISPOSTA) {
+        return;
+    }
+    struct g11_voce_risposta *v = g11_cache_risposte_voce(c, da, id);
+    v->indirizzo = da->sin_addr.s_addr;
+    v->porta = da->sin_port;
+    v->id = id;
+    v->impronta = impronta;
+    v->scadenza = adesso + G11_CACHE_DURATA_US;
+    v->lunghezza = (uint16_t) len;
+    memcpy(v->risposta, risposta, len);
+}
+
+#endif // AFFIDABILITA_G11_H
@@ -0,0 +1,89 @@
+// Limite di tasso per client dei server (opzioni -r e -B): ogni indirizzo IPv4 ha un secchio di gettoni
+// con tasso r richieste al secondo e capienza b (la raffica ammessa dopo un periodo di silenzio).
+//
+// Il secchio segue l'algoritmo GCRA (generic cell rate algorithm), equivalente a un token bucket ma con un
+// solo valore per client: l'istante teorico di arrivo (TAT) della prossima richiesta. Una richiesta che
+// arriva in t è ammessa se max(TAT, t) - t <= (b - 1) / r, e in tal caso TAT diventa max(TAT, t) + 1 / r.
+// Il valore occupa una parola da 64 bit aggiornata con compare-and-swap, quindi la tabella è condivisa da
+// tutti i lavoratori senza lock: le connessioni TCP di uno stesso client, distribuite da SO_REUSEPORT,
+// finiscono su lavoratori diversi ma consumano gli stessi gettoni.
+//
+// La tabella ha G11_TASSO_VOCI posti indicizzati da un'impronta dell'indirizzo: due indirizzi che cadono
+// nello stesso posto condividono il secchio, quindi il limite può solo risultare più severo, mai più largo.
+#ifndef AMMISSIONE_G11_H
+#define AMMISSIONE_G11_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define G11_TASSO_ORDINE 16                     // La tabella ha 2^16 posti (512 KB)
+#define G11_TASSO_VOCI (1u << G11_TASSO_ORDINE)
+
+struct g11_tasso {
+    uint64_t *arrivi;       // TAT di ogni posto in ns (CLOCK_MONOTONIC), scritto da tutti i lavoratori
+    uint64_t intervallo;    // ns tra due richieste al tasso limite (1 / r), 0 = limite disattivato
+    uint64_t tolleranza;    // Anticipo massimo sul tasso limite in ns ((b - 1) / r)
+};
+
+// Tempo monotono in ns, letto una volta per risveglio dal lavoratore e passato a g11_tasso_ammetti.
+static inline uint64_t g11_tasso_adesso(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+// Imposta il limite a r richieste al secondo con raffiche di b (b < 1 vale 1); r = 0 lo disattiva. Si può
+// richiamare mentre i lavoratori lo usano (ricarica della configurazione): la tabella viene allocata alla
+// prima attivazione e poi conservata, con gli arrivi già registrati. Ritorna -1 se manca memoria.
+static inline int g11_tasso_imposta(struct g11_tasso *t, double r, uint32_t b) {
+    if (r <= 0) {
+        __atomic_store_n(&t->intervallo, 0, __ATOMIC_RELAXED);
+        return 0;
+    }
+    if (t->arrivi == NULL && (t->arrivi = calloc(G11_TASSO_VOCI, sizeof(uint64_t))) == NULL) {
+        return -1;
+    }
+    uint64_t intervallo = (uint64_t) (1e9 / r);
+    if (intervallo == 0) {
+        intervallo = 1;
+    }
+    __atomic_store_n(&t->tolleranza, (b > 1 ? b - 1 : 0) * intervallo, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->intervallo, intervallo, __ATOMIC_RELEASE); // Pubblica anche la tabella appena allocata
+    return 0;
+}
+
+// Raffica corrispondente ai parametri attuali, per i messaggi di avvio e di ricarica.
+static inline uint32_t g11_tasso_raffica(const struct g11_tasso *t) {
+    uint64_t intervallo = __atomic_load_n(&t->intervallo, __ATOMIC_RELAXED);
+    return intervallo > 0 ? (uint32_t) (__atomic_load_n(&t->tolleranza, __ATOMIC_RELAXED) / intervallo + 1) : 0;
+}
+
+// Il limite è attivo (r > 0).
+static inline int g11_tasso_attivo(const struct g11_tasso *t) {
+    return __atomic_load_n(&t->intervallo, __ATOMIC_ACQUIRE) > 0;
+}
+
+// Consuma un gettone del client con indirizzo 'ip' (network byte order, come in sin_addr.s_addr).
+// Ritorna 1 se la richiesta è ammessa (sempre, con il limite disattivato), 0 se il client ha superato il suo tasso.
+static inline int g11_tasso_ammetti(struct g11_tasso *t, uint32_t ip, uint64_t adesso) {
+    uint64_t intervallo = __atomic_load_n(&t->intervallo, __ATOMIC_ACQUIRE);
+    if (intervallo == 0) {
+        return 1;
+    }
+    uint64_t tolleranza = __atomic_load_n(&t->tolleranza, __ATOMIC_RELAXED);
+    uint64_t *p = &t->arrivi[(ip * 0x9E3779B1u) >> (32 - G11_TASSO_ORDINE)];
+    uint64_t tat = __atomic_load_n(p, __ATOMIC_RELAXED);
+    for (;;) {
+        uint64_t base = tat > adesso ? tat : adesso;
+        if (base - adesso > tolleranza) {
+            return 0;
+        }
+        // Se un altro lavoratore ha aggiornato il posto nel frattempo, tat contiene il nuovo valore e si riprova
+        if (__atomic_compare_exchange_n(p, &tat, base + intervallo, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return 1;
+        }
+    }
+}
+
+#endif // AMMISSIONE_G11_H
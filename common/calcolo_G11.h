@@ -0,0 +1,337 @@
+// Nucleo di calcolo condiviso dai server TCP e UDP.
+// Trasforma un frame di richiesta nel frame di risposta corrispondente.
+#ifndef CALCOLO_G11_H
+#define CALCOLO_G11_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "protocollo_G11.h"
+#include "kernel_G11.h"
+#include "grandi_G11.h"
+#include "espressioni_G11.h"
+
+// Operazioni aritmetiche riconosciute, per i lotti e per i tipi diversi da int32
+static inline int g11_operazione_valida(uint8_t op) {
+    return op == G11_OP_ADDIZIONE || op == G11_OP_SOTTRAZIONE || op == G11_OP_MOLTIPLICAZIONE || op == G11_OP_DIVISIONE;
+}
+
+// Esegue l'operazione sui due interi e ritorna il codice di stato.
+// Un risultato fuori dall'intervallo di int32 (compreso INT32_MIN / -1) viene restituito troncato, come
+// l'aritmetica modulare, con stato G11_STATO_OVERFLOW; la divisione per zero restituisce 0 con stato
+// G11_STATO_DIV_ZERO, così il client la distingue da un risultato nullo.
+static inline uint8_t g11_esegui(uint8_t op, int32_t a, int32_t b, int32_t *risultato) {
+    switch (op) {
+        case G11_OP_ADDIZIONE:
+            return __builtin_add_overflow(a, b, risultato) ? G11_STATO_OVERFLOW : G11_STATO_OK;
+        case G11_OP_SOTTRAZIONE:
+            return __builtin_sub_overflow(a, b, risultato) ? G11_STATO_OVERFLOW : G11_STATO_OK;
+        case G11_OP_MOLTIPLICAZIONE:
+            return __builtin_mul_overflow(a, b, risultato) ? G11_STATO_OVERFLOW : G11_STATO_OK;
+        case G11_OP_DIVISIONE:
+            if (b == 0) {
+                *risultato = 0;
+                return G11_STATO_DIV_ZERO;
+            }
+            if (b == -1 && a == INT32_MIN) {
+                *risultato = INT32_MIN; // Il quoziente 2^31 non è rappresentabile e genererebbe SIGFPE
+                return G11_STATO_OVERFLOW;
+            }
+            *risultato = a / b;
+            return G11_STATO_OK;
+        default:
+            *risultato = 0;
+            return G11_STATO_OP_NON_VALIDA;
+    }
+}
+
+// Come g11_esegui, con operandi e risultato a 64 bit.
+static inline uint8_t g11_esegui_64(uint8_t op, int64_t a, int64_t b, int64_t *risultato) {
+    switch (op) {
+        case G11_OP_ADDIZIONE:
+            return __builtin_add_overflow(a, b, risultato) ? G11_STATO_OVERFLOW : G11_STATO_OK;
+        case G11_OP_SOTTRAZIONE:
+            return __builtin_sub_overflow(a, b, risultato) ? G11_STATO_OVERFLOW : G11_STATO_OK;
+        case G11_OP_MOLTIPLICAZIONE:
+            return __builtin_mul_overflow(a, b, risultato) ? G11_STATO_OVERFLOW : G11_STATO_OK;
+        case G11_OP_DIVISIONE:
+            if (b == 0) {
+                *risultato = 0;
+                return G11_STATO_DIV_ZERO;
+            }
+            if (b == -1 && a == INT64_MIN) {
+                *risultato = INT64_MIN;
+                return G11_STATO_OVERFLOW;
+            }
+            *risultato = a / b;
+            return G11_STATO_OK;
+        default:
+            *risultato = 0;
+            return G11_STATO_OP_NON_VALIDA;
+    }
+}
+
+// Operazione in virgola mobile: la divisione per zero restituisce 0 con G11_STATO_DIV_ZERO, un risultato
+// infinito a partire da operandi finiti viene restituito con G11_STATO_OVERFLOW.
+static inline uint8_t g11_esegui_double(uint8_t op, double a, double b, double *risultato) {
+    switch (op) {
+        case G11_OP_ADDIZIONE:       *risultato = a + b; break;
+        case G11_OP_SOTTRAZIONE:     *risultato = a - b; break;
+        case G11_OP_MOLTIPLICAZIONE: *risultato = a * b; break;
+        case G11_OP_DIVISIONE:
+            if (b == 0.0) {
+                *risultato = 0.0;
+                return G11_STATO_DIV_ZERO;
+            }
+            *risultato = a / b;
+            break;
+        default:
+            *risultato = 0.0;
+            return G11_STATO_OP_NON_VALIDA;
+    }
+    return __builtin_isinf(*risultato) && __builtin_isfinite(a) && __builtin_isfinite(b)
+           ? G11_STATO_OVERFLOW : G11_STATO_OK;
+}
+
+// Numero di coppie di un lotto ben formato, oppure -1 se il corpo non è coerente con la lunghezza del frame.
+static inline int64_t g11_coppie_lotto(const struct g11_frame *req) {
+    if (req->dim_corpo < G11_DIM_LOTTO) {
+        return -1;
+    }
+    uint32_t n = g11_leggi_u32(req->corpo + 4);
+    if (n > G11_MAX_LOTTO || req->lunghezza != g11_dim_richiesta_lotto(n)) {
+        return -1;
+    }
+    return n;
+}
+
+// Cifre dei due operandi di una richiesta G11_TIPO_GRANDE. Ritorna -1 se il corpo non è coerente con la
+// lunghezza del frame o gli operandi superano G11_GRANDI_MAX_CIFRE.
+static inline int g11_cifre_operandi(const struct g11_frame *req, uint32_t *na, uint32_t *nb) {
+    if (req->dim_corpo < 8) {
+        return -1;
+    }
+    *na = g11_leggi_u32(req->corpo) & ~G11_GRANDI_NEGATIVO;
+    *nb = g11_leggi_u32(req->corpo + 4) & ~G11_GRANDI_NEGATIVO;
+    if (*na > G11_GRANDI_MAX_CIFRE || *nb > G11_GRANDI_MAX_CIFRE || req->lunghezza != g11_dim_richiesta_grandi(*na, *nb)) {
+        return -1;
+    }
+    return 0;
+}
+
+// Campi di una richiesta G11_OP_ESPRESSIONE. Ritorna -1 se il corpo non è coerente con la lunghezza del frame.
+static inline int g11_analizza_espressione(const struct g11_frame *req, uint8_t *k, uint16_t *t, uint32_t *m) {
+    if (req->dim_corpo < G11_DIM_ESPRESSIONE) {
+        return -1;
+    }
+    *k = req->corpo[0];
+    *t = g11_leggi_u16(req->corpo + 2);
+    *m = g11_leggi_u32(req->corpo + 4);
+    if (*k > G11_ESPR_MAX_VARIABILI || *t > G11_ESPR_MAX_TESTO || *m > G11_MAX_LOTTO || (*k == 0 && *m > 1) ||
+        g11_dim_richiesta_espressione(*t, *k, *m) > G11_MAX_FRAME ||
+        req->lunghezza != g11_dim_richiesta_espressione(*t, *k, *m)) {
+        return -1;
+    }
+    return 0;
+}
+
+// Byte necessari per la risposta a una richiesta: il chiamante prepara lo spazio prima di elaborarla.
+static inline size_t g11_dim_risposta(const struct g11_frame *req) {
+    if (req->versione != G11_VERSIONE) {
+        return G11_DIM_RISPOSTA;
+    }
+    if (req->codice == G11_OP_LOTTO) {
+        int64_t n = g11_coppie_lotto(req);
+        if (n >= 0) {
+            return g11_dim_risposta_lotto((uint32_t) n);
+        }
+    } else if (req->codice == G11_OP_ESPRESSIONE) {
+        uint8_t k;
+        uint16_t t;
+        uint32_t m;
+        if (g11_analizza_espressione(req, &k, &t, &m) == 0) {
+            return g11_dim_risposta_lotto(m);
+        }
+    } else if (req->opzioni == G11_TIPO_INT64 || req->opzioni == G11_TIPO_DOUBLE) {
+        return G11_DIM_RISPOSTA_64;
+    } else if (req->opzioni == G11_TIPO_GRANDE) {
+        uint32_t na, nb;
+        if (g11_cifre_operandi(req, &na, &nb) == 0) {
+            return g11_dim_risposta_grande(g11_grandi_cifre_risultato(req->codice, na, nb));
+        }
+    }
+    return G11_DIM_RISPOSTA;
+}
+
+// Elabora un lotto: i kernel leggono gli operandi dal frame ricevuto e scrivono i risultati
+// direttamente nel frame di risposta.
+static inline size_t g11_elabora_lotto(const struct g11_frame *req, uint8_t *out) {
+    int64_t n = req->opzioni == G11_TIPO_INT32 ? g11_coppie_lotto(req) : -1; // I lotti sono solo int32
+    uint8_t op = req->dim_corpo >= G11_DIM_LOTTO ? req->corpo[0] : 0;
+    if (n < 0 || !g11_operazione_valida(op)) {
+        g11_codifica_risposta(out, n < 0 ? G11_STATO_FORMATO : G11_STATO_OP_NON_VALIDA, req->id, 0);
+        return G11_DIM_RISPOSTA;
+    }
+    uint32_t dim = g11_dim_risposta_lotto((uint32_t) n);
+    const uint8_t *a = req->corpo + G11_DIM_LOTTO;
+    uint8_t *risultati = out + G11_DIM_INTESTAZIONE + 4;
+    uint8_t *stati = risultati + 4u * (uint32_t) n;
+
+    g11_scrivi_intestazione(out, dim, G11_STATO_OK, 0, req->id);
+    g11_scrivi_u32(out + G11_DIM_INTESTAZIONE, (uint32_t) n);
+    g11_kernel_lotto()(op, a, a + 4u * (uint32_t) n, risultati, stati, (uint32_t) n);
+    memset(stati + n, 0, dim - (size_t) (stati + n - out)); // Riempimento fino a un multiplo di 4
+    return dim;
+}
+
+// Controlla la richiesta che apre un flusso e ne estrae operazione e numero di coppie.
+// Ritorna lo stato della risposta; con un corpo di lunghezza errata n vale 0 e il flusso non è delimitabile.
+static inline uint8_t g11_analizza_flusso(const struct g11_frame *req, uint8_t *op, uint64_t *n) {
+    *op = 0;
+    *n = 0;
+    if (req->dim_corpo != G11_DIM_FLUSSO) {
+        return G11_STATO_FORMATO;
+    }
+    *op = req->corpo[0];
+    *n = g11_leggi_u64(req->corpo + 4);
+    if (req->opzioni != G11_TIPO_INT32) {
+        return G11_STATO_FORMATO; // Come i lotti, il flusso è solo int32
+    }
+    return g11_operazione_valida(*op) ? G11_STATO_OK : G11_STATO_OP_NON_VALIDA;
+}
+
+// Elabora n <= G11_FLUSSO_BLOCCO coppie del flusso (a, b alternati) e ne scrive gli esiti da 8 byte.
+// Le coppie vengono separate in due vettori sulla pila, così il blocco passa dallo stesso kernel dei lotti.
+static inline void g11_elabora_coppie(uint8_t op, const uint8_t *coppie, uint32_t n, uint8_t *esiti) {
+    _Alignas(32) uint8_t a[4 * G11_FLUSSO_BLOCCO], b[4 * G11_FLUSSO_BLOCCO], r[4 * G11_FLUSSO_BLOCCO];
+    uint8_t stati[G11_FLUSSO_BLOCCO];
+    for (uint32_t i = 0; i < n; i++) {
+        memcpy(a + 4u * i, coppie + G11_DIM_COPPIA * i, 4);
+        memcpy(b + 4u * i, coppie + G11_DIM_COPPIA * i + 4, 4);
+    }
+    g11_kernel_lotto()(op, a, b, r, stati, n);
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t *e = esiti + G11_DIM_ESITO * i;
+        memcpy(e, r + 4u * i, 4);
+        e[4] = stati[i];
+        e[5] = e[6] = e[7] = 0;
+    }
+}
+
+// Elabora un'espressione: il programma viene dalla cache del thread (o compilato ora) e valutato per ogni
+// assegnazione; la risposta ha il formato di un lotto, con risultato e stato di ogni assegnazione.
+static inline size_t g11_elabora_espressione(const struct g11_frame *req, uint8_t *out) {
+    uint8_t k;
+    uint16_t t;
+    uint32_t m;
+    if (req->opzioni != G11_TIPO_INT32 || g11_analizza_espressione(req, &k, &t, &m) < 0) {
+        g11_codifica_risposta(out, G11_STATO_FORMATO, req->id, 0);
+        return G11_DIM_RISPOSTA;
+    }
+    const uint8_t *testo = req->corpo + G11_DIM_ESPRESSIONE;
+    const struct g11_programma *prog = g11_espr_programma((const char *) testo, t);
+    if (prog == NULL || prog->variabili > k) {
+        g11_codifica_risposta(out, G11_STATO_SINTASSI, req->id, 0);
+        return G11_DIM_RISPOSTA;
+    }
+
+    uint32_t dim = g11_dim_risposta_lotto(m);
+    const uint8_t *valori = testo + ((t + 3u) & ~3u);
+    uint8_t *risultati = out + G11_DIM_INTESTAZIONE + 4;
+    uint8_t *stati = risultati + 4u * m;
+    int32_t var[G11_ESPR_MAX_VARIABILI];
+
+    g11_scrivi_intestazione(out, dim, G11_STATO_OK, 0, req->id);
+    g11_scrivi_u32(out + G11_DIM_INTESTAZIONE, m);
+    for (uint32_t i = 0; i < m; i++, valori += 4u * k) {
+        int32_t r;
+        for (uint32_t j = 0; j < k; j++) {
+            var[j] = (int32_t) g11_leggi_u32(valori + 4u * j);
+        }
+        stati[i] = g11_espr_valuta(prog, var, &r);
+        g11_scrivi_u32(risultati + 4u * i, (uint32_t) r);
+    }
+    memset(stati + m, 0, dim - (size_t) (stati + m - out));
+    return dim;
+}
+
+// Elabora una richiesta con operandi int64 o double (stesso formato, cambia l'interpretazione dei bit).
+static inline size_t g11_elabora_64(const struct g11_frame *req, uint8_t *out) {
+    uint64_t a = g11_leggi_u64(req->corpo), b = g11_leggi_u64(req->corpo + 8), risultato;
+    uint8_t stato;
+    if (req->opzioni == G11_TIPO_INT64) {
+        int64_t r;
+        stato = g11_esegui_64(req->codice, (int64_t) a, (int64_t) b, &r);
+        risultato = (uint64_t) r;
+    } else {
+        double da, db, r;
+        memcpy(&da, &a, sizeof(da));
+        memcpy(&db, &b, sizeof(db));
+        stato = g11_esegui_double(req->codice, da, db, &r);
+        memcpy(&risultato, &r, sizeof(risultato));
+    }
+    if (stato == G11_STATO_OP_NON_VALIDA) {
+        g11_codifica_risposta(out, stato, req->id, 0);
+        return G11_DIM_RISPOSTA;
+    }
+    g11_scrivi_intestazione(out, G11_DIM_RISPOSTA_64, stato, req->opzioni, req->id);
+    g11_scrivi_u64(out + G11_DIM_INTESTAZIONE, risultato);
+    return G11_DIM_RISPOSTA_64;
+}
+
+// Elabora una richiesta con interi grandi. Operandi, risultato e memoria di lavoro stanno nell'area
+// del thread (grandi_G11.h); se l'area non può crescere la risposta è G11_STATO_OVERFLOW con risultato 0.
+static inline size_t g11_elabora_grandi(const struct g11_frame *req, uint8_t *out) {
+    uint32_t na, nb;
+    uint8_t op = req->codice;
+    if (g11_cifre_operandi(req, &na, &nb) < 0 || !g11_operazione_valida(op)) {
+        g11_codifica_risposta(out, g11_operazione_valida(op) ? G11_STATO_FORMATO : G11_STATO_OP_NON_VALIDA, req->id, 0);
+        return G11_DIM_RISPOSTA;
+    }
+    struct g11_grande a, b, r = { NULL, 0, 0 };
+    uint8_t stato = G11_STATO_OVERFLOW;
+    if (g11_pool_prepara((size_t) na + nb + g11_grandi_spazio(op, na, nb)) == 0) {
+        g11_grande_leggi(req->corpo + 8, g11_leggi_u32(req->corpo), &a);
+        g11_grande_leggi(req->corpo + 8 + 4u * na, g11_leggi_u32(req->corpo + 4), &b);
+        stato = g11_grandi_esegui(op, &a, &b, &r);
+    }
+    uint32_t dim = g11_dim_risposta_grande(r.n);
+    g11_scrivi_intestazione(out, dim, stato, G11_TIPO_GRANDE, req->id);
+    g11_grande_scrivi(out + G11_DIM_INTESTAZIONE, &r);
+    return dim;
+}
+
+// Elabora una richiesta già delimitata e scrive la risposta in 'out'.
+// Ritorna i byte scritti, oppure 0 se 'spazio' non basta (il chiamante riproverà dopo aver inviato):
+// g11_dim_risposta() indica in anticipo quanto spazio serve.
+static inline size_t g11_elabora_richiesta(const struct g11_frame *req, uint8_t *out, size_t spazio) {
+    if (spazio < g11_dim_risposta(req)) {
+        return 0;
+    }
+    int32_t risultato = 0;
+    uint8_t stato;
+    if (req->versione != G11_VERSIONE) {
+        stato = G11_STATO_VERSIONE;
+    } else if (req->codice == G11_OP_LOTTO) {
+        return g11_elabora_lotto(req, out);
+    } else if (req->codice == G11_OP_ESPRESSIONE) {
+        return g11_elabora_espressione(req, out);
+    } else if (req->opzioni == G11_TIPO_GRANDE) {
+        return g11_elabora_grandi(req, out);
+    } else if (req->opzioni == G11_TIPO_INT64 || req->opzioni == G11_TIPO_DOUBLE) {
+        if (req->lunghezza == G11_DIM_RICHIESTA_64) {
+            return g11_elabora_64(req, out);
+        }
+        stato = G11_STATO_FORMATO;
+    } else if (req->opzioni != G11_TIPO_INT32 || req->lunghezza != G11_DIM_RICHIESTA) {
+        stato = G11_STATO_FORMATO;
+    } else {
+        stato = g11_esegui(req->codice,
+                           (int32_t) g11_leggi_u32(req->corpo),
+                           (int32_t) g11_leggi_u32(req->corpo + 4),
+                           &risultato);
+    }
+    g11_codifica_risposta(out, stato, req->id, risultato);
+    return G11_DIM_RISPOSTA;
+}
+
+#endif // CALCOLO_G11_H
@@ -0,0 +1,611 @@
+// Generatore di carico condiviso dai client TCP e UDP (opzione -g).
+//
+// Più thread, ognuno con le proprie connessioni (socket TCP o UDP), tengono in volo fino a
+// 'profondita' richieste per connessione e misurano la latenza di ciascuna in un istogramma HDR.
+//   - ciclo chiuso (-R 0): una nuova richiesta parte appena se ne completa una, quindi si misura la
+//     capacità massima del server con la concorrenza data;
+//   - ciclo aperto (-R tasso): le richieste sono programmate a intervalli regolari indipendentemente dalle
+//     risposte. La latenza è calcolata dall'istante in cui la richiesta *doveva* partire, non da quando è
+//     partita davvero: se il server rallenta, l'attesa accumulata entra nella misura (correzione della
+//     "coordinated omission").
+// Al termine stampa throughput e percentili, più una riga RISULTATO chiave=valore per gli script di benchmark.
+#ifndef CARICO_G11_H
+#define CARICO_G11_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "protocollo_G11.h"
+#include "calcolo_G11.h"      // g11_esegui, per verificare i risultati ricevuti
+#include "istogramma_G11.h"
+
+#define G11_CARICO_TCP 0
+#define G11_CARICO_UDP 1
+
+// Opzioni riconosciute da g11_carico_opzione(), da aggiungere alla stringa di getopt del client
+#define G11_CARICO_OPZIONI "gC:j:q:R:x:d:P:"
+
+#define G11_CARICO_MAX_PROFONDITA 65536  // L'indice dello slot occupa i 16 bit bassi dell'id
+#define G11_CARICO_MAX_CONNESSIONI 65536
+#define G11_CARICO_MAX_THREAD 256
+
+struct g11_carico {
+    int attivo;           // -g: modalità generatore di carico al posto di quella interattiva
+    int protocollo;       // -P tcp|udp (predefinito: quello del client)
+    int connessioni;      // -C: connessioni (socket) totali
+    int thread;           // -j: thread che le gestiscono
+    int profondita;       // -q: richieste in volo per connessione (profondità della pipeline)
+    uint32_t lotto;       // Coppie per richiesta: 1 = operazione singola, >1 = G11_OP_LOTTO (-l del client)
+    double tasso;         // -R: richieste al secondo in totale, 0 = ciclo chiuso
+    double durata;        // -d: secondi di invio
+    uint32_t pesi[4];     // -x: peso di A, S, M, D nella miscela di operazioni
+    int64_t timeout_ns;   // Oltre questo tempo una richiesta senza risposta è persa (UDP) o abbandonata
+};
+
+static inline void g11_carico_predefinito(struct g11_carico *c, int protocollo) {
+    memset(c, 0, sizeof(*c));
+    c->protocollo = protocollo;
+    c->connessioni = 1;
+    c->thread = 1;
+    c->profondita = 1;
+    c->lotto = 1;
+    c->durata = 10.0;
+    c->pesi[0] = c->pesi[1] = c->pesi[2] = c->pesi[3] = 1;
+    c->timeout_ns = 1000000000;
+}
+
+static const uint8_t g11_carico_op[4] = {
+    G11_OP_ADDIZIONE, G11_OP_SOTTRAZIONE, G11_OP_MOLTIPLICAZIONE, G11_OP_DIVISIONE
+};
+
+// Miscela di operazioni: lettere A, S, M, D con peso facoltativo, es. "A:40,S:20,M:30,D:10" oppure "AM"
+static inline int g11_carico_miscela(struct g11_carico *c, const char *s) {
+    uint32_t pesi[4] = {0, 0, 0, 0}, totale = 0;
+    while (*s) {
+        uint8_t op = g11_opcode_da_comando(*s++);
+        int k = 0;
+        while (k < 4 && g11_carico_op[k] != op) k++;
+        if (k == 4) {
+            return -1;
+        }
+        uint32_t peso = 1;
+        if (*s == ':') {
+            char *fine;
+            peso = (uint32_t) strtoul(s + 1, &fine, 10);
+            s = fine;
+        }
+        pesi[k] += peso;
+        totale += peso;
+        if (*s == ',') s++;
+    }
+    if (totale == 0) {
+        return -1;
+    }
+    memcpy(c->pesi, pesi, sizeof(pesi));
+    return 0;
+}
+
+// Interpreta un'opzione del generatore. Ritorna 1 se l'opzione è stata riconosciuta, 0 se non appartiene
+// al generatore, -1 se il valore non è valido.
+static inline int g11_carico_opzione(struct g11_carico *c, int opt, const char *arg) {
+    switch (opt) {
+        case 'g': c->attivo = 1; return 1;
+        case 'C': c->connessioni = atoi(arg); break;
+        case 'j': c->thread = atoi(arg); break;
+        case 'q': c->profondita = atoi(arg); break;
+        case 'R': c->tasso = atof(arg); break;
+        case 'd': c->durata = atof(arg); break;
+        case 'x':
+            if (g11_carico_miscela(c, arg) < 0) return -1;
+            break;
+        case 'P':
+            if (strcmp(arg, "tcp") == 0) c->protocollo = G11_CARICO_TCP;
+            else if (strcmp(arg, "udp") == 0) c->protocollo = G11_CARICO_UDP;
+            else return -1;
+            break;
+        default: return 0;
+    }
+    c->attivo = 1;
+    return 1;
+}
+
+// Controlla la coerenza dei parametri; ritorna il messaggio d'errore oppure NULL.
+static inline const char *g11_carico_verifica(const struct g11_carico *c) {
+    if (c->connessioni <= 0 || c->connessioni > G11_CARICO_MAX_CONNESSIONI) return "numero di connessioni non valido (-C)";
+    if (c->thread <= 0 || c->thread > G11_CARICO_MAX_THREAD) return "numero di thread non valido (-j)";
+    if (c->profondita <= 0 || c->profondita > G11_CARICO_MAX_PROFONDITA) return "profondità non valida (-q)";
+    if (c->tasso < 0 || c->durata <= 0) return "tasso o durata non validi (-R, -d)";
+    if (c->lotto == 0 || c->lotto > G11_MAX_LOTTO) return "dimensione del lotto non valida (-l)";
+    if (c->protocollo == G11_CARICO_UDP && g11_dim_richiesta_lotto(c->lotto) > G11_MAX_DATAGRAMMA) {
+        return "lotto troppo grande per un datagramma UDP (-l)";
+    }
+    return NULL;
+}
+
+static inline uint64_t g11_adesso_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+// Richiesta in volo. L'id inviato è (generazione << 16 | indice dello slot): una risposta arrivata
+// dopo che lo slot è stato riutilizzato (UDP, richiesta già data per persa) viene riconosciuta e scartata.
+struct g11_slot_carico {
+    uint64_t partenza;    // Istante di partenza previsto (ciclo aperto) o effettivo (ciclo chiuso)
+    uint16_t generazione;
+    uint8_t occupato;
+    uint8_t op;
+    int32_t a, b;         // Operandi delle richieste singole, per verificare il risultato
+};
+
+struct g11_connessione_carico {
+    int fd;
+    int attiva;
+    struct g11_slot_carico *slot;
+    uint32_t *liberi;     // Pila degli slot liberi
+    int n_liberi;
+    uint64_t prossimo;    // Istante previsto per la prossima richiesta (ciclo aperto)
+    uint8_t *out;         // Frame preparati e non ancora scritti (TCP) o frame corrente (UDP)
+    size_t out_dim, out_usati, out_inviati;
+    uint8_t *in;          // Risposte ricevute (TCP: flusso da delimitare, UDP: un datagramma)
+    size_t in_dim, in_letti, in_consumati;
+};
+
+struct g11_lavoratore_carico {
+    const struct g11_carico *cfg;
+    struct g11_connessione_carico *conn;
+    int n_conn;
+    uint64_t inizio;       // Istante comune di partenza
+    uint64_t intervallo;   // Distanza tra due richieste della stessa connessione (ciclo aperto), in ns
+    uint64_t rnd;          // Stato del generatore pseudo-casuale
+    uint64_t inviate, completate, errori, errati, perse;
+    uint64_t occupate;     // Respinte dal server con G11_STATO_OCCUPATO: escluse da latenza e completate
+    struct g11_istogramma isto;
+    pthread_t thread;
+};
+
+// xorshift64*: abbastanza veloce da non pesare sulla misura
+static inline uint64_t g11_carico_casuale(uint64_t *s) {
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * 2685821657736338717ULL;
+}
+
+static inline uint8_t g11_carico_scegli_op(struct g11_lavoratore_carico *l) {
+    const uint32_t *p = l->cfg->pesi;
+    uint32_t x = (uint32_t) (g11_carico_casuale(&l->rnd) >> 32) % (p[0] + p[1] + p[2] + p[3]);
+    int k = 0;
+    while (x >= p[k]) x -= p[k++];
+    return g11_carico_op[k];
+}
+
+static inline size_t g11_carico_dim_richiesta(const struct g11_carico *c) {
+    return c->lotto > 1 ? g11_dim_richiesta_lotto(c->lotto) : G11_DIM_RICHIESTA;
+}
+
+static inline size_t g11_carico_dim_risposta(const struct g11_carico *c) {
+    return c->lotto > 1 ? g11_dim_risposta_lotto(c->lotto) : G11_DIM_RISPOSTA;
+}
+
+// Prepara in 'p' la richiesta dello slot indicato, con operandi casuali.
+static inline void g11_carico_codifica(struct g11_lavoratore_carico *l, struct g11_slot_carico *s,
+                                       uint32_t id, uint8_t *p) {
+    s->op = g11_carico_scegli_op(l);
+    if (l->cfg->lotto == 1) {
+        uint64_t r = g11_carico_casuale(&l->rnd);
+        s->a = (int32_t) (uint32_t) r;
+        s->b = (int32_t) (uint32_t) (r >> 32) >> 16; // Divisori piccoli: quozienti non banali e qualche divisione per zero
+        g11_codifica_richiesta(p, s->op, id, s->a, s->b);
+        return;
+    }
+    uint32_t n = l->cfg->lotto;
+    g11_scrivi_intestazione(p, g11_dim_richiesta_lotto(n), G11_OP_LOTTO, 0, id);
+    p[12] = s->op;
+    p[13] = p[14] = p[15] = 0;
+    g11_scrivi_u32(p + 16, n);
+    uint8_t *v = p + G11_DIM_INTESTAZIONE + G11_DIM_LOTTO;
+    for (uint32_t i = 0; i < 2 * n; i += 2) {
+        uint64_t r = g11_carico_casuale(&l->rnd);
+        memcpy(v + 4 * i, &r, 8); // Due operandi per estrazione, il byte order è irrilevante
+    }
+}
+
+// Occupa uno slot libero e ne ritorna l'id, oppure -1 se la connessione ha già 'profondita' richieste in volo.
+static inline int64_t g11_carico_occupa(struct g11_connessione_carico *c, uint64_t partenza) {
+    if (c->n_liberi == 0) {
+        return -1;
+    }
+    uint32_t k = c->liberi[--c->n_liberi];
+    struct g11_slot_carico *s = &c->slot[k];
+    s->occupato = 1;
+    s->generazione++;
+    s->partenza = partenza;
+    return (int64_t) ((uint32_t) s->generazione << 16 | k);
+}
+
+static inline void g11_carico_libera(struct g11_connessione_carico *c, uint32_t k) {
+    c->slot[k].occupato = 0;
+    c->liberi[c->n_liberi++] = k;
+}
+
+// Invia le richieste dovute: in ciclo chiuso tutte quelle che la profondità consente, in ciclo aperto
+// quelle il cui istante previsto è già passato.
+static inline void g11_carico_riempi(struct g11_lavoratore_carico *l, struct g11_connessione_carico *c, uint64_t adesso) {
+    const struct g11_carico *cfg = l->cfg;
+    size_t dim = g11_carico_dim_richiesta(cfg);
+
+    if (c->out_inviati > 0) {
+        // Restano solo i frame non ancora scritti: al più uno per slot occupato, quindi c'è sempre spazio
+        memmove(c->out, c->out + c->out_inviati, c->out_usati - c->out_inviati);
+        c->out_usati -= c->out_inviati;
+        c->out_inviati = 0;
+    }
+    while (c->attiva && c->n_liberi > 0 && (cfg->tasso == 0 || c->prossimo <= adesso)) {
+        uint64_t partenza = cfg->tasso == 0 ? adesso : c->prossimo;
+        uint32_t id = (uint32_t) g11_carico_occupa(c, partenza);
+        uint32_t k = id & 0xFFFF;
+
+        if (cfg->protocollo == G11_CARICO_TCP) {
+            // I frame si accumulano nel buffer di uscita e partono con una sola scrittura
+            g11_carico_codifica(l, &c->slot[k], id, c->out + c->out_usati);
+            c->out_usati += dim;
+        } else {
+            g11_carico_codifica(l, &c->slot[k], id, c->out);
+            if (send(c->fd, c->out, dim, 0) < 0) {
+                g11_carico_libera(c, k);
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS || errno == EINTR) {
+                    break; // Buffer del socket pieno: la richiesta si riprova al prossimo giro
+                }
+                l->errori++; // Es. ECONNREFUSED: il server non è in ascolto
+                break;
+            }
+        }
+        l->inviate++;
+        c->prossimo += l->intervallo;
+    }
+}
+
+// Scrive i frame accumulati sulla connessione TCP. Ritorna -1 se la connessione è caduta.
+static inline int g11_carico_scrivi(struct g11_connessione_carico *c) {
+    while (c->out_inviati < c->out_usati) {
+        ssize_t n = write(c->fd, c->out + c->out_inviati, c->out_usati - c->out_inviati);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        c->out_inviati += (size_t) n;
+    }
+    c->out_usati = c->out_inviati = 0;
+    return 0;
+}
+
+// Registra una risposta: latenza, stato e, per le operazioni singole, correttezza del risultato.
+static inline void g11_carico_risposta(struct g11_lavoratore_carico *l, struct g11_connessione_carico *c,
+                                       const struct g11_frame *f, uint64_t adesso) {
+    uint32_t k = f->id & 0xFFFF;
+    if (k >= (uint32_t) l->cfg->profondita || !c->slot[k].occupato || c->slot[k].generazione != (f->id >> 16)) {
+        return; // Risposta tardiva a una richiesta già data per persa
+    }
+    struct g11_slot_carico *s = &c->slot[k];
+    if (f->codice == G11_STATO_OCCUPATO) {
+        l->occupate++; // Limite del server: la latenza misura solo le richieste servite
+        g11_carico_libera(c, k);
+        return;
+    }
+    g11_isto_registra(&l->isto, adesso - s->partenza);
+    l->completate++;
+    if (l->cfg->lotto > 1) {
+        if (f->codice != G11_STATO_OK || f->dim_corpo < 4 || g11_leggi_u32(f->corpo) != l->cfg->lotto) {
+            l->errori++;
+        }
+    } else {
+        int32_t atteso;
+        uint8_t stato = g11_esegui(s->op, s->a, s->b, &atteso);
+        if (f->codice != G11_STATO_OK && f->codice != G11_STATO_DIV_ZERO && f->codice != G11_STATO_OVERFLOW) {
+            l->errori++;
+        } else if (f->codice != stato || f->dim_corpo < 4 || (int32_t) g11_leggi_u32(f->corpo) != atteso) {
+            l->errati++;
+        }
+    }
+    g11_carico_libera(c, k);
+}
+
+// Legge e registra le risposte disponibili. Ritorna -1 se la connessione è caduta.
+static inline int g11_carico_leggi(struct g11_lavoratore_carico *l, struct g11_connessione_carico *c) {
+    struct g11_frame f;
+
+    if (l->cfg->protocollo == G11_CARICO_UDP) {
+        for (;;) {
+            ssize_t n = recv(c->fd, c->in, c->in_dim, 0);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNREFUSED) return 0;
+                return -1;
+            }
+            if (g11_analizza_frame(c->in, (size_t) n, c->in_dim, &f) == G11_FRAME_COMPLETO) {
+                g11_carico_risposta(l, c, &f, g11_adesso_ns());
+            }
+        }
+    }
+
+    for (;;) {
+        ssize_t n = read(c->fd, c->in + c->in_letti, c->in_dim - c->in_letti);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        if (n == 0) {
+            return -1; // Il server ha chiuso la connessione
+        }
+        c->in_letti += (size_t) n;
+        uint64_t adesso = g11_adesso_ns();
+        int esito;
+        while ((esito = g11_analizza_frame(c->in + c->in_consumati, c->in_letti - c->in_consumati,
+                                           c->in_dim, &f)) == G11_FRAME_COMPLETO) {
+            g11_carico_risposta(l, c, &f, adesso);
+            c->in_consumati += f.lunghezza;
+        }
+        if (esito == G11_FRAME_ERRATO) {
+            return -1;
+        }
+        // Sposta l'eventuale frame incompleto all'inizio del buffer
+        memmove(c->in, c->in + c->in_consumati, c->in_letti - c->in_consumati);
+        c->in_letti -= c->in_consumati;
+        c->in_consumati = 0;
+    }
+}
+
+// Abbandona le richieste in volo da più di 'timeout' (tutte, se 'tutte' vale 1) contandole come perse.
+static inline void g11_carico_scadute(struct g11_lavoratore_carico *l, struct g11_connessione_carico *c,
+                                      uint64_t adesso, int tutte) {
+    for (int k = 0; k < l->cfg->profondita; k++) {
+        if (c->slot[k].occupato && (tutte || adesso - c->slot[k].partenza > (uint64_t) l->cfg->timeout_ns)) {
+            l->perse++;
+            g11_carico_libera(c, (uint32_t) k);
+        }
+    }
+}
+
+static inline void g11_carico_chiudi(struct g11_lavoratore_carico *l, struct g11_connessione_carico *c) {
+    g11_carico_scadute(l, c, 0, 1);
+    close(c->fd);
+    c->attiva = 0;
+}
+
+static inline void *g11_carico_ciclo(void *arg) {
+    struct g11_lavoratore_carico *l = arg;
+    const struct g11_carico *cfg = l->cfg;
+    uint64_t fine_invio = l->inizio + (uint64_t) (cfg->durata * 1e9);
+    uint64_t ultimo_controllo = l->inizio;
+    struct pollfd *pfd = calloc((size_t) l->n_conn, sizeof(*pfd));
+    if (pfd == NULL) {
+        perror("ERRORE memoria insufficiente");
+        return NULL;
+    }
+
+    for (;;) {
+        uint64_t adesso = g11_adesso_ns();
+        int invio = adesso < fine_invio;
+        int in_volo = 0, attive = 0;
+
+        // 1. Invia le richieste dovute su ogni connessione
+        for (int i = 0; i < l->n_conn; i++) {
+            struct g11_connessione_carico *c = &l->conn[i];
+            if (!c->attiva) continue;
+            if (invio) {
+                g11_carico_riempi(l, c, adesso);
+            }
+            if (cfg->protocollo == G11_CARICO_TCP && g11_carico_scrivi(c) < 0) {
+                g11_carico_chiudi(l, c);
+                continue;
+            }
+            attive++;
+            in_volo += cfg->profondita - c->n_liberi;
+        }
+
+        // 2. Terminato l'invio si attendono le risposte mancanti, per al massimo un timeout
+        if (attive == 0 || (!invio && (in_volo == 0 || adesso > fine_invio + (uint64_t) cfg->timeout_ns))) {
+            break;
+        }
+
+        // 3. Le richieste senza risposta da troppo tempo si danno per perse (datagrammi smarriti)
+        if (cfg->protocollo == G11_CARICO_UDP && adesso - ultimo_controllo > 10000000) {
+            for (int i = 0; i < l->n_conn; i++) {
+                if (l->conn[i].attiva) g11_carico_scadute(l, &l->conn[i], adesso, 0);
+            }
+            ultimo_controllo = adesso;
+        }
+
+        // 4. Attende risposte, spazio in uscita o l'istante della prossima richiesta programmata
+        uint64_t attesa = 10000000; // Al più 10 ms, per controllare scadenze e fine del test
+        for (int i = 0; i < l->n_conn; i++) {
+            struct g11_connessione_carico *c = &l->conn[i];
+            pfd[i].fd = c->attiva ? c->fd : -1;
+            pfd[i].events = POLLIN | (c->out_inviati < c->out_usati ? POLLOUT : 0);
+            if (invio && cfg->tasso > 0 && c->attiva && c->n_liberi > 0) {
+                uint64_t mancano = c->prossimo > adesso ? c->prossimo - adesso : 0;
+                if (mancano < attesa) attesa = mancano;
+            }
+        }
+        if (invio && fine_invio - adesso < attesa) {
+            attesa = fine_invio - adesso;
+        }
+        struct timespec ts = { (time_t) (attesa / 1000000000ULL), (long) (attesa % 1000000000ULL) };
+        int pronti = ppoll(pfd, (nfds_t) l->n_conn, &ts, NULL);
+        if (pronti < 0) {
+            if (errno == EINTR) continue;
+            perror("ERRORE in ppoll");
+            break;
+        }
+
+        // 5. Raccoglie le risposte
+        for (int i = 0; i < l->n_conn && pronti > 0; i++) {
+            if (pfd[i].revents == 0) continue;
+            pronti--;
+            if ((pfd[i].revents & (POLLIN | POLLERR | POLLHUP)) && g11_carico_leggi(l, &l->conn[i]) < 0) {
+                fprintf(stderr, "Connessione %d chiusa dal server\n", l->conn[i].fd);
+                g11_carico_chiudi(l, &l->conn[i]);
+            }
+        }
+    }
+
+    // Quello che resta in volo allo scadere dell'attesa è perso
+    for (int i = 0; i < l->n_conn; i++) {
+        if (l->conn[i].attiva) g11_carico_chiudi(l, &l->conn[i]);
+    }
+    free(pfd);
+    return NULL;
+}
+
+// Apre una connessione verso il server e prepara i suoi buffer. Ritorna -1 in caso di errore.
+static inline int g11_carico_connetti(const struct g11_carico *cfg, const struct sockaddr_in *serv_addr,
+                                      struct g11_connessione_carico *c) {
+    int tcp = cfg->protocollo == G11_CARICO_TCP;
+    memset(c, 0, sizeof(*c));
+
+    // Con UDP il socket viene "connesso": send() non ripete l'indirizzo e recv() accetta solo il server
+    c->fd = socket(AF_INET, tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+    if (c->fd < 0 || connect(c->fd, (const struct sockaddr *) serv_addr, sizeof(*serv_addr)) < 0) {
+        return -1;
+    }
+    if (tcp) {
+        int uno = 1;
+        setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &uno, sizeof(uno));
+    }
+    fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL, 0) | O_NONBLOCK);
+
+    size_t p = (size_t) cfg->profondita;
+    c->out_dim = tcp ? p * g11_carico_dim_richiesta(cfg) : g11_carico_dim_richiesta(cfg);
+    // Il buffer TCP contiene tutte le risposte in volo (anche quelle di errore, più corte); UDP un datagramma
+    c->in_dim = tcp ? p * g11_carico_dim_risposta(cfg) + G11_DIM_RISPOSTA : G11_MAX_DATAGRAMMA;
+    c->out = malloc(c->out_dim);
+    c->in = malloc(c->in_dim);
+    c->slot = calloc(p, sizeof(*c->slot));
+    c->liberi = malloc(p * sizeof(*c->liberi));
+    if (c->out == NULL || c->in == NULL || c->slot == NULL || c->liberi == NULL) {
+        return -1;
+    }
+    for (int k = cfg->profondita - 1; k >= 0; k--) {
+        c->liberi[c->n_liberi++] = (uint32_t) k;
+    }
+    c->attiva = 1;
+    return 0;
+}
+
+// Esegue il test di carico e stampa il rapporto. Ritorna 0, oppure -1 se non è stato possibile avviarlo.
+static inline int g11_carico_esegui(struct g11_carico *cfg, const struct sockaddr_in *serv_addr) {
+    const char *errore = g11_carico_verifica(cfg);
+    if (errore != NULL) {
+        fprintf(stderr, "Errore: %s\n", errore);
+        return -1;
+    }
+    if (cfg->thread > cfg->connessioni) {
+        cfg->thread = cfg->connessioni; // Un thread senza connessioni non avrebbe nulla da fare
+    }
+
+    struct g11_connessione_carico *conn = calloc((size_t) cfg->connessioni, sizeof(*conn));
+    struct g11_lavoratore_carico *lav = calloc((size_t) cfg->thread, sizeof(*lav));
+    if (conn == NULL || lav == NULL) {
+        perror("ERRORE memoria insufficiente");
+        return -1;
+    }
+    for (int i = 0; i < cfg->connessioni; i++) {
+        if (g11_carico_connetti(cfg, serv_addr, &conn[i]) < 0) {
+            perror("ERRORE connessione al server");
+            return -1;
+        }
+    }
+
+    // Le connessioni sono divise in blocchi contigui tra i thread. In ciclo aperto ognuna ha la sua quota
+    // del tasso totale, con partenze sfalsate per non sincronizzare le raffiche.
+    uint64_t intervallo = cfg->tasso > 0 ? (uint64_t) (1e9 * cfg->connessioni / cfg->tasso) : 0;
+    uint64_t inizio = g11_adesso_ns();
+    for (int t = 0, primo = 0; t < cfg->thread; t++) {
+        int quante = cfg->connessioni / cfg->thread + (t < cfg->connessioni % cfg->thread);
+        struct g11_lavoratore_carico *l = &lav[t];
+        l->cfg = cfg;
+        l->conn = conn + primo;
+        l->n_conn = quante;
+        l->inizio = inizio;
+        l->intervallo = intervallo;
+        l->rnd = 0x9E3779B97F4A7C15ULL * (uint64_t) (t + 1) ^ inizio;
+        g11_isto_azzera(&l->isto);
+        for (int i = 0; i < quante; i++) {
+            l->conn[i].prossimo = inizio + intervallo * (uint64_t) (primo + i) / (uint64_t) cfg->connessioni;
+        }
+        primo += quante;
+    }
+    for (int t = 0; t < cfg->thread; t++) {
+        if (pthread_create(&lav[t].thread, NULL, g11_carico_ciclo, &lav[t]) != 0) {
+            perror("ERRORE in pthread_create");
+            return -1;
+        }
+    }
+
+    // Riunisce i risultati dei thread
+    static struct g11_istogramma isto;
+    uint64_t inviate = 0, completate = 0, errori = 0, errati = 0, perse = 0, occupate = 0;
+    g11_isto_azzera(&isto);
+    for (int t = 0; t < cfg->thread; t++) {
+        pthread_join(lav[t].thread, NULL);
+        g11_isto_unisci(&isto, &lav[t].isto);
+        inviate += lav[t].inviate;
+        completate += lav[t].completate;
+        errori += lav[t].errori;
+        errati += lav[t].errati;
+        perse += lav[t].perse;
+        occupate += lav[t].occupate;
+    }
+    double secondi = (double) (g11_adesso_ns() - inizio) / 1e9;
+    double req_s = (double) completate / secondi;
+    double op_s = req_s * cfg->lotto;
+    double us = 1000.0;
+
+    printf("Generatore di carico: %s, %d connessioni, %d thread, profondità %d, lotto %u, %s, %.1f s\n",
+           cfg->protocollo == G11_CARICO_TCP ? "TCP" : "UDP", cfg->connessioni, cfg->thread, cfg->profondita,
+           cfg->lotto, cfg->tasso > 0 ? "ciclo aperto" : "ciclo chiuso", secondi);
+    if (cfg->tasso > 0) {
+        printf("Tasso richiesto: %.0f richieste/s\n", cfg->tasso);
+    }
+    printf("Richieste: %lu inviate, %lu completate (%.0f/s, %.0f operazioni/s)\n",
+           (unsigned long) inviate, (unsigned long) completate, req_s, op_s);
+    printf("Errori: %lu, risultati errati: %lu, perse o senza risposta: %lu, respinte (server occupato): %lu\n",
+           (unsigned long) errori, (unsigned long) errati, (unsigned long) perse, (unsigned long) occupate);
+    printf("Latenza (us): media %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, p99.99 %.1f, max %.1f\n",
+           g11_isto_media(&isto) / us, g11_isto_percentile(&isto, 50) / us, g11_isto_percentile(&isto, 90) / us,
+           g11_isto_percentile(&isto, 99) / us, g11_isto_percentile(&isto, 99.9) / us,
+           g11_isto_percentile(&isto, 99.99) / us, isto.massimo / us);
+    printf("RISULTATO protocollo=%s connessioni=%d thread=%d profondita=%d lotto=%u tasso=%.0f durata=%.3f "
+           "inviate=%lu completate=%lu req_s=%.1f op_s=%.1f errori=%lu errati=%lu perse=%lu occupate=%lu "
+           "p50_us=%.1f p99_us=%.1f p999_us=%.1f max_us=%.1f\n",
+           cfg->protocollo == G11_CARICO_TCP ? "tcp" : "udp", cfg->connessioni, cfg->thread, cfg->profondita,
+           cfg->lotto, cfg->tasso, secondi, (unsigned long) inviate, (unsigned long) completate, req_s, op_s,
+           (unsigned long) errori, (unsigned long) errati, (unsigned long) perse, (unsigned long) occupate,
+           g11_isto_percentile(&isto, 50) / us, g11_isto_percentile(&isto, 99) / us,
+           g11_isto_percentile(&isto, 99.9) / us, isto.massimo / us);
+
+    for (int i = 0; i < cfg->connessioni; i++) {
+        free(conn[i].out);
+        free(conn[i].in);
+        free(conn[i].slot);
+        free(conn[i].liberi);
+    }
+    free(conn);
+    free(lav);
+    return 0;
+}
+
+#endif // CARICO_G11_H
@@ -0,0 +1,347 @@
+// Espressioni con variabili (G11_OP_ESPRESSIONE): compilazione in bytecode, cache e interprete.
+//
+// Il testo viene analizzato una sola volta (discesa ricorsiva con le precedenze consuete) e tradotto in
+// un programma per una macchina a pila: ogni istruzione è una parola a 32 bit con il codice negli 8 bit
+// alti e l'argomento (indice di costante o di variabile) nei 24 bassi. Le operazioni tra costanti vengono
+// calcolate già in compilazione. Ogni thread tiene gli ultimi G11_ESPR_CACHE programmi in una cache LRU
+// indicizzata dall'impronta del testo, così una formula già vista passa direttamente all'interprete,
+// che la valuta per tutte le assegnazioni della richiesta in un unico ciclo.
+#ifndef ESPRESSIONI_G11_H
+#define ESPRESSIONI_G11_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "protocollo_G11.h"
+
+#define G11_ESPR_MAX_ISTRUZIONI 512 // Istruzioni di un programma (il testo più lungo ne produce meno)
+#define G11_ESPR_MAX_PILA 64        // Altezza massima della pila durante la valutazione
+#define G11_ESPR_CACHE 64           // Programmi tenuti nella cache di ogni thread
+#define G11_ESPR_SECCHI 128         // Secchi della tabella della cache (potenza di 2)
+
+// Codici delle istruzioni: le operazioni binarie usano i codici operativi del protocollo
+#define G11_BC_COSTANTE  'c'        // Impila costanti[argomento]
+#define G11_BC_VARIABILE 'v'        // Impila la variabile 'argomento' (0 = a)
+#define G11_BC_OPPOSTO   'n'        // Cambia segno alla cima della pila
+#define G11_BC(codice, argomento) ((uint32_t) (codice) << 24 | (uint32_t) (argomento))
+
+struct g11_programma {
+    uint16_t n;                     // Istruzioni
+    uint16_t n_costanti;
+    uint8_t variabili;              // Variabili usate: indice più alto + 1
+    uint8_t profondita;             // Altezza massima raggiunta dalla pila
+    uint32_t istruzioni[G11_ESPR_MAX_ISTRUZIONI];
+    int32_t costanti[G11_ESPR_MAX_ISTRUZIONI];
+};
+
+// --- Compilazione ---
+
+struct g11_compilatore {
+    const char *p, *fine;
+    struct g11_programma *prog;
+    int pila;                       // Altezza della pila dopo le istruzioni emesse finora
+    int errore;
+};
+
+static inline void g11_espr_spazi(struct g11_compilatore *c) {
+    while (c->p < c->fine && (*c->p == ' ' || *c->p == '\t')) c->p++;
+}
+
+static inline void g11_espr_emetti(struct g11_compilatore *c, uint8_t codice, uint32_t argomento) {
+    struct g11_programma *prog = c->prog;
+    if (prog->n == G11_ESPR_MAX_ISTRUZIONI) {
+        c->errore = 1;
+        return;
+    }
+    // Operazione tra due costanti (o cambio di segno di una costante): si calcola subito, a meno che il
+    // risultato non abbia uno stato diverso da OK, che va riportato a ogni valutazione
+    uint32_t ultima = prog->n >= 1 ? prog->istruzioni[prog->n - 1] : 0;
+    uint32_t penultima = prog->n >= 2 ? prog->istruzioni[prog->n - 2] : 0;
+    if (codice == G11_BC_OPPOSTO && ultima >> 24 == G11_BC_COSTANTE) {
+        int32_t *v = &prog->costanti[ultima & 0xFFFFFF];
+        if (!__builtin_sub_overflow(0, *v, v)) return;
+    } else if (codice != G11_BC_COSTANTE && codice != G11_BC_VARIABILE && codice != G11_BC_OPPOSTO &&
+               penultima >> 24 == G11_BC_COSTANTE && ultima >> 24 == G11_BC_COSTANTE) {
+        int32_t *x = &prog->costanti[penultima & 0xFFFFFF], y = prog->costanti[ultima & 0xFFFFFF], r = 0;
+        int fuori = 1;
+        switch (codice) {
+            case G11_OP_ADDIZIONE:       fuori = __builtin_add_overflow(*x, y, &r); break;
+            case G11_OP_SOTTRAZIONE:     fuori = __builtin_sub_overflow(*x, y, &r); break;
+            case G11_OP_MOLTIPLICAZIONE: fuori = __builtin_mul_overflow(*x, y, &r); break;
+            case G11_OP_DIVISIONE:
+                if (y != 0 && !(y == -1 && *x == INT32_MIN)) {
+                    r = *x / y;
+                    fuori = 0;
+                }
+                break;
+        }
+        if (!fuori) {
+            *x = r;
+            prog->n--;
+            prog->n_costanti--; // La costante y era l'ultima inserita
+            c->pila--;
+            return;
+        }
+    }
+    prog->istruzioni[prog->n++] = G11_BC(codice, argomento);
+    if (codice == G11_BC_COSTANTE || codice == G11_BC_VARIABILE) {
+        if (++c->pila > G11_ESPR_MAX_PILA) c->errore = 1;
+        if (c->pila > prog->profondita) prog->profondita = (uint8_t) c->pila;
+    } else if (codice != G11_BC_OPPOSTO) {
+        c->pila--;
+    }
+}
+
+static inline void g11_espr_somma(struct g11_compilatore *c);
+
+// Costante decimale, già con il segno se preceduta da un meno: così anche -2147483648 (INT32_MIN) si
+// può scrivere, anche se 2147483648 da solo supera INT32_MAX.
+static inline void g11_espr_numero(struct g11_compilatore *c, int negativo) {
+    if (c->prog->n == G11_ESPR_MAX_ISTRUZIONI) {
+        c->errore = 1;
+        return;
+    }
+    int64_t v = 0;
+    while (c->p < c->fine && *c->p >= '0' && *c->p <= '9') {
+        v = v * 10 + (*c->p++ - '0');
+        if (v > (int64_t) INT32_MAX + negativo) {
+            c->errore = 1;
+            return;
+        }
+    }
+    c->prog->costanti[c->prog->n_costanti] = (int32_t) (negativo ? -v : v);
+    g11_espr_emetti(c, G11_BC_COSTANTE, c->prog->n_costanti++);
+}
+
+// fattore := numero | variabile | '(' somma ')' | '-' fattore | '+' fattore
+static inline void g11_espr_fattore(struct g11_compilatore *c) {
+    g11_espr_spazi(c);
+    if (c->errore || c->p == c->fine) {
+        c->errore = 1;
+        return;
+    }
+    char x = *c->p;
+    if (x == '-' || x == '+') {
+        c->p++;
+        g11_espr_spazi(c);
+        if (x == '-' && c->p < c->fine && *c->p >= '0' && *c->p <= '9') {
+            g11_espr_numero(c, 1);
+            return;
+        }
+        g11_espr_fattore(c);
+        if (x == '-') g11_espr_emetti(c, G11_BC_OPPOSTO, 0);
+    } else if (x == '(') {
+        c->p++;
+        g11_espr_somma(c);
+        g11_espr_spazi(c);
+        if (c->p == c->fine || *c->p != ')') {
+            c->errore = 1;
+            return;
+        }
+        c->p++;
+    } else if (x >= 'a' && x < 'a' + G11_ESPR_MAX_VARIABILI) {
+        c->p++;
+        if (x - 'a' + 1 > c->prog->variabili) c->prog->variabili = (uint8_t) (x - 'a' + 1);
+        g11_espr_emetti(c, G11_BC_VARIABILE, (uint32_t) (x - 'a'));
+    } else if (x >= '0' && x <= '9') {
+        g11_espr_numero(c, 0);
+    } else {
+        c->errore = 1;
+    }
+}
+
+// prodotto := fattore (('*' | '/') fattore)*
+static inline void g11_espr_prodotto(struct g11_compilatore *c) {
+    g11_espr_fattore(c);
+    for (;;) {
+        g11_espr_spazi(c);
+        if (c->errore || c->p == c->fine || (*c->p != '*' && *c->p != '/')) return;
+        uint8_t op = *c->p++ == '*' ? G11_OP_MOLTIPLICAZIONE : G11_OP_DIVISIONE;
+        g11_espr_fattore(c);
+        g11_espr_emetti(c, op, 0);
+    }
+}
+
+// somma := prodotto (('+' | '-') prodotto)*
+static inline void g11_espr_somma(struct g11_compilatore *c) {
+    g11_espr_prodotto(c);
+    for (;;) {
+        g11_espr_spazi(c);
+        if (c->errore || c->p == c->fine || (*c->p != '+' && *c->p != '-')) return;
+        uint8_t op = *c->p++ == '+' ? G11_OP_ADDIZIONE : G11_OP_SOTTRAZIONE;
+        g11_espr_prodotto(c);
+        g11_espr_emetti(c, op, 0);
+    }
+}
+
+// Compila il testo nel programma. Ritorna -1 se il testo non è un'espressione valida.
+static inline int g11_espr_compila(const char *testo, uint16_t t, struct g11_programma *prog) {
+    struct g11_compilatore c = { testo, testo + t, prog, 0, 0 };
+    prog->n = prog->n_costanti = 0;
+    prog->variabili = prog->profondita = 0;
+    g11_espr_somma(&c);
+    g11_espr_spazi(&c);
+    return c.errore || c.p != c.fine ? -1 : 0;
+}
+
+// --- Valutazione ---
+
+// Valuta il programma con i valori delle variabili indicati. Il calcolo prosegue anche dopo una divisione
+// per zero (che vale 0) o un overflow (valore troncato): lo stato restituito è il primo diverso da OK.
+static inline uint8_t g11_espr_valuta(const struct g11_programma *prog, const int32_t *var, int32_t *risultato) {
+    int32_t pila[G11_ESPR_MAX_PILA];
+    int h = 0;
+    pila[0] = 0;
+    int fuori = 0, zero = 0;
+    for (uint32_t i = 0; i < prog->n; i++) {
+        uint32_t ins = prog->istruzioni[i];
+        int32_t *x, y;
+        switch (ins >> 24) {
+            case G11_BC_COSTANTE:  pila[h++] = prog->costanti[ins & 0xFFFFFF]; break;
+            case G11_BC_VARIABILE: pila[h++] = var[ins & 0xFFFFFF]; break;
+            case G11_BC_OPPOSTO:
+                x = &pila[h - 1];
+                fuori |= __builtin_sub_overflow(0, *x, x) && !(zero | fuori);
+                break;
+            case G11_OP_ADDIZIONE:
+                y = pila[--h];
+                x = &pila[h - 1];
+                fuori |= __builtin_add_overflow(*x, y, x) && !(zero | fuori);
+                break;
+            case G11_OP_SOTTRAZIONE:
+                y = pila[--h];
+                x = &pila[h - 1];
+                fuori |= __builtin_sub_overflow(*x, y, x) && !(zero | fuori);
+                break;
+            case G11_OP_MOLTIPLICAZIONE:
+                y = pila[--h];
+                x = &pila[h - 1];
+                fuori |= __builtin_mul_overflow(*x, y, x) && !(zero | fuori);
+                break;
+            default:
+                y = pila[--h];
+                x = &pila[h - 1];
+                if (y == 0) {
+                    zero |= !fuori;
+                    *x = 0;
+                } else if (y == -1) {
+                    fuori |= *x == INT32_MIN && !(zero | fuori);
+                    *x = (int32_t) (0u - (uint32_t) *x);
+                } else {
+                    *x /= y;
+                }
+        }
+    }
+    *risultato = pila[0];
+    return zero ? G11_STATO_DIV_ZERO : fuori ? G11_STATO_OVERFLOW : G11_STATO_OK;
+}
+
+// --- Cache dei programmi ---
+
+struct g11_voce_espr {
+    uint64_t impronta;
+    int16_t prec, succ;             // Lista LRU: prec verso la voce più recente
+    int16_t catena;                 // Voce successiva nello stesso secchio, -1 = fine
+    uint16_t t;
+    char testo[G11_ESPR_MAX_TESTO];
+    struct g11_programma prog;
+};
+
+struct g11_cache_espr {
+    int16_t secchi[G11_ESPR_SECCHI];
+    int16_t testa, coda;            // Voce più recente e meno recente
+    uint16_t usate;
+    struct g11_voce_espr voci[G11_ESPR_CACHE];
+};
+
+// Cache del thread, allocata alla prima espressione (poco più di 300 KB)
+static _Thread_local struct g11_cache_espr *g11_cache_espr;
+
+// Impronta FNV-1a a 64 bit del testo
+static inline uint64_t g11_espr_impronta(const char *testo, uint16_t t) {
+    uint64_t h = 1469598103934665603ULL;
+    for (uint16_t i = 0; i < t; i++) {
+        h = (h ^ (uint8_t) testo[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+static inline void g11_espr_stacca(struct g11_cache_espr *c, int16_t i) {
+    struct g11_voce_espr *v = &c->voci[i];
+    if (v->prec >= 0) c->voci[v->prec].succ = v->succ; else c->testa = v->succ;
+    if (v->succ >= 0) c->voci[v->succ].prec = v->prec; else c->coda = v->prec;
+}
+
+static inline void g11_espr_in_testa(struct g11_cache_espr *c, int16_t i) {
+    struct g11_voce_espr *v = &c->voci[i];
+    v->prec = -1;
+    v->succ = c->testa;
+    if (c->testa >= 0) c->voci[c->testa].prec = i; else c->coda = i;
+    c->testa = i;
+}
+
+// Crea la cache del thread, se non c'è ancora. I lavoratori la creano all'avvio, così nemmeno la prima
+// espressione alloca memoria. Ritorna -1 se manca memoria.
+static inline int g11_espr_prepara(void) {
+    if (g11_cache_espr != NULL) {
+        return 0;
+    }
+    struct g11_cache_espr *c = malloc(sizeof(*c));
+    if (c == NULL) {
+        return -1;
+    }
+    memset(c->secchi, 0xFF, sizeof(c->secchi));
+    c->testa = c->coda = -1;
+    c->usate = 0;
+    g11_cache_espr = c;
+    return 0;
+}
+
+// Programma compilato per il testo: dalla cache, oppure compilato e inserito al posto della voce usata
+// meno di recente. Ritorna NULL se il testo non è valido (i testi non validi non entrano in cache).
+static inline const struct g11_programma *g11_espr_programma(const char *testo, uint16_t t) {
+    static _Thread_local struct g11_programma nuovo;
+    if (g11_espr_prepara() < 0) {
+        return g11_espr_compila(testo, t, &nuovo) == 0 ? &nuovo : NULL; // Senza cache si compila ogni volta
+    }
+    struct g11_cache_espr *c = g11_cache_espr;
+
+    uint64_t impronta = g11_espr_impronta(testo, t);
+    int16_t *secchio = &c->secchi[impronta & (G11_ESPR_SECCHI - 1)];
+    for (int16_t i = *secchio; i >= 0; i = c->voci[i].catena) {
+        struct g11_voce_espr *v = &c->voci[i];
+        if (v->impronta == impronta && v->t == t && memcmp(v->testo, testo, t) == 0) {
+            if (c->testa != i) {
+                g11_espr_stacca(c, i);
+                g11_espr_in_testa(c, i);
+            }
+            return &v->prog;
+        }
+    }
+
+    if (g11_espr_compila(testo, t, &nuovo) < 0) {
+        return NULL;
+    }
+    int16_t i;
+    if (c->usate < G11_ESPR_CACHE) {
+        i = (int16_t) c->usate++;
+    } else {
+        // Rimuove la voce meno recente dalla lista LRU e dalla catena del suo secchio
+        i = c->coda;
+        g11_espr_stacca(c, i);
+        int16_t *p = &c->secchi[c->voci[i].impronta & (G11_ESPR_SECCHI - 1)];
+        while (*p != i) p = &c->voci[*p].catena;
+        *p = c->voci[i].catena;
+    }
+    struct g11_voce_espr *v = &c->voci[i];
+    v->impronta = impronta;
+    v->t = t;
+    memcpy(v->testo, testo, t);
+    memcpy(&v->prog, &nuovo, sizeof(nuovo));
+    v->catena = *secchio;
+    *secchio = i;
+    g11_espr_in_testa(c, i);
+    return &v->prog;
+}
+
+#endif // ESPRESSIONI_G11_H
@@ -0,0 +1,378 @@
+// Interi di precisione arbitraria per le richieste G11_TIPO_GRANDE.
+//
+// Un intero grande è un vettore di cifre in base 2^32 (dalla meno significativa) con un segno a parte.
+// La memoria di lavoro viene da un'arena per thread (g11_arena, in pool_G11.h) che si azzera a ogni
+// richiesta e cresce solo quando arriva una richiesta più grande di tutte le precedenti: a regime nessuna
+// operazione chiama malloc, nemmeno i prodotti grandi. Il prodotto usa l'algoritmo scolastico sotto
+// G11_KARATSUBA_SOGLIA cifre e Karatsuba sopra; la divisione è l'algoritmo D di Knuth.
+#ifndef GRANDI_G11_H
+#define GRANDI_G11_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "protocollo_G11.h"
+#include "pool_G11.h"
+
+#define G11_KARATSUBA_SOGLIA 32     // Cifre sotto le quali il prodotto scolastico è più veloce
+
+struct g11_grande {
+    uint32_t *cifre;                // Cifre in base 2^32, dalla meno significativa
+    uint32_t n;                     // Cifre significative (0 per lo zero)
+    int negativo;
+};
+
+// Arena di lavoro del thread: allocazione a pila, senza liberazioni singole
+static _Thread_local struct g11_arena g11_pool;
+
+// Prepara l'arena per una richiesta che userà al più 'cifre' cifre; tutto ciò che era stato preso prima
+// viene rilasciato. Ritorna -1 se la memoria non basta.
+static inline int g11_pool_prepara(size_t cifre) {
+    return g11_arena_prepara(&g11_pool, cifre * sizeof(uint32_t));
+}
+
+// Prende n cifre dall'arena; lo spazio è stato garantito da g11_pool_prepara.
+static inline uint32_t *g11_pool_prendi(size_t n) {
+    return g11_arena_prendi(&g11_pool, n * sizeof(uint32_t));
+}
+
+// --- Operazioni sui valori assoluti (vettori di cifre) ---
+
+static inline uint32_t g11_cifre_normalizza(const uint32_t *x, uint32_t n) {
+    while (n > 0 && x[n - 1] == 0) n--;
+    return n;
+}
+
+static inline int g11_cifre_confronta(const uint32_t *a, uint32_t na, const uint32_t *b, uint32_t nb) {
+    if (na != nb) return na < nb ? -1 : 1;
+    while (na-- > 0) {
+        if (a[na] != b[na]) return a[na] < b[na] ? -1 : 1;
+    }
+    return 0;
+}
+
+// r = a + b con na >= nb; scrive na cifre e ritorna il riporto finale.
+static inline uint32_t g11_cifre_somma(uint32_t *r, const uint32_t *a, uint32_t na, const uint32_t *b, uint32_t nb) {
+    uint64_t riporto = 0;
+    for (uint32_t i = 0; i < na; i++) {
+        riporto += (uint64_t) a[i] + (i < nb ? b[i] : 0);
+        r[i] = (uint32_t) riporto;
+        riporto >>= 32;
+    }
+    return (uint32_t) riporto;
+}
+
+// r = a - b con a >= b (na >= nb); scrive na cifre e ritorna il prestito finale (0 se a >= b).
+static inline uint32_t g11_cifre_differenza(uint32_t *r, const uint32_t *a, uint32_t na, const uint32_t *b, uint32_t nb) {
+    uint32_t prestito = 0;
+    for (uint32_t i = 0; i < na; i++) {
+        uint64_t d = (uint64_t) a[i] - (i < nb ? b[i] : 0) - prestito;
+        r[i] = (uint32_t) d;
+        prestito = (uint32_t) (d >> 63);
+    }
+    return prestito;
+}
+
+// r[0, na + nb) = a * b, algoritmo scolastico
+static inline void g11_cifre_prodotto_scuola(uint32_t *r, const uint32_t *a, uint32_t na, const uint32_t *b, uint32_t nb) {
+    memset(r, 0, (size_t) (na + nb) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < na; i++) {
+        uint64_t riporto = 0;
+        for (uint32_t j = 0; j < nb; j++) {
+            riporto += (uint64_t) a[i] * b[j] + r[i + j];
+            r[i + j] = (uint32_t) riporto;
+            riporto >>= 32;
+        }
+        r[i + nb] = (uint32_t) riporto;
+    }
+}
+
+// Cifre di lavoro richieste da g11_cifre_karatsuba su operandi di n cifre
+static inline size_t g11_spazio_karatsuba(uint32_t n) {
+    size_t spazio = 0;
+    while (n >= G11_KARATSUBA_SOGLIA) {
+        uint32_t h = n - n / 2;
+        spazio += 4u * (size_t) h + 4u;  // Somme delle due metà (h + 1 cifre ciascuna) e loro prodotto
+        n = h + 1;
+    }
+    return spazio;
+}
+
+// r[0, 2n) = a * b con operandi di n cifre. Con a = a1·B^m + a0 e b = b1·B^m + b0:
+// a·b = z2·B^2m + (z1 - z2 - z0)·B^m + z0, dove z0 = a0·b0, z2 = a1·b1, z1 = (a0 + a1)(b0 + b1).
+static inline void g11_cifre_karatsuba(uint32_t *r, const uint32_t *a, const uint32_t *b, uint32_t n) {
+    if (n < G11_KARATSUBA_SOGLIA) {
+        g11_cifre_prodotto_scuola(r, a, n, b, n);
+        return;
+    }
+    uint32_t m = n / 2, h = n - m;  // Metà bassa di m cifre, alta di h >= m
+    g11_cifre_karatsuba(r, a, b, m);                 // z0 in r[0, 2m)
+    g11_cifre_karatsuba(r + 2 * m, a + m, b + m, h); // z2 in r[2m, 2n)
+
+    size_t segno = g11_pool.usati;
+    uint32_t *sa = g11_pool_prendi(h + 1), *sb = g11_pool_prendi(h + 1), *z1 = g11_pool_prendi(2 * h + 2);
+    sa[h] = g11_cifre_somma(sa, a + m, h, a, m);
+    sb[h] = g11_cifre_somma(sb, b + m, h, b, m);
+    g11_cifre_karatsuba(z1, sa, sb, h + 1);
+    g11_cifre_differenza(z1, z1, 2 * h + 2, r, 2 * m);
+    g11_cifre_differenza(z1, z1, 2 * h + 2, r + 2 * m, 2 * h);
+
+    // z1 - z0 - z2 < B^(2h+1): si somma a r da B^m, dove restano m + 2h cifre
+    uint32_t nz = g11_cifre_normalizza(z1, 2 * h + 2);
+    g11_cifre_somma(r + m, r + m, m + 2 * h, z1, nz);
+    g11_pool.usati = segno;
+}
+
+// Cifre di lavoro richieste da g11_cifre_prodotto
+static inline size_t g11_spazio_prodotto(uint32_t na, uint32_t nb) {
+    uint32_t minore = na < nb ? na : nb;
+    return minore < G11_KARATSUBA_SOGLIA ? 0 : 3u * (size_t) minore + g11_spazio_karatsuba(minore);
+}
+
+// r[0, na + nb) = a * b. Sopra la soglia l'operando più lungo viene diviso in blocchi lunghi quanto
+// l'altro, e ogni blocco moltiplicato con Karatsuba.
+static inline void g11_cifre_prodotto(uint32_t *r, const uint32_t *a, uint32_t na, const uint32_t *b, uint32_t nb) {
+    if (na < nb) {
+        const uint32_t *t = a; a = b; b = t;
+        uint32_t nt = na; na = nb; nb = nt;
+    }
+    if (nb < G11_KARATSUBA_SOGLIA) {
+        g11_cifre_prodotto_scuola(r, a, na, b, nb);
+        return;
+    }
+    size_t segno = g11_pool.usati;
+    uint32_t *blocco = g11_pool_prendi(nb), *parziale = g11_pool_prendi(2u * nb);
+    memset(r, 0, (size_t) (na + nb) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < na; i += nb) {
+        uint32_t k = na - i < nb ? na - i : nb;
+        memcpy(blocco, a + i, k * sizeof(uint32_t));
+        memset(blocco + k, 0, (nb - k) * sizeof(uint32_t)); // L'ultimo blocco viene completato con zeri
+        g11_cifre_karatsuba(parziale, blocco, b, nb);
+        g11_cifre_somma(r + i, r + i, na + nb - i, parziale, g11_cifre_normalizza(parziale, 2u * nb));
+    }
+    g11_pool.usati = segno;
+}
+
+// Cifre di lavoro richieste da g11_cifre_quoziente
+static inline size_t g11_spazio_quoziente(uint32_t na, uint32_t nb) {
+    return (size_t) na + nb + 1u;
+}
+
+// q[0, na - nb + 1) = a / b (troncato), con na >= nb >= 1 e b normalizzato.
+// Algoritmo D di Knuth (TAOCP vol. 2, 4.3.1) con cifre a 32 bit e prodotti a 64 bit.
+static inline void g11_cifre_quoziente(uint32_t *q, const uint32_t *a, uint32_t na, const uint32_t *b, uint32_t nb) {
+    if (nb == 1) {
+        uint64_t resto = 0;
+        for (uint32_t i = na; i-- > 0; ) {
+            uint64_t cur = resto << 32 | a[i];
+            q[i] = (uint32_t) (cur / b[0]);
+            resto = cur % b[0];
+        }
+        return;
+    }
+    size_t segno = g11_pool.usati;
+    uint32_t *u = g11_pool_prendi(na + 1), *v = g11_pool_prendi(nb);
+
+    // D1: normalizzazione, la cifra più alta del divisore ha il bit 31 a 1
+    int s = __builtin_clz(b[nb - 1]);
+    for (uint32_t i = nb - 1; i > 0; i--) {
+        v[i] = s ? (b[i] << s | b[i - 1] >> (32 - s)) : b[i];
+    }
+    v[0] = b[0] << s;
+    u[na] = s ? a[na - 1] >> (32 - s) : 0;
+    for (uint32_t i = na - 1; i > 0; i--) {
+        u[i] = s ? (a[i] << s | a[i - 1] >> (32 - s)) : a[i];
+    }
+    u[0] = a[0] << s;
+
+    for (uint32_t j = na - nb + 1; j-- > 0; ) {
+        // D3: stima della cifra del quoziente dalle due cifre più alte
+        uint64_t num = (uint64_t) u[j + nb] << 32 | u[j + nb - 1];
+        uint64_t qs = num / v[nb - 1], rs = num % v[nb - 1];
+        while (qs >> 32 || qs * v[nb - 2] > (rs << 32 | u[j + nb - 2])) {
+            qs--;
+            rs += v[nb - 1];
+            if (rs >> 32) break;
+        }
+        // D4: sottrae qs · v dalla parte corrente del dividendo
+        int64_t k = 0, t;
+        for (uint32_t i = 0; i < nb; i++) {
+            uint64_t p = qs * v[i];
+            t = (int64_t) u[i + j] - k - (int64_t) (p & 0xFFFFFFFFu);
+            u[i + j] = (uint32_t) t;
+            k = (int64_t) (p >> 32) - (t >> 32);
+        }
+        t = (int64_t) u[j + nb] - k;
+        u[j + nb] = (uint32_t) t;
+        // D6: la stima era più grande di uno, si risomma il divisore
+        if (t < 0) {
+            qs--;
+            uint64_t riporto = 0;
+            for (uint32_t i = 0; i < nb; i++) {
+                riporto += (uint64_t) u[i + j] + v[i];
+                u[i + j] = (uint32_t) riporto;
+                riporto >>= 32;
+            }
+            u[j + nb] += (uint32_t) riporto;
+        }
+        q[j] = (uint32_t) qs;
+    }
+    g11_pool.usati = segno;
+}
+
+// --- Operazioni con segno ---
+
+// Cifre di lavoro (risultato compreso) per eseguire 'op' su operandi di na e nb cifre
+static inline size_t g11_grandi_spazio(uint8_t op, uint32_t na, uint32_t nb) {
+    switch (op) {
+        case G11_OP_MOLTIPLICAZIONE: return (size_t) na + nb + g11_spazio_prodotto(na, nb);
+        case G11_OP_DIVISIONE:       return (size_t) na + 1u + g11_spazio_quoziente(na, nb);
+        default:                     return (size_t) (na > nb ? na : nb) + 1u;
+    }
+}
+
+// Cifre massime del risultato di 'op' su operandi di na e nb cifre
+static inline uint32_t g11_grandi_cifre_risultato(uint8_t op, uint32_t na, uint32_t nb) {
+    switch (op) {
+        case G11_OP_MOLTIPLICAZIONE: return na + nb;
+        case G11_OP_DIVISIONE:       return na;
+        default:                     return (na > nb ? na : nb) + 1u;
+    }
+}
+
+// r = a + b (con 'meno' = 1, r = a - b). Le cifre di r vengono prese dall'area del thread.
+static inline void g11_grandi_somma(const struct g11_grande *a, const struct g11_grande *b, int meno,
+                                    struct g11_grande *r) {
+    int neg_b = b->negativo ^ meno;
+    uint32_t n = (a->n > b->n ? a->n : b->n) + 1u;
+    r->cifre = g11_pool_prendi(n);
+    if (a->negativo == neg_b) {
+        const struct g11_grande *x = a->n >= b->n ? a : b, *y = a->n >= b->n ? b : a;
+        r->cifre[x->n] = g11_cifre_somma(r->cifre, x->cifre, x->n, y->cifre, y->n);
+        r->n = x->n + 1u;
+        r->negativo = a->negativo;
+    } else if (g11_cifre_confronta(a->cifre, a->n, b->cifre, b->n) >= 0) {
+        g11_cifre_differenza(r->cifre, a->cifre, a->n, b->cifre, b->n);
+        r->n = a->n;
+        r->negativo = a->negativo;
+    } else {
+        g11_cifre_differenza(r->cifre, b->cifre, b->n, a->cifre, a->n);
+        r->n = b->n;
+        r->negativo = neg_b;
+    }
+    r->n = g11_cifre_normalizza(r->cifre, r->n);
+    r->negativo &= r->n > 0;
+}
+
+// Esegue l'operazione su due interi grandi normalizzati; l'area del thread deve essere stata preparata
+// con g11_pool_prepara(g11_grandi_spazio(...)). Ritorna lo stato; la divisione è troncata verso zero.
+static inline uint8_t g11_grandi_esegui(uint8_t op, const struct g11_grande *a, const struct g11_grande *b,
+                                        struct g11_grande *r) {
+    r->n = 0;
+    r->negativo = 0;
+    switch (op) {
+        case G11_OP_ADDIZIONE:
+        case G11_OP_SOTTRAZIONE:
+            g11_grandi_somma(a, b, op == G11_OP_SOTTRAZIONE, r);
+            return G11_STATO_OK;
+        case G11_OP_MOLTIPLICAZIONE:
+            r->cifre = g11_pool_prendi((size_t) a->n + b->n);
+            if (a->n > 0 && b->n > 0) {
+                g11_cifre_prodotto(r->cifre, a->cifre, a->n, b->cifre, b->n);
+                r->n = g11_cifre_normalizza(r->cifre, a->n + b->n);
+            }
+            break;
+        case G11_OP_DIVISIONE:
+            if (b->n == 0) {
+                return G11_STATO_DIV_ZERO;
+            }
+            r->cifre = g11_pool_prendi((size_t) a->n + 1u);
+            if (a->n >= b->n) {
+                g11_cifre_quoziente(r->cifre, a->cifre, a->n, b->cifre, b->n);
+                r->n = g11_cifre_normalizza(r->cifre, a->n - b->n + 1u);
+            }
+            break;
+        default:
+            return G11_STATO_OP_NON_VALIDA;
+    }
+    r->negativo = (a->negativo ^ b->negativo) && r->n > 0;
+    return G11_STATO_OK;
+}
+
+// --- Conversioni ---
+
+// Legge un intero grande dal frame (parola di segno e cifre già separate) copiandone le cifre
+// nell'area del thread, dalla meno significativa.
+static inline void g11_grande_leggi(const uint8_t *p, uint32_t intestazione, struct g11_grande *x) {
+    uint32_t n = intestazione & ~G11_GRANDI_NEGATIVO;
+    x->cifre = g11_pool_prendi(n);
+    for (uint32_t i = 0; i < n; i++) {
+        x->cifre[n - 1 - i] = g11_leggi_u32(p + 4u * i);
+    }
+    x->n = g11_cifre_normalizza(x->cifre, n);
+    x->negativo = (intestazione & G11_GRANDI_NEGATIVO) && x->n > 0; // "-0" vale 0
+}
+
+// Scrive parola di segno e cifre dalla più significativa; ritorna i byte scritti.
+static inline uint32_t g11_grande_scrivi(uint8_t *p, const struct g11_grande *x) {
+    g11_scrivi_u32(p, x->n | (x->negativo ? G11_GRANDI_NEGATIVO : 0));
+    for (uint32_t i = 0; i < x->n; i++) {
+        g11_scrivi_u32(p + 4 + 4u * i, x->cifre[x->n - 1 - i]);
+    }
+    return 4u + 4u * x->n;
+}
+
+// Converte un numero decimale (con segno facoltativo) nelle cifre indicate, al più 'max' cifre.
+// Ritorna i caratteri letti, oppure 0 se il testo non inizia con un numero o il numero è troppo grande.
+static inline size_t g11_grande_da_testo(const char *s, struct g11_grande *x, uint32_t *cifre, uint32_t max) {
+    const char *p = s;
+    while (*p == ' ' || *p == '\t') p++;
+    int negativo = *p == '-';
+    if (*p == '-' || *p == '+') p++;
+    if (*p < '0' || *p > '9') {
+        return 0;
+    }
+    x->cifre = cifre;
+    x->n = 0;
+    for (; *p >= '0' && *p <= '9'; p++) {
+        uint64_t riporto = (uint64_t) (*p - '0');
+        for (uint32_t i = 0; i < x->n; i++) {
+            riporto += (uint64_t) x->cifre[i] * 10u;
+            x->cifre[i] = (uint32_t) riporto;
+            riporto >>= 32;
+        }
+        if (riporto != 0) {
+            if (x->n == max) return 0;
+            x->cifre[x->n++] = (uint32_t) riporto;
+        }
+    }
+    x->negativo = negativo && x->n > 0;
+    return (size_t) (p - s);
+}
+
+// Scrive il numero in decimale nel testo indicato (almeno 10 * n + 2 caratteri); consuma le cifre di x.
+static inline char *g11_grande_a_testo(struct g11_grande *x, char *testo) {
+    char *p = testo + 10u * x->n + 1u;
+    *p = '\0';
+    uint32_t n = x->n;
+    do {
+        // Divide per 10^9 e scrive le nove cifre decimali del resto
+        uint64_t resto = 0;
+        for (uint32_t i = n; i-- > 0; ) {
+            uint64_t cur = resto << 32 | x->cifre[i];
+            x->cifre[i] = (uint32_t) (cur / 1000000000u);
+            resto = cur % 1000000000u;
+        }
+        n = g11_cifre_normalizza(x->cifre, n);
+        for (int k = 0; k < 9 && (n > 0 || resto > 0 || k == 0); k++) {
+            *--p = (char) ('0' + resto % 10);
+            resto /= 10;
+        }
+    } while (n > 0);
+    if (x->negativo) {
+        *--p = '-';
+    }
+    return p;
+}
+
+#endif // GRANDI_G11_H
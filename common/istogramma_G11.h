@@ -0,0 +1,95 @@
+// Istogramma delle latenze in stile HDR (High Dynamic Range).
+//
+// I valori (nanosecondi) sono raggruppati in intervalli log-lineari: ogni potenza di 2 è divisa in 64
+// sottointervalli, quindi l'errore relativo di un percentile è al più 1/64 (~1.6%) su tutta la scala,
+// da pochi nanosecondi a decine di minuti, con una tabella di dimensione fissa. La registrazione è un
+// solo incremento; ogni thread ne usa uno proprio e gli istogrammi vengono sommati alla fine.
+#ifndef ISTOGRAMMA_G11_H
+#define ISTOGRAMMA_G11_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define G11_ISTO_BIT_SOTTO 6                           // 2^6 sottointervalli per potenza di 2
+#define G11_ISTO_SOTTO (1u << G11_ISTO_BIT_SOTTO)
+#define G11_ISTO_MAX_VALORE ((1ULL << 41) - 1)         // ~36 minuti in ns: i valori oltre vengono limitati
+#define G11_ISTO_INTERVALLI ((41 - G11_ISTO_BIT_SOTTO) * G11_ISTO_SOTTO + 2 * G11_ISTO_SOTTO)
+
+struct g11_istogramma {
+    uint64_t conteggi[G11_ISTO_INTERVALLI];
+    uint64_t totale;   // Valori registrati
+    uint64_t somma;    // Somma dei valori, per la media
+    uint64_t minimo;
+    uint64_t massimo;  // Valore massimo esatto
+};
+
+static inline void g11_isto_azzera(struct g11_istogramma *h) {
+    memset(h, 0, sizeof(*h));
+    h->minimo = UINT64_MAX;
+}
+
+// Indice dell'intervallo di un valore: sotto 2*64 gli intervalli sono esatti, poi ogni potenza di 2
+// occupa 64 intervalli larghi 2^e.
+static inline uint32_t g11_isto_indice(uint64_t v) {
+    if (v < 2 * G11_ISTO_SOTTO) {
+        return (uint32_t) v;
+    }
+    uint32_t e = (uint32_t) (63 - __builtin_clzll(v)) - G11_ISTO_BIT_SOTTO;
+    return e * G11_ISTO_SOTTO + (uint32_t) (v >> e);
+}
+
+// Valore più alto rappresentato dall'intervallo (come "highest equivalent value" di HdrHistogram)
+static inline uint64_t g11_isto_valore(uint32_t indice) {
+    if (indice < 2 * G11_ISTO_SOTTO) {
+        return indice;
+    }
+    uint32_t e = indice / G11_ISTO_SOTTO - 1;
+    uint64_t s = indice - e * G11_ISTO_SOTTO;
+    return ((s + 1) << e) - 1;
+}
+
+static inline void g11_isto_registra(struct g11_istogramma *h, uint64_t v) {
+    if (v > G11_ISTO_MAX_VALORE) {
+        v = G11_ISTO_MAX_VALORE;
+    }
+    h->conteggi[g11_isto_indice(v)]++;
+    h->totale++;
+    h->somma += v;
+    if (v < h->minimo) h->minimo = v;
+    if (v > h->massimo) h->massimo = v;
+}
+
+// Somma l'istogramma 'da' in 'in' (usato per riunire quelli dei singoli thread)
+static inline void g11_isto_unisci(struct g11_istogramma *in, const struct g11_istogramma *da) {
+    for (uint32_t i = 0; i < G11_ISTO_INTERVALLI; i++) {
+        in->conteggi[i] += da->conteggi[i];
+    }
+    in->totale += da->totale;
+    in->somma += da->somma;
+    if (da->minimo < in->minimo) in->minimo = da->minimo;
+    if (da->massimo > in->massimo) in->massimo = da->massimo;
+}
+
+// Valore al percentile p (0-100): il più piccolo valore registrato che ne lascia sotto di sé almeno il p%.
+static inline uint64_t g11_isto_percentile(const struct g11_istogramma *h, double p) {
+    if (h->totale == 0) {
+        return 0;
+    }
+    uint64_t soglia = (uint64_t) (p / 100.0 * (double) h->totale + 0.5);
+    if (soglia < 1) soglia = 1;
+    uint64_t visti = 0;
+    for (uint32_t i = 0; i < G11_ISTO_INTERVALLI; i++) {
+        visti += h->conteggi[i];
+        if (visti >= soglia) {
+            uint64_t v = g11_isto_valore(i);
+            return v < h->massimo ? v : h->massimo;
+        }
+    }
+    return h->massimo;
+}
+
+static inline double g11_isto_media(const struct g11_istogramma *h) {
+    return h->totale ? (double) h->somma / (double) h->totale : 0.0;
+}
+
+#endif // ISTOGRAMMA_G11_H
@@ -0,0 +1,298 @@
+// Kernel vettoriali per le operazioni a lotti (G11_OP_LOTTO).
+//
+// Ogni kernel applica la stessa operazione a due vettori di operandi e scrive il vettore dei risultati
+// e lo stato di ogni elemento (divisione per zero, overflow). Operandi e risultati restano in network byte
+// order: i kernel leggono direttamente dal buffer di ricezione e scrivono direttamente nel frame di risposta,
+// in un solo passaggio su memoria contigua. La versione usata (AVX2, SSE2 o scalare) viene scelta a runtime
+// in base alla CPU.
+#ifndef KERNEL_G11_H
+#define KERNEL_G11_H
+
+#include <stdint.h>
+#include <string.h>
+#include "protocollo_G11.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>  // Intrinseche SSE2/AVX2 (le funzioni AVX2 sono compilate con l'attributo target)
+#define G11_KERNEL_X86 1
+#endif
+
+// a, b: vettori di n interi big-endian; r: risultati big-endian; stati: un byte G11_STATO_* per elemento.
+// Ritorna il numero di elementi con stato diverso da G11_STATO_OK.
+typedef uint32_t (*g11_kernel_lotto_fn)(uint8_t op, const uint8_t *a, const uint8_t *b,
+                                        uint8_t *r, uint8_t *stati, uint32_t n);
+
+// Versione scalare: usata sulle CPU senza SSE2/AVX2 e per gli elementi finali che non riempiono un registro.
+// I risultati fuori dall'intervallo di int32 hanno lo stato G11_STATO_OVERFLOW e il valore troncato.
+static inline uint32_t g11_kernel_scalare(uint8_t op, const uint8_t *a, const uint8_t *b,
+                                          uint8_t *r, uint8_t *stati, uint32_t n) {
+    uint32_t errori = 0;
+    // Lo switch è fuori dal ciclo: ogni ciclo interno resta semplice
+    switch (op) {
+        case G11_OP_ADDIZIONE:
+            for (uint32_t i = 0; i < n; i++) {
+                int32_t v;
+                stati[i] = __builtin_add_overflow((int32_t) g11_leggi_u32(a + 4 * i), (int32_t) g11_leggi_u32(b + 4 * i), &v)
+                           ? G11_STATO_OVERFLOW : G11_STATO_OK;
+                g11_scrivi_u32(r + 4 * i, (uint32_t) v);
+                errori += stati[i] != G11_STATO_OK;
+            }
+            break;
+        case G11_OP_SOTTRAZIONE:
+            for (uint32_t i = 0; i < n; i++) {
+                int32_t v;
+                stati[i] = __builtin_sub_overflow((int32_t) g11_leggi_u32(a + 4 * i), (int32_t) g11_leggi_u32(b + 4 * i), &v)
+                           ? G11_STATO_OVERFLOW : G11_STATO_OK;
+                g11_scrivi_u32(r + 4 * i, (uint32_t) v);
+                errori += stati[i] != G11_STATO_OK;
+            }
+            break;
+        case G11_OP_MOLTIPLICAZIONE:
+            for (uint32_t i = 0; i < n; i++) {
+                int32_t v;
+                stati[i] = __builtin_mul_overflow((int32_t) g11_leggi_u32(a + 4 * i), (int32_t) g11_leggi_u32(b + 4 * i), &v)
+                           ? G11_STATO_OVERFLOW : G11_STATO_OK;
+                g11_scrivi_u32(r + 4 * i, (uint32_t) v);
+                errori += stati[i] != G11_STATO_OK;
+            }
+            break;
+        case G11_OP_DIVISIONE:
+            for (uint32_t i = 0; i < n; i++) {
+                int32_t va = (int32_t) g11_leggi_u32(a + 4 * i);
+                int32_t vb = (int32_t) g11_leggi_u32(b + 4 * i);
+                int32_t q = 0;
+                if (vb == 0) {
+                    stati[i] = G11_STATO_DIV_ZERO;
+                } else if (vb == -1 && va == INT32_MIN) {
+                    q = INT32_MIN; // Il quoziente 2^31 non è rappresentabile e genererebbe SIGFPE
+                    stati[i] = G11_STATO_OVERFLOW;
+                } else {
+                    q = va / vb;
+                    stati[i] = G11_STATO_OK;
+                }
+                g11_scrivi_u32(r + 4 * i, (uint32_t) q);
+                errori += stati[i] != G11_STATO_OK;
+            }
+            break;
+    }
+    return errori;
+}
+
+#ifdef G11_KERNEL_X86
+
+// Stato di 4 elementi consecutivi a partire dalle maschere dei divisori nulli e degli overflow (un bit per
+// elemento). La tabella porta ogni bit nel byte corrispondente (x86 è little-endian); G11_STATO_DIV_ZERO
+// vale 1 e le due maschere sono disgiunte, quindi basta moltiplicare la seconda per G11_STATO_OVERFLOW.
+static const uint32_t g11_stati_da_maschera[16] = {
+    0x00000000, 0x00000001, 0x00000100, 0x00000101, 0x00010000, 0x00010001, 0x00010100, 0x00010101,
+    0x01000000, 0x01000001, 0x01000100, 0x01000101, 0x01010000, 0x01010001, 0x01010100, 0x01010101,
+};
+
+static inline void g11_scrivi_stati4(uint8_t *stati, unsigned zeri, unsigned overflow) {
+    uint32_t v = g11_stati_da_maschera[zeri & 15] * G11_STATO_DIV_ZERO +
+                 g11_stati_da_maschera[overflow & 15] * G11_STATO_OVERFLOW;
+    memcpy(stati, &v, 4);
+}
+
+// --- SSE2 (4 elementi per registro) ---
+
+// Inverte l'ordine dei byte di ogni intero a 32 bit (SSE2 non ha pshufb)
+static inline __m128i g11_bswap_sse2(__m128i x) {
+    x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+    x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+// Prodotto a 32 bit (parte bassa) con le sole istruzioni SSE2
+static inline __m128i g11_mullo_sse2(__m128i a, __m128i b) {
+    __m128i pari = _mm_mul_epu32(a, b);
+    __m128i dispari = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(pari, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(dispari, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Overflow di somma e sottrazione: il segno del risultato è diverso da quello atteso dagli operandi
+static inline unsigned g11_overflow_somma_sse2(__m128i a, __m128i b, __m128i r) {
+    __m128i x = _mm_and_si128(_mm_xor_si128(a, r), _mm_xor_si128(b, r));
+    return (unsigned) _mm_movemask_ps(_mm_castsi128_ps(x));
+}
+
+static inline unsigned g11_overflow_differenza_sse2(__m128i a, __m128i b, __m128i r) {
+    __m128i x = _mm_and_si128(_mm_xor_si128(a, b), _mm_xor_si128(a, r));
+    return (unsigned) _mm_movemask_ps(_mm_castsi128_ps(x));
+}
+
+// Overflow del prodotto: in double il prodotto di due int32 è esatto fino a 2^53 e, oltre, è comunque
+// fuori dall'intervallo, quindi il confronto con i limiti di int32 non sbaglia mai.
+static inline unsigned g11_overflow_prodotto_sse2(__m128i a, __m128i b) {
+    const __m128d max = _mm_set1_pd(2147483647.0), min = _mm_set1_pd(-2147483648.0);
+    __m128d p_lo = _mm_mul_pd(_mm_cvtepi32_pd(a), _mm_cvtepi32_pd(b));
+    __m128d p_hi = _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(a, 8)), _mm_cvtepi32_pd(_mm_srli_si128(b, 8)));
+    unsigned m_lo = (unsigned) _mm_movemask_pd(_mm_or_pd(_mm_cmpgt_pd(p_lo, max), _mm_cmplt_pd(p_lo, min)));
+    unsigned m_hi = (unsigned) _mm_movemask_pd(_mm_or_pd(_mm_cmpgt_pd(p_hi, max), _mm_cmplt_pd(p_hi, min)));
+    return m_lo | m_hi << 2;
+}
+
+// Divisione troncata tramite double: ogni int32 è rappresentabile esattamente e il quoziente arrotondato
+// tronca sempre all'intero corretto. I divisori nulli vengono sostituiti da 1 e i risultati azzerati.
+static inline __m128i g11_div_sse2(__m128i a, __m128i b, __m128i nulli) {
+    b = _mm_or_si128(b, _mm_and_si128(nulli, _mm_set1_epi32(1)));
+    __m128d q_lo = _mm_div_pd(_mm_cvtepi32_pd(a), _mm_cvtepi32_pd(b));
+    __m128d q_hi = _mm_div_pd(_mm_cvtepi32_pd(_mm_srli_si128(a, 8)), _mm_cvtepi32_pd(_mm_srli_si128(b, 8)));
+    __m128i q = _mm_unpacklo_epi64(_mm_cvttpd_epi32(q_lo), _mm_cvttpd_epi32(q_hi));
+    return _mm_andnot_si128(nulli, q); // INT32_MIN / -1 produce 0x80000000, il valore troncato
+}
+
+static inline uint32_t g11_kernel_sse2(uint8_t op, const uint8_t *a, const uint8_t *b,
+                                       uint8_t *r, uint8_t *stati, uint32_t n) {
+    uint32_t i = 0, errori = 0;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i minimo = _mm_set1_epi32(INT32_MIN), meno_uno = _mm_set1_epi32(-1);
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i va = g11_bswap_sse2(_mm_loadu_si128((const __m128i *) (a + 4 * i)));
+        __m128i vb = g11_bswap_sse2(_mm_loadu_si128((const __m128i *) (b + 4 * i)));
+        __m128i vr;
+        unsigned zeri = 0, overflow;
+        switch (op) {
+            case G11_OP_ADDIZIONE:
+                vr = _mm_add_epi32(va, vb);
+                overflow = g11_overflow_somma_sse2(va, vb, vr);
+                break;
+            case G11_OP_SOTTRAZIONE:
+                vr = _mm_sub_epi32(va, vb);
+                overflow = g11_overflow_differenza_sse2(va, vb, vr);
+                break;
+            case G11_OP_MOLTIPLICAZIONE:
+                vr = g11_mullo_sse2(va, vb);
+                overflow = g11_overflow_prodotto_sse2(va, vb);
+                break;
+            default: {
+                __m128i nulli = _mm_cmpeq_epi32(vb, zero);
+                __m128i fuori = _mm_and_si128(_mm_cmpeq_epi32(va, minimo), _mm_cmpeq_epi32(vb, meno_uno));
+                zeri = (unsigned) _mm_movemask_ps(_mm_castsi128_ps(nulli));
+                overflow = (unsigned) _mm_movemask_ps(_mm_castsi128_ps(fuori));
+                vr = g11_div_sse2(va, vb, nulli);
+            }
+        }
+        _mm_storeu_si128((__m128i *) (r + 4 * i), g11_bswap_sse2(vr));
+        g11_scrivi_stati4(stati + i, zeri, overflow);
+        errori += (uint32_t) __builtin_popcount(zeri | overflow);
+    }
+    return errori + g11_kernel_scalare(op, a + 4 * i, b + 4 * i, r + 4 * i, stati + i, n - i);
+}
+
+// --- AVX2 (8 elementi per registro) ---
+
+__attribute__((target("avx2")))
+static inline __m256i g11_bswap_avx2(__m256i x) {
+    const __m256i ordine = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                            3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    return _mm256_shuffle_epi8(x, ordine);
+}
+
+__attribute__((target("avx2")))
+static inline unsigned g11_overflow_prodotto_avx2(__m256i a, __m256i b) {
+    const __m256d max = _mm256_set1_pd(2147483647.0), min = _mm256_set1_pd(-2147483648.0);
+    __m256d p_lo = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(a)),
+                                 _mm256_cvtepi32_pd(_mm256_castsi256_si128(b)));
+    __m256d p_hi = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(a, 1)),
+                                 _mm256_cvtepi32_pd(_mm256_extracti128_si256(b, 1)));
+    unsigned m_lo = (unsigned) _mm256_movemask_pd(_mm256_or_pd(_mm256_cmp_pd(p_lo, max, _CMP_GT_OQ),
+                                                               _mm256_cmp_pd(p_lo, min, _CMP_LT_OQ)));
+    unsigned m_hi = (unsigned) _mm256_movemask_pd(_mm256_or_pd(_mm256_cmp_pd(p_hi, max, _CMP_GT_OQ),
+                                                               _mm256_cmp_pd(p_hi, min, _CMP_LT_OQ)));
+    return m_lo | m_hi << 4;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i g11_div_avx2(__m256i a, __m256i b, __m256i nulli) {
+    b = _mm256_or_si256(b, _mm256_and_si256(nulli, _mm256_set1_epi32(1)));
+    __m256d q_lo = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(a)),
+                                 _mm256_cvtepi32_pd(_mm256_castsi256_si128(b)));
+    __m256d q_hi = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(a, 1)),
+                                 _mm256_cvtepi32_pd(_mm256_extracti128_si256(b, 1)));
+    __m256i q = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm256_cvttpd_epi32(q_lo)),
+                                        _mm256_cvttpd_epi32(q_hi), 1);
+    return _mm256_andnot_si256(nulli, q);
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t g11_kernel_avx2(uint8_t op, const uint8_t *a, const uint8_t *b,
+                                       uint8_t *r, uint8_t *stati, uint32_t n) {
+    uint32_t i = 0, errori = 0;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i minimo = _mm256_set1_epi32(INT32_MIN), meno_uno = _mm256_set1_epi32(-1);
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i va = g11_bswap_avx2(_mm256_loadu_si256((const __m256i *) (a + 4 * i)));
+        __m256i vb = g11_bswap_avx2(_mm256_loadu_si256((const __m256i *) (b + 4 * i)));
+        __m256i vr, fuori;
+        unsigned zeri = 0, overflow;
+        switch (op) {
+            case G11_OP_ADDIZIONE:
+                vr = _mm256_add_epi32(va, vb);
+                fuori = _mm256_and_si256(_mm256_xor_si256(va, vr), _mm256_xor_si256(vb, vr));
+                overflow = (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(fuori));
+                break;
+            case G11_OP_SOTTRAZIONE:
+                vr = _mm256_sub_epi32(va, vb);
+                fuori = _mm256_and_si256(_mm256_xor_si256(va, vb), _mm256_xor_si256(va, vr));
+                overflow = (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(fuori));
+                break;
+            case G11_OP_MOLTIPLICAZIONE:
+                vr = _mm256_mullo_epi32(va, vb);
+                overflow = g11_overflow_prodotto_avx2(va, vb);
+                break;
+            default: {
+                __m256i nulli = _mm256_cmpeq_epi32(vb, zero);
+                fuori = _mm256_and_si256(_mm256_cmpeq_epi32(va, minimo), _mm256_cmpeq_epi32(vb, meno_uno));
+                zeri = (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(nulli));
+                overflow = (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(fuori));
+                vr = g11_div_avx2(va, vb, nulli);
+            }
+        }
+        _mm256_storeu_si256((__m256i *) (r + 4 * i), g11_bswap_avx2(vr));
+        g11_scrivi_stati4(stati + i, zeri, overflow);
+        g11_scrivi_stati4(stati + i + 4, zeri >> 4, overflow >> 4);
+        errori += (uint32_t) __builtin_popcount(zeri | overflow);
+    }
+    return errori + g11_kernel_scalare(op, a + 4 * i, b + 4 * i, r + 4 * i, stati + i, n - i);
+}
+
+#endif // G11_KERNEL_X86
+
+// Sceglie il kernel migliore per la CPU corrente. Il risultato viene memorizzato alla prima chiamata;
+// più thread possono eseguire la scelta in parallelo e scrivono tutti lo stesso valore, con accessi atomici.
+static inline g11_kernel_lotto_fn g11_kernel_lotto(void) {
+    static g11_kernel_lotto_fn scelto = NULL;
+    g11_kernel_lotto_fn k = __atomic_load_n(&scelto, __ATOMIC_RELAXED);
+    if (k == NULL) {
+#ifdef G11_KERNEL_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            k = g11_kernel_avx2;
+        } else if (__builtin_cpu_supports("sse2")) {
+            k = g11_kernel_sse2;
+        } else
+#endif
+        {
+            k = g11_kernel_scalare;
+        }
+        __atomic_store_n(&scelto, k, __ATOMIC_RELAXED);
+    }
+    return k;
+}
+
+// Nome del kernel scelto, stampato all'avvio dei server.
+static inline const char *g11_nome_kernel(void) {
+    g11_kernel_lotto_fn k = g11_kernel_lotto();
+#ifdef G11_KERNEL_X86
+    if (k == g11_kernel_avx2) return "AVX2";
+    if (k == g11_kernel_sse2) return "SSE2";
+#endif
+    (void) k;
+    return "scalare";
+}
+
+#endif // KERNEL_G11_H
@@ -0,0 +1,646 @@
+// Libreria client del calcolatore, utilizzabile da più thread contemporaneamente.
+//
+// Un cliente (struct g11_calc) mantiene un insieme di connessioni persistenti verso uno o più server.
+// Sulla stessa connessione viaggiano le richieste di molti thread: ognuna ha un id, e il thread di
+// ricezione della connessione abbina ogni risposta alla richiesta in attesa con lo stesso id, in
+// qualunque ordine arrivi. Una connessione caduta fa fallire le richieste in volo con
+// G11_CALC_ERRORE_CONNESSIONE e viene ristabilita in sottofondo.
+//
+// Tre modi di chiamare:
+//   g11_calc_esegui       bloccante: ritorna lo stato e scrive il risultato
+//   g11_calc_futuro       accoda la richiesta; g11_futuro_attendi ne attende il risultato
+//   g11_calc_callback     accoda la richiesta; la funzione viene chiamata dal thread di ricezione
+//   g11_calc_esegui_frame bloccante, per un frame già codificato (es. operandi int64, double o grandi)
+//
+// Percorso veloce: le richieste accodate da un thread restano in un'area locale del thread fino a
+// g11_calc_scarica (o alla prima attesa, o a MAX_ACCODATE richieste). Allo scarico, le richieste con la
+// stessa operazione diventano un solo frame a lotti (fino a max_lotto coppie) e tutti i frame partono
+// con una sola write. Ogni richiesta mantiene comunque il proprio futuro.
+#ifndef LIBCALC_G11_H
+#define LIBCALC_G11_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "protocollo_G11.h"
+
+#define G11_CALC_ERRORE_CONNESSIONE -1    // Stato locale: connessione caduta o assente, nessuna risposta
+#define G11_CALC_MAX_ACCODATE 1024        // Richieste accodate da un thread prima dell'invio automatico
+#define G11_CALC_IN_VOLO 4096             // Frame in attesa di risposta per connessione (potenza di 2)
+#define G11_CALC_LOTTO_PREDEFINITO 1024   // Coppie massime per frame aggregato se max_lotto è 0
+#define G11_CALC_RICONNESSIONE_US 100000  // Attesa tra due tentativi di riconnessione
+#define G11_CALC_DIM_RICEZIONE 65536      // Buffer iniziale del thread di ricezione
+
+typedef void (*g11_calc_funzione)(void *arg, int stato, int32_t risultato);
+
+// Risultato futuro di una richiesta. La memoria è del chiamante e deve restare valida fino al completamento.
+struct g11_futuro {
+    uint32_t pronto;             // 0 in attesa, 1 completato, 2 un thread attende sul futex
+    int stato;                   // G11_STATO_* oppure G11_CALC_ERRORE_CONNESSIONE
+    int32_t risultato;
+    g11_calc_funzione funzione;  // API con callback: chiamata al completamento, poi il futuro viene liberato
+    void *arg;
+    uint8_t *risposta;           // g11_calc_esegui_frame: dove copiare il frame di risposta
+    size_t spazio;
+};
+
+// Frame in attesa di risposta: una richiesta singola oppure un lotto che raccoglie più futuri
+struct g11_calc_attesa {
+    uint32_t id;
+    uint32_t n;                  // 0 = posto libero
+    struct g11_futuro *futuro;   // n == 1
+    struct g11_futuro **futuri;  // n > 1, nell'ordine delle coppie del lotto
+};
+
+struct g11_calc_connessione {
+    struct g11_calc *cliente;
+    struct sockaddr_in server;
+    int fd;                       // -1 se non connessa; cambia solo con 'scrittura' bloccato
+    pthread_mutex_t scrittura;    // Scritture sul socket: i frame di uno scarico restano contigui
+    pthread_mutex_t tabella;      // Tabella delle attese (sezioni critiche brevi, mai durante l'I/O)
+    pthread_cond_t spazio;        // Segnalata quando si libera un posto nella tabella
+    uint32_t prossimo_id;
+    uint32_t in_volo;
+    pthread_t ricevitore;
+    struct g11_calc_attesa attese[G11_CALC_IN_VOLO];
+};
+
+struct g11_calc {
+    int n;                        // Connessioni totali
+    uint32_t max_lotto;           // Coppie massime per frame aggregato (1 = nessuna aggregazione)
+    int chiusura;
+    unsigned prossima;            // Assegnazione circolare delle connessioni ai thread
+    struct g11_calc_connessione **conn;
+};
+
+// Richieste accodate dal thread e non ancora inviate
+struct g11_calc_accodate {
+    struct g11_calc *cliente;
+    int connessione;              // Connessione preferita del thread, -1 se non ancora scelta
+    uint32_t n;
+    uint8_t op[G11_CALC_MAX_ACCODATE];
+    int32_t a[G11_CALC_MAX_ACCODATE], b[G11_CALC_MAX_ACCODATE];
+    struct g11_futuro *futuro[G11_CALC_MAX_ACCODATE];
+    uint32_t id[G11_CALC_MAX_ACCODATE];  // Id dei frame dello scarico in corso
+    uint8_t *frame;               // Frame dello scarico in corso
+    size_t dim_frame;
+};
+
+static _Thread_local struct g11_calc_accodate g11_calc_locale = { .connessione = -1 };
+
+// --- Completamento dei futuri ---
+
+static inline void g11_futuro_completa(struct g11_futuro *f, int stato, int32_t risultato) {
+    f->stato = stato;
+    f->risultato = risultato;
+    if (f->funzione != NULL) {
+        f->funzione(f->arg, stato, risultato);
+        free(f);
+        return;
+    }
+    if (__atomic_exchange_n(&f->pronto, 1, __ATOMIC_RELEASE) == 2) {
+        syscall(SYS_futex, &f->pronto, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0); // Sveglia chi attende
+    }
+}
+
+static inline void g11_calc_completa_attesa(struct g11_calc_attesa *t, int stato) {
+    if (t->n == 1) {
+        g11_futuro_completa(t->futuro, stato, 0);
+    } else {
+        for (uint32_t i = 0; i < t->n; i++) {
+            g11_futuro_completa(t->futuri[i], stato, 0);
+        }
+        free(t->futuri);
+    }
+}
+
+// Toglie dalla tabella il frame con l'id indicato. Ritorna 1 e copia l'attesa in 't' se era presente.
+static inline int g11_calc_ritira(struct g11_calc_connessione *c, uint32_t id, struct g11_calc_attesa *t) {
+    int trovato = 0;
+    pthread_mutex_lock(&c->tabella);
+    struct g11_calc_attesa *a = &c->attese[id & (G11_CALC_IN_VOLO - 1)];
+    if (a->n != 0 && a->id == id) {
+        *t = *a;
+        a->n = 0;
+        c->in_volo--;
+        pthread_cond_signal(&c->spazio);
+        trovato = 1;
+    }
+    pthread_mutex_unlock(&c->tabella);
+    return trovato;
+}
+
+// Completa i futuri di un frame di risposta
+static inline void g11_calc_consegna(struct g11_calc_attesa *t, const struct g11_frame *f) {
+    if (t->n == 1 && t->futuro->risposta != NULL) {
+        memcpy(t->futuro->risposta, f->corpo - G11_DIM_INTESTAZIONE, f->lunghezza < t->futuro->spazio ? f->lunghezza : t->futuro->spazio);
+    }
+    if (t->n == 1) {
+        g11_futuro_completa(t->futuro, f->codice, f->dim_corpo >= 4 ? (int32_t) g11_leggi_u32(f->corpo) : 0);
+        return;
+    }
+    uint32_t n = f->dim_corpo >= 4 ? g11_leggi_u32(f->corpo) : 0;
+    if (f->codice != G11_STATO_OK || n != t->n || f->dim_corpo < 4 + 5u * n) {
+        g11_calc_completa_attesa(t, f->codice != G11_STATO_OK ? f->codice : G11_STATO_FORMATO);
+        return;
+    }
+    const uint8_t *risultati = f->corpo + 4;
+    const uint8_t *stati = risultati + 4u * n;
+    for (uint32_t i = 0; i < n; i++) {
+        g11_futuro_completa(t->futuri[i], stati[i], (int32_t) g11_leggi_u32(risultati + 4u * i));
+    }
+    free(t->futuri);
+}
+
+// --- Connessioni ---
+
+static inline int g11_calc_connetti(const struct sockaddr_in *server) {
+    static const int uno = 1;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (const struct sockaddr *) server, sizeof(*server)) < 0) {
+        close(fd);
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &uno, sizeof(uno));
+    return fd;
+}
+
+// La connessione è caduta: chiude il socket e fa fallire tutte le richieste in volo.
+static inline void g11_calc_caduta(struct g11_calc_connessione *c) {
+    pthread_mutex_lock(&c->scrittura);
+    if (c->fd >= 0) {
+        close(c->fd);
+        c->fd = -1;
+    }
+    pthread_mutex_unlock(&c->scrittura);
+
+    for (uint32_t i = 0; i < G11_CALC_IN_VOLO; i++) {
+        struct g11_calc_attesa t;
+        pthread_mutex_lock(&c->tabella);
+        t = c->attese[i];
+        c->attese[i].n = 0;
+        if (t.n != 0) c->in_volo--;
+        pthread_mutex_unlock(&c->tabella);
+        if (t.n != 0) {
+            g11_calc_completa_attesa(&t, G11_CALC_ERRORE_CONNESSIONE);
+        }
+    }
+    pthread_mutex_lock(&c->tabella);
+    pthread_cond_broadcast(&c->spazio);
+    pthread_mutex_unlock(&c->tabella);
+}
+
+// Thread di ricezione di una connessione: legge le risposte e le consegna ai futuri in base all'id.
+// Quando la connessione cade riprova a connettersi finché il cliente non viene chiuso.
+static void *g11_calc_ricezione(void *arg) {
+    struct g11_calc_connessione *c = arg;
+    size_t dim = G11_CALC_DIM_RICEZIONE, letti = 0;
+    uint8_t *buf = malloc(dim);
+    if (buf == NULL) {
+        g11_calc_caduta(c);
+        return NULL;
+    }
+
+    while (!__atomic_load_n(&c->cliente->chiusura, __ATOMIC_ACQUIRE)) {
+        if (__atomic_load_n(&c->fd, __ATOMIC_ACQUIRE) < 0) {
+            int fd = g11_calc_connetti(&c->server);
+            if (fd < 0) {
+                struct timespec pausa = { 0, G11_CALC_RICONNESSIONE_US * 1000 };
+                nanosleep(&pausa, NULL);
+                continue;
+            }
+            pthread_mutex_lock(&c->scrittura);
+            if (__atomic_load_n(&c->cliente->chiusura, __ATOMIC_ACQUIRE)) {
+                close(fd); // g11_calc_chiudi è già passato: nessuno sbloccherebbe la read
+                pthread_mutex_unlock(&c->scrittura);
+                break;
+            }
+            __atomic_store_n(&c->fd, fd, __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&c->scrittura);
+            letti = 0;
+        }
+
+        ssize_t n = read(c->fd, buf + letti, dim - letti);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            g11_calc_caduta(c);
+            continue;
+        }
+        letti += (size_t) n;
+
+        size_t consumati = 0;
+        struct g11_frame f;
+        int esito;
+        while ((esito = g11_analizza_frame(buf + consumati, letti - consumati, G11_MAX_FRAME, &f)) == G11_FRAME_COMPLETO) {
+            struct g11_calc_attesa t;
+            if (g11_calc_ritira(c, f.id, &t)) {
+                g11_calc_consegna(&t, &f);
+            }
+            consumati += f.lunghezza;
+        }
+        if (esito == G11_FRAME_ERRATO) {
+            g11_calc_caduta(c); // Flusso non più delimitabile
+            continue;
+        }
+        memmove(buf, buf + consumati, letti - consumati);
+        letti -= consumati;
+        uint32_t annunciata = g11_lunghezza_annunciata(buf, letti);
+        if (annunciata > dim || letti == dim) {
+            size_t nuova = annunciata > dim ? annunciata : dim * 2;
+            uint8_t *p = realloc(buf, nuova);
+            if (p == NULL) {
+                g11_calc_caduta(c);
+                continue;
+            }
+            buf = p;
+            dim = nuova;
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+// Crea un cliente con 'per_server' connessioni verso ciascuno degli 'n_server' indirizzi.
+// 'max_lotto' limita le coppie di un frame aggregato (0 = predefinito, 1 = nessuna aggregazione).
+// Ritorna NULL se nessuna connessione iniziale riesce (errno indica l'ultimo errore).
+static inline struct g11_calc *g11_calc_crea(const struct sockaddr_in *server, int n_server, int per_server,
+                                            uint32_t max_lotto) {
+    if (n_server <= 0 || per_server <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    struct g11_calc *cl = calloc(1, sizeof(*cl));
+    if (cl == NULL) {
+        return NULL;
+    }
+    cl->max_lotto = max_lotto == 0 ? G11_CALC_LOTTO_PREDEFINITO : max_lotto > G11_MAX_LOTTO ? G11_MAX_LOTTO : max_lotto;
+    cl->conn = calloc((size_t) (n_server * per_server), sizeof(*cl->conn));
+    if (cl->conn == NULL) {
+        free(cl);
+        return NULL;
+    }
+
+    int connesse = 0, err = 0;
+    for (int i = 0; i < n_server * per_server; i++) {
+        struct g11_calc_connessione *c = calloc(1, sizeof(*c));
+        if (c == NULL) {
+            break;
+        }
+        c->cliente = cl;
+        c->server = server[i % n_server];
+        c->fd = g11_calc_connetti(&c->server);
+        if (c->fd >= 0) {
+            connesse++;
+        } else {
+            err = errno;
+        }
+        pthread_mutex_init(&c->scrittura, NULL);
+        pthread_mutex_init(&c->tabella, NULL);
+        pthread_cond_init(&c->spazio, NULL);
+        if (pthread_create(&c->ricevitore, NULL, g11_calc_ricezione, c) != 0) {
+            if (c->fd >= 0) close(c->fd);
+            free(c);
+            break;
+        }
+        cl->conn[cl->n++] = c;
+    }
+    if (connesse == 0) {
+        __atomic_store_n(&cl->chiusura, 1, __ATOMIC_RELEASE);
+        for (int i = 0; i < cl->n; i++) {
+            pthread_join(cl->conn[i]->ricevitore, NULL);
+            free(cl->conn[i]);
+        }
+        free(cl->conn);
+        free(cl);
+        errno = err ? err : ENOMEM;
+        return NULL;
+    }
+    return cl;
+}
+
+// --- Invio ---
+
+// Sceglie la connessione del thread: sempre la stessa finché è attiva, così le richieste di un thread
+// arrivano in ordine e si aggregano; se è caduta si prova la successiva.
+static inline struct g11_calc_connessione *g11_calc_scegli(struct g11_calc *cl) {
+    struct g11_calc_accodate *q = &g11_calc_locale;
+    if (q->connessione < 0 || q->connessione >= cl->n) {
+        q->connessione = (int) (__atomic_fetch_add(&cl->prossima, 1, __ATOMIC_RELAXED) % (unsigned) cl->n);
+    }
+    for (int k = 0; k < cl->n; k++) {
+        struct g11_calc_connessione *c = cl->conn[(q->connessione + k) % cl->n];
+        if (__atomic_load_n(&c->fd, __ATOMIC_ACQUIRE) >= 0) {
+            q->connessione = (q->connessione + k) % cl->n;
+            return c;
+        }
+    }
+    return NULL;
+}
+
+// Registra un frame nella tabella delle attese e ne scrive l'id in *id. Se la tabella è piena attende
+// che si liberi un posto, oppure con 'attendi' a 0 ritorna subito 0 senza registrare. Ritorna 1 se registrato.
+static inline int g11_calc_registra(struct g11_calc_connessione *c, uint32_t n, struct g11_futuro *futuro,
+                                    struct g11_futuro **futuri, int attendi, uint32_t *id_frame) {
+    pthread_mutex_lock(&c->tabella);
+    while (c->in_volo == G11_CALC_IN_VOLO) {
+        if (!attendi) {
+            pthread_mutex_unlock(&c->tabella);
+            return 0;
+        }
+        pthread_cond_wait(&c->spazio, &c->tabella);
+    }
+    uint32_t id = c->prossimo_id++;
+    while (c->attese[id & (G11_CALC_IN_VOLO - 1)].n != 0) {
+        id = c->prossimo_id++; // Posto ancora occupato da una richiesta lenta: si salta
+    }
+    struct g11_calc_attesa *a = &c->attese[id & (G11_CALC_IN_VOLO - 1)];
+    a->id = id;
+    a->n = n;
+    a->futuro = futuro;
+    a->futuri = futuri;
+    c->in_volo++;
+    pthread_mutex_unlock(&c->tabella);
+    *id_frame = id;
+    return 1;
+}
+
+static inline int g11_calc_riserva_frame(struct g11_calc_accodate *q, size_t richiesto) {
+    if (q->dim_frame >= richiesto) {
+        return 0;
+    }
+    size_t nuova = q->dim_frame ? q->dim_frame : 4096;
+    while (nuova < richiesto) {
+        nuova *= 2;
+    }
+    uint8_t *p = realloc(q->frame, nuova);
+    if (p == NULL) {
+        return -1;
+    }
+    q->frame = p;
+    q->dim_frame = nuova;
+    return 0;
+}
+
+static inline int g11_calc_aggregabile(uint8_t op) {
+    return op == G11_OP_ADDIZIONE || op == G11_OP_SOTTRAZIONE || op == G11_OP_MOLTIPLICAZIONE || op == G11_OP_DIVISIONE;
+}
+
+// Scrive i frame sul socket tenendo il lock di scrittura, così restano contigui. Ritorna -1 se la
+// connessione è caduta: il socket viene chiuso in entrambe le direzioni e il thread di ricezione se ne accorge.
+static inline int g11_calc_invia(struct g11_calc_connessione *c, const uint8_t *buf, size_t dim) {
+    int esito = 0;
+    pthread_mutex_lock(&c->scrittura);
+    for (size_t scritti = 0; scritti < dim; ) {
+        ssize_t w = c->fd >= 0 ? send(c->fd, buf + scritti, dim - scritti, MSG_NOSIGNAL) : -1;
+        if (w < 0) {
+            if (c->fd >= 0 && errno == EINTR) continue;
+            if (c->fd >= 0) shutdown(c->fd, SHUT_RDWR);
+            esito = -1;
+            break;
+        }
+        scritti += (size_t) w;
+    }
+    pthread_mutex_unlock(&c->scrittura);
+    return esito;
+}
+
+// Invia i primi 'dim' byte del buffer del thread, che contengono i frame registrati da 'primo' a 'ultimo'
+// (escluso). Se la connessione è caduta completa con errore quelli ancora in tabella e ritorna -1.
+static inline int g11_calc_invia_registrati(struct g11_calc_connessione *c, struct g11_calc_accodate *q,
+                                            uint32_t primo, uint32_t ultimo, size_t dim) {
+    if (g11_calc_invia(c, q->frame, dim) == 0) {
+        return 0;
+    }
+    // I frame non inviati non avranno risposta: se sono ancora in tabella si completano qui
+    for (uint32_t i = primo; i < ultimo; i++) {
+        struct g11_calc_attesa t;
+        if (g11_calc_ritira(c, q->id[i], &t)) {
+            g11_calc_completa_attesa(&t, G11_CALC_ERRORE_CONNESSIONE);
+        }
+    }
+    return -1;
+}
+
+// Registra un frame per lo scarico in corso. Con la tabella piena i frame già registrati ma non ancora
+// inviati vengono spediti prima di attendere: solo le loro risposte possono liberare i posti, quindi più
+// thread che scaricano sulla stessa connessione non restano ad aspettarsi a vicenda. Ritorna -1 se la
+// connessione è caduta durante quell'invio.
+static inline int g11_calc_registra_scarico(struct g11_calc_connessione *c, struct g11_calc_accodate *q,
+                                            uint32_t n, struct g11_futuro *futuro, struct g11_futuro **futuri,
+                                            uint32_t *inviati, uint32_t frame, size_t *usati) {
+    while (!g11_calc_registra(c, n, futuro, futuri, *inviati == frame, &q->id[frame])) {
+        if (g11_calc_invia_registrati(c, q, *inviati, frame, *usati) < 0) {
+            return -1;
+        }
+        *inviati = frame;
+        *usati = 0;
+    }
+    return 0;
+}
+
+// Invia le richieste accodate dal thread chiamante. Quelle con la stessa operazione vengono riunite in
+// frame a lotti, che partono con una sola write (più d'una se la tabella delle attese si riempie).
+// Ritorna 0, oppure -1 se non c'è alcuna connessione attiva (le richieste sono già state completate
+// con G11_CALC_ERRORE_CONNESSIONE).
+static inline int g11_calc_scarica(struct g11_calc *cl) {
+    struct g11_calc_accodate *q = &g11_calc_locale;
+    if (q->cliente != cl || q->n == 0) {
+        return 0;
+    }
+    uint32_t n = q->n;
+    q->n = 0;
+
+    struct g11_calc_connessione *c = g11_calc_scegli(cl);
+    if (c == NULL) {
+        for (uint32_t i = 0; i < n; i++) {
+            g11_futuro_completa(q->futuro[i], G11_CALC_ERRORE_CONNESSIONE, 0);
+        }
+        return -1;
+    }
+
+    // Raggruppamento per operazione: 'fatto' marca le richieste già inserite in un frame
+    uint8_t fatto[G11_CALC_MAX_ACCODATE];
+    int32_t va[G11_CALC_MAX_ACCODATE], vb[G11_CALC_MAX_ACCODATE];
+    memset(fatto, 0, n);
+    size_t usati = 0;
+    uint32_t frame = 0, inviati = 0;
+    int caduta = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (fatto[i]) continue;
+        uint8_t op = q->op[i];
+        uint32_t k = 0;
+        struct g11_futuro **futuri = NULL;
+        if (cl->max_lotto > 1 && g11_calc_aggregabile(op)) {
+            for (uint32_t j = i; j < n && k < cl->max_lotto; j++) {
+                if (!fatto[j] && q->op[j] == op) k++;
+            }
+        }
+        if (k > 1 && (futuri = malloc(sizeof(*futuri) * k)) != NULL) {
+            uint32_t m = 0;
+            for (uint32_t j = i; j < n && m < k; j++) {
+                if (!fatto[j] && q->op[j] == op) {
+                    fatto[j] = 1;
+                    futuri[m] = q->futuro[j];
+                    va[m] = q->a[j];
+                    vb[m] = q->b[j];
+                    m++;
+                }
+            }
+            if (caduta || g11_calc_riserva_frame(q, usati + g11_dim_richiesta_lotto(k)) < 0 ||
+                (caduta = g11_calc_registra_scarico(c, q, k, NULL, futuri, &inviati, frame, &usati) < 0)) {
+                g11_calc_completa_attesa(&(struct g11_calc_attesa) { .n = k, .futuri = futuri }, G11_CALC_ERRORE_CONNESSIONE);
+                continue;
+            }
+            g11_codifica_lotto(q->frame + usati, op, q->id[frame++], va, vb, k);
+            usati += g11_dim_richiesta_lotto(k);
+        } else {
+            fatto[i] = 1;
+            if (caduta || g11_calc_riserva_frame(q, usati + G11_DIM_RICHIESTA) < 0 ||
+                (caduta = g11_calc_registra_scarico(c, q, 1, q->futuro[i], NULL, &inviati, frame, &usati) < 0)) {
+                g11_futuro_completa(q->futuro[i], G11_CALC_ERRORE_CONNESSIONE, 0);
+                continue;
+            }
+            g11_codifica_richiesta(q->frame + usati, op, q->id[frame++], q->a[i], q->b[i]);
+            usati += G11_DIM_RICHIESTA;
+        }
+    }
+
+    if (caduta || g11_calc_invia_registrati(c, q, inviati, frame, usati) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Accoda una richiesta nell'area del thread; viene inviata con g11_calc_scarica o alla prima attesa.
+static inline void g11_calc_accoda(struct g11_calc *cl, uint8_t op, int32_t a, int32_t b, struct g11_futuro *f) {
+    struct g11_calc_accodate *q = &g11_calc_locale;
+    if (q->cliente != cl) {
+        if (q->cliente != NULL) {
+            g11_calc_scarica(q->cliente); // Il thread passa a un altro cliente
+        }
+        q->cliente = cl;
+        q->connessione = -1;
+    }
+    if (q->n == G11_CALC_MAX_ACCODATE) {
+        g11_calc_scarica(cl);
+    }
+    q->op[q->n] = op;
+    q->a[q->n] = a;
+    q->b[q->n] = b;
+    q->futuro[q->n] = f;
+    q->n++;
+}
+
+// Accoda una richiesta il cui risultato sarà disponibile con g11_futuro_attendi.
+static inline void g11_calc_futuro(struct g11_calc *cl, uint8_t op, int32_t a, int32_t b, struct g11_futuro *f) {
+    f->pronto = 0;
+    f->funzione = NULL;
+    f->risposta = NULL;
+    g11_calc_accoda(cl, op, a, b, f);
+}
+
+// Accoda una richiesta: 'funzione' verrà chiamata dal thread di ricezione con stato e risultato
+// (oppure subito con G11_CALC_ERRORE_CONNESSIONE se non c'è alcuna connessione). Ritorna -1 se manca memoria.
+static inline int g11_calc_callback(struct g11_calc *cl, uint8_t op, int32_t a, int32_t b,
+                                    g11_calc_funzione funzione, void *arg) {
+    struct g11_futuro *f = malloc(sizeof(*f));
+    if (f == NULL) {
+        return -1;
+    }
+    f->pronto = 0;
+    f->funzione = funzione;
+    f->arg = arg;
+    f->risposta = NULL;
+    g11_calc_accoda(cl, op, a, b, f);
+    return 0;
+}
+
+// Attende il completamento del futuro (inviando prima le richieste accodate dal thread).
+// Ritorna lo stato e, se non è NULL, scrive il risultato in *risultato.
+static inline int g11_futuro_attendi(struct g11_futuro *f, int32_t *risultato) {
+    if (g11_calc_locale.n > 0) {
+        g11_calc_scarica(g11_calc_locale.cliente);
+    }
+    uint32_t v;
+    while ((v = __atomic_load_n(&f->pronto, __ATOMIC_ACQUIRE)) != 1) {
+        if (v == 0 && !__atomic_compare_exchange_n(&f->pronto, &v, 2, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+        syscall(SYS_futex, &f->pronto, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+    }
+    if (risultato != NULL) {
+        *risultato = f->risultato;
+    }
+    return f->stato;
+}
+
+// Chiamata bloccante: invia la richiesta (insieme a quelle già accodate dal thread) e ne attende la risposta.
+static inline int g11_calc_esegui(struct g11_calc *cl, uint8_t op, int32_t a, int32_t b, int32_t *risultato) {
+    struct g11_futuro f;
+    g11_calc_futuro(cl, op, a, b, &f);
+    return g11_futuro_attendi(&f, risultato);
+}
+
+// Chiamata bloccante per un frame già codificato dal chiamante, ad esempio con operandi tipizzati: la
+// libreria ne assegna l'id (scritto nel frame), lo invia dopo le richieste già accodate dal thread e copia
+// la risposta in 'risposta' (al più 'spazio' byte). Ritorna lo stato della risposta.
+static inline int g11_calc_esegui_frame(struct g11_calc *cl, uint8_t *richiesta, uint8_t *risposta, size_t spazio) {
+    if (g11_calc_locale.n > 0) {
+        g11_calc_scarica(g11_calc_locale.cliente);
+    }
+    struct g11_calc_connessione *c = g11_calc_scegli(cl);
+    if (c == NULL) {
+        return G11_CALC_ERRORE_CONNESSIONE;
+    }
+    struct g11_futuro f = { .risposta = risposta, .spazio = spazio };
+    uint32_t id;
+    g11_calc_registra(c, 1, &f, NULL, 1, &id); // Nulla di non inviato: si può attendere
+    g11_scrivi_u32(richiesta + 8, id);
+    if (g11_calc_invia(c, richiesta, g11_leggi_u32(richiesta)) < 0) {
+        struct g11_calc_attesa t;
+        if (g11_calc_ritira(c, id, &t)) {
+            g11_calc_completa_attesa(&t, G11_CALC_ERRORE_CONNESSIONE);
+        }
+    }
+    return g11_futuro_attendi(&f, NULL);
+}
+
+// Chiude tutte le connessioni: le richieste ancora in volo falliscono con G11_CALC_ERRORE_CONNESSIONE.
+static inline void g11_calc_chiudi(struct g11_calc *cl) {
+    if (g11_calc_locale.cliente == cl) {
+        g11_calc_scarica(cl);
+        g11_calc_locale.cliente = NULL;
+    }
+    __atomic_store_n(&cl->chiusura, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < cl->n; i++) {
+        struct g11_calc_connessione *c = cl->conn[i];
+        pthread_mutex_lock(&c->scrittura);
+        if (c->fd >= 0) shutdown(c->fd, SHUT_RDWR); // Sblocca la read del thread di ricezione
+        pthread_mutex_unlock(&c->scrittura);
+        pthread_join(c->ricevitore, NULL);
+        // Dopo il join solo questo thread tocca la connessione
+        g11_calc_caduta(c);
+        pthread_mutex_destroy(&c->scrittura);
+        pthread_mutex_destroy(&c->tabella);
+        pthread_cond_destroy(&c->spazio);
+        free(c);
+    }
+    free(cl->conn);
+    free(cl);
+}
+
+#endif // LIBCALC_G11_H
@@ -0,0 +1,313 @@
+// Registro asincrono dei server: i thread lavoratori non scrivono mai su stdio.
+//
+// Ogni thread che registra un messaggio ottiene un proprio anello (un solo produttore, un solo consumatore):
+// il messaggio viene formattato direttamente in una voce dell'anello e pubblicato con una scrittura
+// "release", senza lock. Un thread di scarico raccoglie periodicamente le voci di tutti gli anelli e le
+// scrive a blocchi sul file di log o su stderr. Se un anello è pieno il messaggio viene scartato e contato:
+// il percorso delle richieste non attende mai il disco.
+//
+// Ogni punto di chiamata ha anche un limite di G11_LOG_RAFFICA messaggi al secondo per thread: un client
+// che genera errori in continuazione non può riempire il log; i messaggi soppressi vengono riportati
+// nel primo messaggio successivo dello stesso punto.
+//
+// Righe prodotte (formato chiave=valore):
+//   ts=2025-01-31T10:00:00.123456Z livello=avviso server=tcp thread=2 msg="read fallita su fd 12: ..."
+#ifndef LOG_G11_H
+#define LOG_G11_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define G11_LOG_VOCI 256           // Voci dell'anello di ogni thread (potenza di 2)
+#define G11_LOG_TESTO 232          // Lunghezza massima di un messaggio
+#define G11_LOG_RAFFICA 20         // Messaggi al secondo per punto di chiamata e per thread
+#define G11_LOG_PAUSA_NS 10000000  // Intervallo di scarico del thread di log (10 ms)
+
+enum { G11_LOG_DEBUG, G11_LOG_INFO, G11_LOG_AVVISO, G11_LOG_ERRORE, G11_LOG_LIVELLI };
+
+static const char *const g11_log_nomi[G11_LOG_LIVELLI] = { "debug", "info", "avviso", "errore" };
+
+struct g11_log_voce {
+    uint64_t ts_ns;      // CLOCK_REALTIME al momento della chiamata
+    uint32_t livello;
+    uint32_t lunghezza;
+    char testo[G11_LOG_TESTO];
+};
+
+struct g11_log_anello {
+    _Alignas(64) uint64_t testa;   // Scritta solo dal produttore
+    _Alignas(64) uint64_t coda;    // Scritta solo dal consumatore
+    _Alignas(64) uint64_t persi;   // Messaggi scartati ad anello pieno (scritti dal produttore)
+    uint64_t persi_riportati;      // Letti dal consumatore
+    int thread;
+    struct g11_log_anello *prossimo;
+    struct g11_log_voce voci[G11_LOG_VOCI];
+};
+
+// Limite di frequenza di un punto di chiamata (una istanza per thread)
+struct g11_log_limite {
+    uint64_t secondo;
+    uint32_t emessi;
+    uint32_t soppressi;
+};
+
+static int g11_log_soglia = G11_LOG_INFO;             // I messaggi sotto questo livello sono ignorati
+static int g11_log_fd = 2;                            // Destinazione: stderr finché non si apre un file
+static const char *g11_log_server = "";
+static int g11_log_attivo;                            // Thread di scarico avviato
+static struct g11_log_anello *g11_log_anelli;         // Elenco di tutti gli anelli, solo inserimenti
+static int g11_log_thread_creati;
+static pthread_mutex_t g11_log_scarico = PTHREAD_MUTEX_INITIALIZER; // Un solo consumatore alla volta
+static _Thread_local struct g11_log_anello *g11_log_mio;
+
+// Registra un messaggio con il limite di frequenza del punto di chiamata.
+#define G11_LOG(livello, ...)                                                  \
+    do {                                                                       \
+        if ((livello) >= __atomic_load_n(&g11_log_soglia, __ATOMIC_RELAXED)) { \
+            static _Thread_local struct g11_log_limite g11_limite_;            \
+            g11_log_scrivi(&g11_limite_, (livello), __VA_ARGS__);              \
+        }                                                                      \
+    } while (0)
+
+#define G11_LOG_DEBUG(...) G11_LOG(G11_LOG_DEBUG, __VA_ARGS__)
+#define G11_LOG_INFO(...) G11_LOG(G11_LOG_INFO, __VA_ARGS__)
+#define G11_LOG_AVVISO(...) G11_LOG(G11_LOG_AVVISO, __VA_ARGS__)
+#define G11_LOG_ERRORE(...) G11_LOG(G11_LOG_ERRORE, __VA_ARGS__)
+
+// Livello corrispondente a un nome ("debug", "info", "avviso", "errore"), -1 se sconosciuto
+static inline int g11_log_livello(const char *nome) {
+    for (int i = 0; i < G11_LOG_LIVELLI; i++) {
+        if (strcmp(nome, g11_log_nomi[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Cambia il livello minimo mentre i thread registrano (ricarica della configurazione)
+static inline void g11_log_imposta_livello(int livello) {
+    __atomic_store_n(&g11_log_soglia, livello, __ATOMIC_RELAXED);
+}
+
+// Anello del thread chiamante, creato al primo messaggio e aggiunto all'elenco senza lock.
+static inline struct g11_log_anello *g11_log_anello_thread(void) {
+    if (g11_log_mio == NULL) {
+        struct g11_log_anello *a = aligned_alloc(64, sizeof(*a));
+        if (a == NULL) {
+            return NULL;
+        }
+        memset(a, 0, offsetof(struct g11_log_anello, voci));
+        a->thread = __atomic_fetch_add(&g11_log_thread_creati, 1, __ATOMIC_RELAXED);
+        a->prossimo = __atomic_load_n(&g11_log_anelli, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&g11_log_anelli, &a->prossimo, a, 1,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        }
+        g11_log_mio = a;
+    }
+    return g11_log_mio;
+}
+
+// Copia 's' in 'out' mettendo in forma di escape '"', '\\' e i caratteri di controllo: un messaggio con
+// testo arrivato dai client o un percorso resta una sola riga con msg="..." ben delimitato. Una sequenza
+// che non entra in 'dim' - 1 byte tronca il testo. Ritorna la lunghezza scritta.
+static inline size_t g11_log_escape(char *out, size_t dim, const char *s, size_t n) {
+    static const char esadecimali[] = "0123456789abcdef";
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char) s[i];
+        char e[4];
+        size_t m = 0;
+        if (c == '"' || c == '\\') {
+            e[m++] = '\\';
+            e[m++] = (char) c;
+        } else if (c == '\n' || c == '\r' || c == '\t') {
+            e[m++] = '\\';
+            e[m++] = c == '\n' ? 'n' : c == '\r' ? 'r' : 't';
+        } else if (c < 0x20 || c == 0x7f) {
+            e[m++] = '\\';
+            e[m++] = 'x';
+            e[m++] = esadecimali[c >> 4];
+            e[m++] = esadecimali[c & 0xf];
+        } else {
+            e[m++] = (char) c;
+        }
+        if (k + m >= dim) {
+            break;
+        }
+        memcpy(out + k, e, m);
+        k += m;
+    }
+    out[k] = '\0';
+    return k;
+}
+
+__attribute__((format(printf, 3, 4)))
+static inline void g11_log_scrivi(struct g11_log_limite *lim, int livello, const char *fmt, ...) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    if ((uint64_t) ts.tv_sec != lim->secondo) {
+        lim->secondo = (uint64_t) ts.tv_sec;
+        lim->emessi = 0;
+    }
+    if (lim->emessi >= G11_LOG_RAFFICA) {
+        lim->soppressi++;
+        return;
+    }
+    lim->emessi++;
+
+    if (!g11_log_attivo) {
+        // Thread di scarico non avviato (es. errori durante l'avvio): scrittura diretta
+        va_list ap;
+        va_start(ap, fmt);
+        fprintf(stderr, "%s: ", g11_log_nomi[livello]);
+        vfprintf(stderr, fmt, ap);
+        fputc('\n', stderr);
+        va_end(ap);
+        return;
+    }
+
+    struct g11_log_anello *a = g11_log_anello_thread();
+    if (a == NULL) {
+        return;
+    }
+    uint64_t testa = a->testa;
+    if (testa - __atomic_load_n(&a->coda, __ATOMIC_ACQUIRE) >= G11_LOG_VOCI) {
+        __atomic_store_n(&a->persi, a->persi + 1, __ATOMIC_RELAXED); // Anello pieno: il messaggio si perde
+        return;
+    }
+
+    struct g11_log_voce *v = &a->voci[testa & (G11_LOG_VOCI - 1)];
+    char testo[G11_LOG_TESTO];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(testo, sizeof(testo), fmt, ap);
+    va_end(ap);
+    if (n < 0) n = 0;
+    if ((size_t) n >= sizeof(testo)) n = sizeof(testo) - 1;
+    if (lim->soppressi > 0) {
+        int m = snprintf(testo + n, sizeof(testo) - (size_t) n, " (altri %u soppressi)", lim->soppressi);
+        n = m < 0 || (size_t) (n + m) >= sizeof(testo) ? (int) sizeof(testo) - 1 : n + m;
+        lim->soppressi = 0;
+    }
+    v->lunghezza = (uint32_t) g11_log_escape(v->testo, sizeof(v->testo), testo, (size_t) n);
+    v->livello = (uint32_t) livello;
+    v->ts_ns = (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+    __atomic_store_n(&a->testa, testa + 1, __ATOMIC_RELEASE); // Pubblica la voce al consumatore
+}
+
+// Scrive tutto il blocco, ripetendo in caso di scritture parziali
+static inline void g11_log_scrivi_blocco(const char *buf, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(g11_log_fd, buf, n);
+        if (w <= 0) {
+            return; // Log non scrivibile: non si blocca il server
+        }
+        buf += w;
+        n -= (size_t) w;
+    }
+}
+
+// Formatta una riga nel blocco di uscita
+static inline size_t g11_log_riga(char *out, size_t dim, uint64_t ts_ns, int livello, int thread,
+                                  const char *testo, size_t lunghezza) {
+    time_t sec = (time_t) (ts_ns / 1000000000ULL);
+    struct tm tm;
+    char data[32];
+    gmtime_r(&sec, &tm);
+    strftime(data, sizeof(data), "%Y-%m-%dT%H:%M:%S", &tm);
+    int n = snprintf(out, dim, "ts=%s.%06uZ livello=%s server=%s thread=%d msg=\"%.*s\"\n",
+                     data, (unsigned) (ts_ns % 1000000000ULL / 1000), g11_log_nomi[livello],
+                     g11_log_server, thread, (int) lunghezza, testo);
+    return n < 0 ? 0 : (size_t) n < dim ? (size_t) n : dim - 1;
+}
+
+// Svuota tutti gli anelli. Ritorna il numero di voci scritte.
+static inline size_t g11_log_svuota(void) {
+    static char blocco[1 << 16];
+    size_t usati = 0, scritte = 0;
+
+    pthread_mutex_lock(&g11_log_scarico);
+    for (struct g11_log_anello *a = __atomic_load_n(&g11_log_anelli, __ATOMIC_ACQUIRE); a != NULL; a = a->prossimo) {
+        uint64_t coda = a->coda;
+        uint64_t testa = __atomic_load_n(&a->testa, __ATOMIC_ACQUIRE);
+        for (; coda != testa; coda++) {
+            if (sizeof(blocco) - usati < G11_LOG_TESTO + 128) {
+                g11_log_scrivi_blocco(blocco, usati);
+                usati = 0;
+            }
+            struct g11_log_voce *v = &a->voci[coda & (G11_LOG_VOCI - 1)];
+            usati += g11_log_riga(blocco + usati, sizeof(blocco) - usati, v->ts_ns, (int) v->livello,
+                                  a->thread, v->testo, v->lunghezza);
+            scritte++;
+        }
+        __atomic_store_n(&a->coda, coda, __ATOMIC_RELEASE); // Le voci lette tornano al produttore
+
+        uint64_t persi = __atomic_load_n(&a->persi, __ATOMIC_RELAXED);
+        if (persi != a->persi_riportati) {
+            char testo[64];
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            int n = snprintf(testo, sizeof(testo), "%llu messaggi persi ad anello pieno",
+                             (unsigned long long) (persi - a->persi_riportati));
+            if (sizeof(blocco) - usati < G11_LOG_TESTO + 128) {
+                g11_log_scrivi_blocco(blocco, usati);
+                usati = 0;
+            }
+            usati += g11_log_riga(blocco + usati, sizeof(blocco) - usati,
+                                  (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec,
+                                  G11_LOG_AVVISO, a->thread, testo, (size_t) n);
+            a->persi_riportati = persi;
+        }
+    }
+    g11_log_scrivi_blocco(blocco, usati);
+    pthread_mutex_unlock(&g11_log_scarico);
+    return scritte;
+}
+
+static void *g11_log_thread(void *arg) {
+    (void) arg;
+    struct timespec pausa = { 0, G11_LOG_PAUSA_NS };
+    for (;;) {
+        if (g11_log_svuota() == 0) {
+            nanosleep(&pausa, NULL); // Nessun messaggio: si ricontrolla al prossimo intervallo
+        }
+    }
+    return NULL;
+}
+
+static void g11_log_alla_chiusura(void) {
+    g11_log_svuota(); // exit() (es. errore fatale) non perde i messaggi già registrati
+}
+
+// Avvia il thread di scarico. 'percorso' NULL scrive su stderr, altrimenti il file viene aperto in append.
+// Ritorna 0, oppure -1 se il file non può essere aperto o il thread non parte.
+static inline int g11_log_avvia(const char *percorso, int livello, const char *server) {
+    pthread_t t;
+    __atomic_store_n(&g11_log_soglia, livello, __ATOMIC_RELAXED);
+    g11_log_server = server;
+    if (percorso != NULL) {
+        int fd = open(percorso, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return -1;
+        }
+        g11_log_fd = fd;
+    }
+    if (pthread_create(&t, NULL, g11_log_thread, NULL) != 0) {
+        return -1;
+    }
+    pthread_detach(t);
+    atexit(g11_log_alla_chiusura);
+    g11_log_attivo = 1;
+    return 0;
+}
+
+#endif // LOG_G11_H
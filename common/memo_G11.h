@@ -0,0 +1,294 @@
+// Cache dei risultati dei server (memoizzazione, opzione -M): una richiesta già vista viene servita
+// copiando la risposta memorizzata, senza rifare il calcolo.
+//
+// La cache è divisa in una partizione per lavoratore, usata solo dal thread che la possiede: la ricerca
+// non prende lock né usa istruzioni atomiche. Ogni partizione è una tabella a indirizzamento aperto di
+// voci da 64 byte allineate alla linea di cache; una chiave può stare solo nelle G11_MEMO_SONDE voci
+// consecutive che seguono la sua impronta, quindi ricerca e inserimento toccano al più poche linee.
+// Quando le sonde sono tutte occupate si sostituisce la voce usata meno di recente.
+//
+// La chiave è la richiesta senza lunghezza e id (codice, opzioni e corpo), il valore è la risposta senza
+// lunghezza e id (stato, opzioni e corpo): a ogni riuso l'intestazione viene ricostruita con l'id della
+// nuova richiesta. Chiave e valore stanno dentro la voce se sono piccoli, altrimenti in un blocco
+// esterno. I blocchi esterni vengono da lastre della partizione divise per classe di dimensione (potenze
+// di 2 da 64 byte a G11_MEMO_MAX_VOCE): una voce sostituita rende il blocco alla sua classe e nessuna
+// malloc o free avviene sul percorso delle richieste. Nel limite di memoria della partizione si contano le
+// lastre intere, prima di allocarle, perché non vengono restituite né passate ad altre classi.
+#ifndef MEMO_G11_H
+#define MEMO_G11_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "protocollo_G11.h"
+#include "calcolo_G11.h"
+#include "pool_G11.h"
+
+#define G11_MEMO_SONDE 4            // Voci consecutive in cui può trovarsi una chiave
+#define G11_MEMO_INTERNI 36         // Byte di chiave e risultato conservati dentro la voce
+#define G11_MEMO_MAX_VOCE 65536     // Chiave + risultato oltre i quali la risposta non viene memorizzata
+#define G11_MEMO_MIN_VOCI 64        // Voci minime di una partizione
+#define G11_MEMO_MIN_ORDINE 6       // Classe più piccola dei blocchi esterni: 64 byte
+#define G11_MEMO_CLASSI 11          // Classi dei blocchi esterni, fino a 64 KB (G11_MEMO_MAX_VOCE)
+#define G11_MEMO_LASTRA 65536       // Byte di una lastra di blocchi esterni: un blocco della classe più grande
+
+_Static_assert(1u << (G11_MEMO_MIN_ORDINE + G11_MEMO_CLASSI - 1) == G11_MEMO_MAX_VOCE,
+               "la classe più grande deve contenere la voce più grande");
+
+// Politiche di ammissione (opzione -A)
+enum { G11_MEMO_TUTTI, G11_MEMO_COSTOSI, G11_MEMO_RIPETUTI };
+
+// Esito della consultazione della cache per una richiesta
+enum { G11_MEMO_SPENTA, G11_MEMO_TROVATA, G11_MEMO_MANCATA };
+
+struct g11_memo_voce {
+    _Alignas(64) uint64_t impronta;  // Impronta della chiave, 0 se la voce è libera
+    uint8_t *esterni;                // Chiave e valore fuori dalla voce, NULL se stanno in interni
+    uint32_t scadenza;               // Secondo (orologio monotono) oltre il quale la voce non vale più
+    uint32_t uso;                    // Ultimo accesso, per scegliere la voce da sostituire
+    uint16_t dim_chiave;             // Byte della chiave
+    uint16_t dim_valore;             // Byte del valore
+    uint8_t interni[G11_MEMO_INTERNI];
+};
+
+_Static_assert(sizeof(struct g11_memo_voce) == 64, "la voce della cache deve occupare una linea");
+
+// Partizione della cache di un lavoratore
+struct g11_memo {
+    struct g11_memo_voce *voci;      // NULL = cache disattivata
+    uint32_t maschera;               // Numero di voci - 1 (potenza di 2)
+    uint32_t orologio;               // Contatore degli accessi
+    uint32_t ttl;                    // Secondi di validità di una voce, 0 = nessuna scadenza
+    int ammissione;                  // Politica di ammissione
+    size_t esterni, max_esterni;     // Byte delle lastre dei blocchi esterni e limite
+    struct g11_slab blocchi[G11_MEMO_CLASSI]; // Blocchi esterni per classe di dimensione
+    uint8_t *filtro;                 // Politica "ripetuti": bit delle chiavi viste una volta
+    uint32_t filtro_maschera;        // Bit del filtro - 1
+    uint32_t filtro_inserite;        // Chiavi aggiunte al filtro dall'ultimo azzeramento
+};
+
+// Nome della politica di ammissione, o -1 se non esiste.
+static inline int g11_memo_politica(const char *nome) {
+    if (strcmp(nome, "tutti") == 0) return G11_MEMO_TUTTI;
+    if (strcmp(nome, "costosi") == 0) return G11_MEMO_COSTOSI;
+    if (strcmp(nome, "ripetuti") == 0) return G11_MEMO_RIPETUTI;
+    return -1;
+}
+
+// Secondi dell'orologio monotono; la versione "coarse" non passa dal contatore hardware.
+static inline uint32_t g11_memo_adesso(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint32_t) ts.tv_sec;
+}
+
+// Crea una partizione che occupa al più byte byte. Voci e filtro sono presi con mmap: le pagine vengono
+// assegnate dal kernel solo al primo accesso, fatto dal lavoratore, quindi stanno sul suo nodo NUMA.
+// Ritorna 0, o -1 se manca memoria.
+static inline int g11_memo_crea(struct g11_memo *m, size_t byte, uint32_t ttl, int ammissione) {
+    memset(m, 0, sizeof(*m));
+    // Metà del limite va alla tabella (voce + un byte di filtro), il resto a chiavi e risultati grandi
+    size_t voci = G11_MEMO_MIN_VOCI;
+    while (voci <= UINT32_MAX / 2 && 2 * voci * (sizeof(struct g11_memo_voce) + 1) <= byte / 2) {
+        voci *= 2;
+    }
+    size_t dim = voci * sizeof(struct g11_memo_voce) + voci;
+    void *p = mmap(NULL, dim, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return -1;
+    }
+    m->voci = p;
+    m->filtro = (uint8_t *) p + voci * sizeof(struct g11_memo_voce);
+    m->maschera = (uint32_t) voci - 1;
+    m->filtro_maschera = (uint32_t) (voci * 8) - 1;
+    m->ttl = ttl;
+    m->ammissione = ammissione;
+    m->max_esterni = byte > dim ? byte - dim : 0;
+    for (int k = 0; k < G11_MEMO_CLASSI; k++) {
+        g11_slab_crea(&m->blocchi[k], (size_t) 1 << (G11_MEMO_MIN_ORDINE + k), G11_MEMO_LASTRA);
+    }
+    return 0;
+}
+
+// Classe del blocco esterno più piccolo di almeno n byte (n non supera G11_MEMO_MAX_VOCE).
+static inline int g11_memo_classe(size_t n) {
+    int k = 0;
+    while ((size_t) 1 << (G11_MEMO_MIN_ORDINE + k) < n) {
+        k++;
+    }
+    return k;
+}
+
+// Mescola 8 byte nell'impronta (moltiplicazione per la costante di Fibonacci e ripiegamento).
+static inline uint64_t g11_memo_mescola(uint64_t h, uint64_t v) {
+    h = (h ^ v) * 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 29);
+}
+
+// Impronta della chiave, mai 0 (0 indica una voce libera). Il corpo viene letto 8 byte alla volta.
+static inline uint64_t g11_memo_impronta(const struct g11_frame *req) {
+    uint64_t h = g11_memo_mescola(0x243F6A8885A308D3ULL,
+                                  ((uint64_t) req->codice << 48) | ((uint64_t) req->opzioni << 32) | req->dim_corpo);
+    uint32_t i = 0;
+    for (; i + 8 <= req->dim_corpo; i += 8) {
+        uint64_t v;
+        memcpy(&v, req->corpo + i, 8);
+        h = g11_memo_mescola(h, v);
+    }
+    if (i < req->dim_corpo) {
+        uint64_t v = 0;
+        memcpy(&v, req->corpo + i, req->dim_corpo - i);
+        h = g11_memo_mescola(h, v);
+    }
+    return h != 0 ? h : 1;
+}
+
+// Libera la voce e rende il suo eventuale blocco esterno alla classe da cui viene.
+static inline void g11_memo_libera(struct g11_memo *m, struct g11_memo_voce *v) {
+    if (v->esterni != NULL) {
+        int k = g11_memo_classe((size_t) v->dim_chiave + v->dim_valore);
+        g11_slab_rendi(&m->blocchi[k], v->esterni);
+        v->esterni = NULL;
+    }
+    v->impronta = 0;
+}
+
+// Cerca la richiesta; se c'è una voce valida scrive la risposta in out e ne ritorna i byte, altrimenti 0.
+static inline size_t g11_memo_cerca(struct g11_memo *m, const struct g11_frame *req, uint64_t h, uint8_t *out) {
+    for (uint32_t s = 0; s < G11_MEMO_SONDE; s++) {
+        struct g11_memo_voce *v = &m->voci[(h + s) & m->maschera];
+        if (v->impronta != h || v->dim_chiave != 3 + req->dim_corpo) {
+            continue;
+        }
+        const uint8_t *dati = v->esterni != NULL ? v->esterni : v->interni;
+        if (dati[0] != req->codice || g11_leggi_u16(dati + 1) != req->opzioni ||
+            memcmp(dati + 3, req->corpo, req->dim_corpo) != 0) {
+            continue;
+        }
+        if (m->ttl > 0 && (int32_t) (g11_memo_adesso() - v->scadenza) >= 0) {
+            g11_memo_libera(m, v); // Scaduta: la voce si libera subito
+            return 0;
+        }
+        const uint8_t *valore = dati + v->dim_chiave;
+        size_t dim = G11_DIM_INTESTAZIONE + v->dim_valore - 3;
+        g11_scrivi_u32(out, (uint32_t) dim);
+        out[4] = G11_VERSIONE;
+        memcpy(out + 5, valore, 3);
+        g11_scrivi_u32(out + 8, req->id);
+        memcpy(out + G11_DIM_INTESTAZIONE, valore + 3, v->dim_valore - 3);
+        v->uso = ++m->orologio;
+        return dim;
+    }
+    return 0;
+}
+
+// Costose sono le richieste che valgono la copia: lotti, espressioni e interi grandi. Un'operazione
+// scalare costa meno della ricerca stessa.
+static inline int g11_memo_costosa(const struct g11_frame *req) {
+    return req->codice == G11_OP_LOTTO || req->codice == G11_OP_ESPRESSIONE || req->opzioni == G11_TIPO_GRANDE;
+}
+
+// Politica "ripetuti": ammette una chiave solo alla seconda volta che la si vede entro la finestra del
+// filtro (due bit per chiave), che viene azzerato dopo tante chiavi quante sono le voci.
+static inline int g11_memo_vista(struct g11_memo *m, uint64_t h) {
+    uint32_t b1 = (uint32_t) h & m->filtro_maschera;
+    uint32_t b2 = (uint32_t) (h >> 32) & m->filtro_maschera;
+    if ((m->filtro[b1 >> 3] >> (b1 & 7) & 1) && (m->filtro[b2 >> 3] >> (b2 & 7) & 1)) {
+        return 1;
+    }
+    if (++m->filtro_inserite > m->maschera) {
+        memset(m->filtro, 0, (m->filtro_maschera + 1) / 8);
+        m->filtro_inserite = 1;
+    }
+    m->filtro[b1 >> 3] |= (uint8_t) (1u << (b1 & 7));
+    m->filtro[b2 >> 3] |= (uint8_t) (1u << (b2 & 7));
+    return 0;
+}
+
+// Memorizza la risposta appena calcolata, se la politica la ammette.
+static inline void g11_memo_inserisci(struct g11_memo *m, const struct g11_frame *req, uint64_t h,
+                                      const uint8_t *risposta, size_t dim) {
+    // 1. Solo risultati: gli errori di formato o versione costano già poco
+    uint8_t stato = risposta[5];
+    if (stato != G11_STATO_OK && stato != G11_STATO_DIV_ZERO && stato != G11_STATO_OVERFLOW) {
+        return;
+    }
+    size_t dim_chiave = 3 + (size_t) req->dim_corpo;
+    size_t dim_valore = 3 + dim - G11_DIM_INTESTAZIONE;
+    size_t totale = dim_chiave + dim_valore;
+    if (totale > G11_MEMO_MAX_VOCE) {
+        return;
+    }
+
+    // 2. Politica di ammissione
+    if (m->ammissione == G11_MEMO_COSTOSI && !g11_memo_costosa(req)) {
+        return;
+    }
+    if (m->ammissione == G11_MEMO_RIPETUTI && !g11_memo_vista(m, h)) {
+        return;
+    }
+
+    // 3. Scelta della voce: libera o scaduta, altrimenti quella usata meno di recente
+    uint32_t adesso = m->ttl > 0 ? g11_memo_adesso() : 0;
+    struct g11_memo_voce *vittima = NULL;
+    for (uint32_t s = 0; s < G11_MEMO_SONDE; s++) {
+        struct g11_memo_voce *v = &m->voci[(h + s) & m->maschera];
+        if (v->impronta == 0 || (m->ttl > 0 && (int32_t) (adesso - v->scadenza) >= 0)) {
+            vittima = v;
+            break;
+        }
+        if (vittima == NULL || (int32_t) (v->uso - vittima->uso) < 0) {
+            vittima = v;
+        }
+    }
+    g11_memo_libera(m, vittima);
+
+    // 4. Copia di chiave e valore, fuori dalla voce se non ci stanno
+    uint8_t *dati = vittima->interni;
+    if (totale > G11_MEMO_INTERNI) {
+        struct g11_slab *b = &m->blocchi[g11_memo_classe(totale)];
+        size_t lastra = g11_slab_esaurito(b) ? b->lastra : 0;
+        if (m->esterni + lastra > m->max_esterni || (dati = g11_slab_prendi(b)) == NULL) {
+            return; // Limite di memoria raggiunto: la voce resta libera
+        }
+        vittima->esterni = dati;
+        m->esterni += lastra;
+    }
+    dati[0] = req->codice;
+    g11_scrivi_u16(dati + 1, req->opzioni);
+    memcpy(dati + 3, req->corpo, req->dim_corpo);
+    memcpy(dati + dim_chiave, risposta + 5, 3);
+    memcpy(dati + dim_chiave + 3, risposta + G11_DIM_INTESTAZIONE, dim - G11_DIM_INTESTAZIONE);
+    vittima->dim_chiave = (uint16_t) dim_chiave;
+    vittima->dim_valore = (uint16_t) dim_valore;
+    vittima->scadenza = adesso + m->ttl;
+    vittima->uso = ++m->orologio;
+    vittima->impronta = h;
+}
+
+// Come g11_elabora_richiesta, ma consulta prima la cache e vi memorizza il risultato calcolato.
+// In esito riporta se la risposta è stata trovata, calcolata, o se la cache non è stata usata.
+static inline size_t g11_memo_elabora(struct g11_memo *m, const struct g11_frame *req, uint8_t *out,
+                                      size_t spazio, int *esito) {
+    *esito = G11_MEMO_SPENTA;
+    if (m->voci == NULL || req->versione != G11_VERSIONE || 3 + (size_t) req->dim_corpo >= G11_MEMO_MAX_VOCE ||
+        spazio < g11_dim_risposta(req)) {
+        return g11_elabora_richiesta(req, out, spazio);
+    }
+    uint64_t h = g11_memo_impronta(req);
+    size_t dim = g11_memo_cerca(m, req, h, out);
+    if (dim > 0) {
+        *esito = G11_MEMO_TROVATA;
+        return dim;
+    }
+    *esito = G11_MEMO_MANCATA;
+    dim = g11_elabora_richiesta(req, out, spazio);
+    if (dim > 0) {
+        g11_memo_inserisci(m, req, h, out, dim);
+    }
+    return dim;
+}
+
+#endif // MEMO_G11_H
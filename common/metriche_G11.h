@@ -0,0 +1,419 @@
+// Metriche dei server: contatori e istogrammi per thread, esposti in formato testuale Prometheus
+// su una porta locale separata (opzione -m dei server).
+//
+// Ogni lavoratore scrive solo nella propria struttura, allineata alla linea di cache, quindi sul percorso
+// caldo non ci sono lock né istruzioni atomiche con prefisso lock: un incremento è una lettura e una
+// scrittura "relaxed" (un normale add su x86). Il thread delle metriche legge le strutture di tutti i
+// lavoratori e le somma al momento della richiesta.
+//
+// Compilando con -DG11_SENZA_METRICHE tutte le macro G11_METRICA_* diventano vuote e la strumentazione
+// sparisce dal codice generato.
+#ifndef METRICHE_G11_H
+#define METRICHE_G11_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "protocollo_G11.h"
+
+#define G11_METRICHE_INTERVALLI 32  // Intervalli (potenze di 2) degli istogrammi
+
+// Operazioni contate separatamente; l'ultima voce raccoglie i codici sconosciuti
+enum { G11_MET_ADD, G11_MET_SUB, G11_MET_MUL, G11_MET_DIV, G11_MET_LOTTO, G11_MET_ESPR, G11_MET_FLUSSO, G11_MET_ALTRO, G11_MET_OPERAZIONI };
+
+// Fasi di cui si misura la durata
+enum { G11_FASE_LETTURA, G11_FASE_ELABORAZIONE, G11_FASE_SCRITTURA, G11_FASI };
+
+// Motivi per cui una richiesta o una connessione riceve G11_STATO_OCCUPATO senza essere servita
+enum { G11_RIF_CONNESSIONI, G11_RIF_TASSO, G11_RIF_CODA, G11_RIFIUTI };
+
+// Motivi per cui una connessione TCP viene chiusa dal server per scadenza
+enum { G11_SCAD_INATTIVA, G11_SCAD_STALLO, G11_SCADENZE };
+
+// Istogramma a intervalli logaritmici: l'intervallo i contiene i valori v con 2^(i-1) <= v < 2^i
+struct g11_isto_metrica {
+    uint64_t conteggi[G11_METRICHE_INTERVALLI];
+    uint64_t somma;
+};
+
+struct g11_metriche {
+    _Alignas(64) uint64_t connessioni_accettate;
+    uint64_t connessioni_chiuse;
+    uint64_t richieste[G11_MET_OPERAZIONI];     // Richieste per codice operativo
+    uint64_t coppie_lotto;                      // Coppie elaborate nei lotti e nei flussi
+    uint64_t div_zero;                          // Divisioni per zero, anche dentro i lotti
+    uint64_t overflow;                          // Risultati fuori dall'intervallo del tipo, anche nei lotti
+    uint64_t risposte_errore;                   // Risposte con stato di errore (versione, formato, operazione)
+    uint64_t frame_scartati;                    // Frame non delimitabili o datagrammi malformati
+    uint64_t risposte_cache;                    // Risposte riprese dalla cache (UDP, richieste ritrasmesse)
+    uint64_t memo_trovate;                      // Richieste servite dalla cache dei risultati (-M)
+    uint64_t memo_mancate;                      // Richieste cercate nella cache dei risultati e calcolate
+    uint64_t byte_ricevuti;
+    uint64_t byte_inviati;
+    uint64_t allocazioni;                       // malloc e simili dei lavoratori (solo con -DG11_CONTA_ALLOC)
+    uint64_t liberazioni;                       // free dei lavoratori (solo con -DG11_CONTA_ALLOC)
+    uint64_t rifiuti[G11_RIFIUTI];              // Risposte G11_STATO_OCCUPATO per motivo
+    uint64_t scadute[G11_SCADENZE];             // Connessioni chiuse per inattività o stallo
+    struct g11_isto_metrica coda;               // Richieste elaborate per risveglio (profondità della coda)
+    struct g11_isto_metrica fasi[G11_FASI];     // Durata delle fasi in ns
+};
+
+#ifndef G11_SENZA_METRICHE
+
+#define G11_MAX_METRICHE 256
+static struct g11_metriche *g11_registro_metriche[G11_MAX_METRICHE];
+static int g11_n_metriche = 0;
+
+// Alloca e registra le metriche di un lavoratore. Va chiamata prima di avviare il thread delle metriche.
+static inline struct g11_metriche *g11_metriche_nuove(void) {
+    struct g11_metriche *m = aligned_alloc(64, sizeof(*m));
+    if (m == NULL || g11_n_metriche == G11_MAX_METRICHE) {
+        free(m);
+        return NULL;
+    }
+    memset(m, 0, sizeof(*m));
+    g11_registro_metriche[g11_n_metriche++] = m;
+    return m;
+}
+
+// Un solo scrittore per campo: basta una lettura e una scrittura relaxed, senza lock
+static inline void g11_met_somma(uint64_t *p, uint64_t v) {
+    __atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + v, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t g11_met_leggi(const uint64_t *p) {
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static inline void g11_met_registra(struct g11_isto_metrica *h, uint64_t v) {
+    unsigned i = v == 0 ? 0 : 64 - (unsigned) __builtin_clzll(v);
+    g11_met_somma(&h->conteggi[i < G11_METRICHE_INTERVALLI ? i : G11_METRICHE_INTERVALLI - 1], 1);
+    g11_met_somma(&h->somma, v);
+}
+
+static inline uint64_t g11_met_adesso(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+// Conta una richiesta elaborata a partire dalla risposta appena codificata in 'out'
+static inline void g11_met_richiesta(struct g11_metriche *m, const struct g11_frame *req, const uint8_t *out) {
+    int k;
+    switch (req->codice) {
+        case G11_OP_ADDIZIONE:       k = G11_MET_ADD; break;
+        case G11_OP_SOTTRAZIONE:     k = G11_MET_SUB; break;
+        case G11_OP_MOLTIPLICAZIONE: k = G11_MET_MUL; break;
+        case G11_OP_DIVISIONE:       k = G11_MET_DIV; break;
+        case G11_OP_LOTTO:           k = G11_MET_LOTTO; break;
+        case G11_OP_ESPRESSIONE:     k = G11_MET_ESPR; break;
+        case G11_OP_FLUSSO:          k = G11_MET_FLUSSO; break;
+        default:                     k = G11_MET_ALTRO; break;
+    }
+    g11_met_somma(&m->richieste[k], 1);
+    uint8_t stato = out[5];
+    if (stato == G11_STATO_DIV_ZERO) {
+        g11_met_somma(&m->div_zero, 1);
+    } else if (stato == G11_STATO_OVERFLOW) {
+        g11_met_somma(&m->overflow, 1);
+    } else if (stato != G11_STATO_OK) {
+        g11_met_somma(&m->risposte_errore, 1);
+    } else if (k == G11_MET_LOTTO || k == G11_MET_ESPR) {
+        // Lo stato di ogni elemento vale G11_STATO_OK, G11_STATO_DIV_ZERO o G11_STATO_OVERFLOW
+        uint32_t n = g11_leggi_u32(out + G11_DIM_INTESTAZIONE);
+        const uint8_t *stati = out + G11_DIM_INTESTAZIONE + 4 + 4u * n;
+        uint64_t zeri = 0, fuori = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            zeri += stati[i] == G11_STATO_DIV_ZERO;
+            fuori += stati[i] == G11_STATO_OVERFLOW;
+        }
+        if (k == G11_MET_LOTTO) g11_met_somma(&m->coppie_lotto, n);
+        g11_met_somma(&m->div_zero, zeri);
+        g11_met_somma(&m->overflow, fuori);
+    }
+}
+
+// Conta n coppie di un flusso a partire dai loro esiti da G11_DIM_ESITO byte
+static inline void g11_met_esiti(struct g11_metriche *m, const uint8_t *esiti, uint32_t n) {
+    uint64_t zeri = 0, fuori = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        zeri += esiti[G11_DIM_ESITO * i + 4] == G11_STATO_DIV_ZERO;
+        fuori += esiti[G11_DIM_ESITO * i + 4] == G11_STATO_OVERFLOW;
+    }
+    g11_met_somma(&m->coppie_lotto, n);
+    g11_met_somma(&m->div_zero, zeri);
+    g11_met_somma(&m->overflow, fuori);
+}
+
+#define G11_METRICA_CONTA(m, campo, v)      g11_met_somma(&(m)->campo, (uint64_t) (v))
+#define G11_METRICA_VALORE(m, campo, v)     g11_met_registra(&(m)->campo, (uint64_t) (v))
+#define G11_METRICA_RICHIESTA(m, req, out)  g11_met_richiesta((m), (req), (out))
+#define G11_METRICA_ESITI(m, esiti, n)      g11_met_esiti((m), (esiti), (n))
+#define G11_METRICA_INIZIO(t)               uint64_t t = g11_met_adesso()
+#define G11_METRICA_FASE(m, fase, t)        g11_met_registra(&(m)->fasi[fase], g11_met_adesso() - (t))
+
+// --- Esportazione in formato Prometheus ---
+
+static inline void g11_met_isto_somma(struct g11_isto_metrica *tot, const struct g11_isto_metrica *h) {
+    for (int i = 0; i < G11_METRICHE_INTERVALLI; i++) {
+        tot->conteggi[i] += g11_met_leggi(&h->conteggi[i]);
+    }
+    tot->somma += g11_met_leggi(&h->somma);
+}
+
+// Scrive un istogramma Prometheus (intervalli cumulativi). 'scala' converte i valori nell'unità esportata.
+static inline void g11_met_scrivi_isto(FILE *f, const char *nome, const char *etichetta,
+                                       const struct g11_isto_metrica *h, double scala) {
+    uint64_t cumulati = 0;
+    const char *sep = etichetta[0] ? "," : "";
+    for (int i = 0; i < G11_METRICHE_INTERVALLI; i++) {
+        cumulati += h->conteggi[i];
+        fprintf(f, "%s_bucket{%s%sle=\"%g\"} %lu\n", nome, etichetta, sep, (double) (1ULL << i) * scala,
+                (unsigned long) cumulati);
+    }
+    fprintf(f, "%s_bucket{%s%sle=\"+Inf\"} %lu\n", nome, etichetta, sep, (unsigned long) cumulati);
+    const char *aperta = etichetta[0] ? "{" : "", *chiusa = etichetta[0] ? "}" : "";
+    fprintf(f, "%s_sum%s%s%s %g\n", nome, aperta, etichetta, chiusa, (double) h->somma * scala);
+    fprintf(f, "%s_count%s%s%s %lu\n", nome, aperta, etichetta, chiusa, (unsigned long) cumulati);
+}
+
+// Somma le metriche di tutti i lavoratori e le scrive in formato testuale Prometheus.
+static inline void g11_metriche_esporta(FILE *f, const char *server) {
+    struct g11_metriche tot;
+    memset(&tot, 0, sizeof(tot));
+    for (int i = 0; i < g11_n_metriche; i++) {
+        const struct g11_metriche *m = g11_registro_metriche[i];
+        tot.connessioni_accettate += g11_met_leggi(&m->connessioni_accettate);
+        tot.connessioni_chiuse += g11_met_leggi(&m->connessioni_chiuse);
+        for (int k = 0; k < G11_MET_OPERAZIONI; k++) {
+            tot.richieste[k] += g11_met_leggi(&m->richieste[k]);
+        }
+        tot.coppie_lotto += g11_met_leggi(&m->coppie_lotto);
+        tot.div_zero += g11_met_leggi(&m->div_zero);
+        tot.overflow += g11_met_leggi(&m->overflow);
+        tot.risposte_errore += g11_met_leggi(&m->risposte_errore);
+        tot.frame_scartati += g11_met_leggi(&m->frame_scartati);
+        tot.risposte_cache += g11_met_leggi(&m->risposte_cache);
+        tot.memo_trovate += g11_met_leggi(&m->memo_trovate);
+        tot.memo_mancate += g11_met_leggi(&m->memo_mancate);
+        tot.byte_ricevuti += g11_met_leggi(&m->byte_ricevuti);
+        tot.byte_inviati += g11_met_leggi(&m->byte_inviati);
+        tot.allocazioni += g11_met_leggi(&m->allocazioni);
+        tot.liberazioni += g11_met_leggi(&m->liberazioni);
+        for (int k = 0; k < G11_RIFIUTI; k++) {
+            tot.rifiuti[k] += g11_met_leggi(&m->rifiuti[k]);
+        }
+        for (int k = 0; k < G11_SCADENZE; k++) {
+            tot.scadute[k] += g11_met_leggi(&m->scadute[k]);
+        }
+        g11_met_isto_somma(&tot.coda, &m->coda);
+        for (int k = 0; k < G11_FASI; k++) {
+            g11_met_isto_somma(&tot.fasi[k], &m->fasi[k]);
+        }
+    }
+
+    static const char *nomi_op[G11_MET_OPERAZIONI] = { "A", "S", "M", "D", "B", "E", "F", "altro" };
+    static const char *nomi_fasi[G11_FASI] = { "lettura", "elaborazione", "scrittura" };
+    static const char *nomi_rifiuti[G11_RIFIUTI] = { "connessioni", "tasso", "coda" };
+    static const char *nomi_scadenze[G11_SCADENZE] = { "inattiva", "stallo" };
+    char etichetta[64];
+
+    fprintf(f, "# HELP g11_lavoratori Thread lavoratori del server.\n# TYPE g11_lavoratori gauge\n");
+    fprintf(f, "g11_lavoratori{server=\"%s\"} %d\n", server, g11_n_metriche);
+    fprintf(f, "# HELP g11_connessioni_accettate_totale Connessioni TCP accettate.\n# TYPE g11_connessioni_accettate_totale counter\n");
+    fprintf(f, "g11_connessioni_accettate_totale %lu\n", (unsigned long) tot.connessioni_accettate);
+    fprintf(f, "# HELP g11_connessioni_attive Connessioni TCP aperte.\n# TYPE g11_connessioni_attive gauge\n");
+    fprintf(f, "g11_connessioni_attive %ld\n", (long) (tot.connessioni_accettate - tot.connessioni_chiuse));
+    fprintf(f, "# HELP g11_richieste_totale Richieste elaborate per codice operativo.\n# TYPE g11_richieste_totale counter\n");
+    for (int k = 0; k < G11_MET_OPERAZIONI; k++) {
+        fprintf(f, "g11_richieste_totale{op=\"%s\"} %lu\n", nomi_op[k], (unsigned long) tot.richieste[k]);
+    }
+    fprintf(f, "# HELP g11_coppie_lotto_totale Coppie di operandi elaborate nei lotti e nei flussi.\n# TYPE g11_coppie_lotto_totale counter\n");
+    fprintf(f, "g11_coppie_lotto_totale %lu\n", (unsigned long) tot.coppie_lotto);
+    fprintf(f, "# HELP g11_divisioni_per_zero_totale Divisioni per zero, singole o in un lotto.\n# TYPE g11_divisioni_per_zero_totale counter\n");
+    fprintf(f, "g11_divisioni_per_zero_totale %lu\n", (unsigned long) tot.div_zero);
+    fprintf(f, "# HELP g11_overflow_totale Risultati fuori dall'intervallo del tipo, anche nei lotti.\n# TYPE g11_overflow_totale counter\n");
+    fprintf(f, "g11_overflow_totale %lu\n", (unsigned long) tot.overflow);
+    fprintf(f, "# HELP g11_risposte_errore_totale Risposte con stato di errore.\n# TYPE g11_risposte_errore_totale counter\n");
+    fprintf(f, "g11_risposte_errore_totale %lu\n", (unsigned long) tot.risposte_errore);
+    fprintf(f, "# HELP g11_frame_scartati_totale Frame o datagrammi non validi scartati.\n# TYPE g11_frame_scartati_totale counter\n");
+    fprintf(f, "g11_frame_scartati_totale %lu\n", (unsigned long) tot.frame_scartati);
+    fprintf(f, "# HELP g11_risposte_cache_totale Risposte a richieste ritrasmesse riprese dalla cache.\n# TYPE g11_risposte_cache_totale counter\n");
+    fprintf(f, "g11_risposte_cache_totale %lu\n", (unsigned long) tot.risposte_cache);
+    fprintf(f, "# HELP g11_memo_totale Consultazioni della cache dei risultati per esito.\n# TYPE g11_memo_totale counter\n");
+    fprintf(f, "g11_memo_totale{esito=\"trovata\"} %lu\n", (unsigned long) tot.memo_trovate);
+    fprintf(f, "g11_memo_totale{esito=\"mancata\"} %lu\n", (unsigned long) tot.memo_mancate);
+    fprintf(f, "# HELP g11_rifiuti_totale Richieste e connessioni respinte con stato OCCUPATO, per motivo.\n# TYPE g11_rifiuti_totale counter\n");
+    for (int k = 0; k < G11_RIFIUTI; k++) {
+        fprintf(f, "g11_rifiuti_totale{motivo=\"%s\"} %lu\n", nomi_rifiuti[k], (unsigned long) tot.rifiuti[k]);
+    }
+    fprintf(f, "# HELP g11_connessioni_scadute_totale Connessioni TCP chiuse dal server per inattività o stallo.\n# TYPE g11_connessioni_scadute_totale counter\n");
+    for (int k = 0; k < G11_SCADENZE; k++) {
+        fprintf(f, "g11_connessioni_scadute_totale{motivo=\"%s\"} %lu\n", nomi_scadenze[k], (unsigned long) tot.scadute[k]);
+    }
+    fprintf(f, "# HELP g11_byte_ricevuti_totale Byte ricevuti dai client.\n# TYPE g11_byte_ricevuti_totale counter\n");
+    fprintf(f, "g11_byte_ricevuti_totale %lu\n", (unsigned long) tot.byte_ricevuti);
+    fprintf(f, "# HELP g11_byte_inviati_totale Byte inviati ai client.\n# TYPE g11_byte_inviati_totale counter\n");
+    fprintf(f, "g11_byte_inviati_totale %lu\n", (unsigned long) tot.byte_inviati);
+#ifdef G11_CONTA_ALLOC
+    fprintf(f, "# HELP g11_allocazioni_totale Chiamate a malloc e free dei lavoratori.\n# TYPE g11_allocazioni_totale counter\n");
+    fprintf(f, "g11_allocazioni_totale{tipo=\"malloc\"} %lu\n", (unsigned long) tot.allocazioni);
+    fprintf(f, "g11_allocazioni_totale{tipo=\"free\"} %lu\n", (unsigned long) tot.liberazioni);
+#endif
+    fprintf(f, "# HELP g11_profondita_coda Richieste elaborate a ogni risveglio del lavoratore.\n# TYPE g11_profondita_coda histogram\n");
+    g11_met_scrivi_isto(f, "g11_profondita_coda", "", &tot.coda, 1.0);
+    fprintf(f, "# HELP g11_durata_fase_secondi Durata delle fasi di lettura, elaborazione e scrittura.\n# TYPE g11_durata_fase_secondi histogram\n");
+    for (int k = 0; k < G11_FASI; k++) {
+        snprintf(etichetta, sizeof(etichetta), "fase=\"%s\"", nomi_fasi[k]);
+        g11_met_scrivi_isto(f, "g11_durata_fase_secondi", etichetta, &tot.fasi[k], 1e-9);
+    }
+}
+
+// --- Porta delle metriche ---
+
+struct g11_porta_metriche {
+    int sockfd;
+    const char *server;
+    pthread_t thread;
+};
+
+// Risponde a ogni connessione con la pagina delle metriche (HTTP/1.0, qualunque sia il percorso richiesto).
+// Le richieste sono rare e servite una alla volta da questo thread, fuori dal percorso dei lavoratori.
+static inline void *g11_metriche_ciclo(void *arg) {
+    struct g11_porta_metriche *p = arg;
+    for (;;) {
+        int fd = accept(p->sockfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EBADF || errno == EINVAL) {
+                break; // Socket chiuso o non in ascolto: la porta delle metriche non serve più
+            }
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                // Descrittori o memoria esauriti (es. sotto carico di connessioni): si riprova più tardi
+                // invece di ripetere la accept a vuoto
+                struct timespec pausa = { 0, 100000000 };
+                nanosleep(&pausa, NULL);
+            }
+            continue;
+        }
+        struct timeval attesa = { 1, 0 }; // Un client che non invia nulla non blocca il thread
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &attesa, sizeof(attesa));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &attesa, sizeof(attesa));
+        char richiesta[2048];
+        if (read(fd, richiesta, sizeof(richiesta)) <= 0) {
+            close(fd);
+            continue;
+        }
+
+        char *pagina = NULL;
+        size_t dim = 0;
+        FILE *f = open_memstream(&pagina, &dim);
+        if (f != NULL) {
+            g11_metriche_esporta(f, p->server);
+            fclose(f);
+            char intestazione[160];
+            int n = snprintf(intestazione, sizeof(intestazione),
+                             "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                             "Content-Length: %zu\r\nConnection: close\r\n\r\n", dim);
+            if (write(fd, intestazione, (size_t) n) == n) {
+                for (size_t inviati = 0; inviati < dim; ) {
+                    ssize_t k = write(fd, pagina + inviati, dim - inviati);
+                    if (k <= 0) break;
+                    inviati += (size_t) k;
+                }
+            }
+        }
+        free(pagina);
+        close(fd);
+    }
+    return NULL;
+}
+
+static struct g11_porta_metriche g11_porta_metriche = { .sockfd = -1 };
+
+// Apre la porta delle metriche su 127.0.0.1 e avvia il thread che la serve. Con ereditato >= 0 usa quel
+// socket, già in ascolto, ricevuto dal processo precedente. Ritorna -1 in caso di errore.
+static inline int g11_metriche_avvia(int porta, const char *server, int ereditato) {
+    struct g11_porta_metriche *p = &g11_porta_metriche;
+    struct sockaddr_in addr;
+    int uno = 1;
+
+    p->server = server;
+    memset(&addr, 0, sizeof(addr));
+    socklen_t dim = sizeof(addr);
+    if (ereditato >= 0 && (getsockname(ereditato, (struct sockaddr *) &addr, &dim) < 0 || ntohs(addr.sin_port) != porta)) {
+        close(ereditato); // La porta è cambiata con la ricarica: se ne apre una nuova
+        ereditato = -1;
+    }
+    p->sockfd = ereditato >= 0 ? ereditato : socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (p->sockfd < 0) {
+        return -1;
+    }
+    if (ereditato < 0) {
+        setsockopt(p->sockfd, SOL_SOCKET, SO_REUSEADDR, &uno, sizeof(uno));
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // Solo locale: le metriche non sono esposte in rete
+        addr.sin_port = htons(porta);
+        if (bind(p->sockfd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(p->sockfd, 16) < 0) {
+            close(p->sockfd);
+            p->sockfd = -1;
+            return -1;
+        }
+    }
+    if (pthread_create(&p->thread, NULL, g11_metriche_ciclo, p) != 0) {
+        close(p->sockfd);
+        p->sockfd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// Socket della porta delle metriche, da passare al nuovo processo; -1 se la porta non è aperta.
+static inline int g11_metriche_socket(void) {
+    return g11_porta_metriche.sockfd;
+}
+
+#else // G11_SENZA_METRICHE
+
+// Struttura fittizia: le macro non la toccano, serve solo a non dover distinguere i due casi nei server
+static inline struct g11_metriche *g11_metriche_nuove(void) {
+    static struct g11_metriche vuota;
+    return &vuota;
+}
+
+static inline int g11_metriche_avvia(int porta, const char *server, int ereditato) {
+    (void) porta;
+    (void) server;
+    if (ereditato >= 0) {
+        close(ereditato);
+    }
+    fprintf(stderr, "Metriche escluse in compilazione (G11_SENZA_METRICHE)\n");
+    return -1;
+}
+
+static inline int g11_metriche_socket(void) {
+    return -1;
+}
+
+static inline void g11_metriche_esporta(FILE *f, const char *server) {
+    (void) f;
+    (void) server;
+}
+
+#define G11_METRICA_CONTA(m, campo, v)      ((void) (m))
+#define G11_METRICA_VALORE(m, campo, v)     ((void) (m))
+#define G11_METRICA_RICHIESTA(m, req, out)  ((void) (m))
+#define G11_METRICA_ESITI(m, esiti, n)      ((void) (m))
+#define G11_METRICA_INIZIO(t)               ((void) 0)
+#define G11_METRICA_FASE(m, fase, t)        ((void) (m))
+
+#endif // G11_SENZA_METRICHE
+
+#endif // METRICHE_G11_H
@@ -0,0 +1,270 @@
+// Allocatori dei server: nessuna malloc o free sul percorso delle richieste a regime.
+//
+// - g11_arena: area a pila per la memoria di lavoro di una richiesta; si azzera all'inizio della richiesta
+//   successiva invece di liberare i singoli blocchi.
+// - g11_slab: oggetti di dimensione fissa (connessioni, blocchi della cache dei risultati) presi e resi da
+//   una lista libera; le lastre che li contengono vengono allocate quando lista e lastra corrente sono
+//   esaurite e non vengono mai restituite al sistema.
+// - g11_pool_buffer: buffer di I/O in classi di dimensione (potenze di 2 da 32 KB a 16 MB), riusati
+//   da una lista libera per classe; oltre un limite di memoria trattenuta i buffer resi vengono liberati.
+//
+// Ogni struttura appartiene a un lavoratore e viene usata solo dal suo thread: nessun lock. La memoria
+// viene presa con mmap dal lavoratore stesso, già vincolato al suo core, quindi le pagine vengono
+// assegnate al primo accesso sul nodo NUMA di quel core (first touch).
+//
+// Compilando con -DG11_CONTA_ALLOC le funzioni malloc, calloc, realloc, free e simili vengono sostituite
+// da versioni che contano le chiamate fatte dai lavoratori (g11_conta_alloc_in), esposte dalle metriche.
+#ifndef POOL_G11_H
+#define POOL_G11_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define G11_ARENA_MIN (1u << 16)    // Dimensione minima di un'arena
+#define G11_BUFFER_MIN_ORDINE 15    // Classe più piccola: 32 KB
+#define G11_BUFFER_CLASSI 10        // Classi fino a 16 MB, abbastanza per G11_MAX_FRAME
+#define G11_SLAB_LASTRA (1u << 21)  // Byte predefiniti di una lastra di oggetti
+
+// Memoria anonima privata; con popola le pagine vengono toccate subito dal thread chiamante.
+static inline void *g11_mappa(size_t dim, int popola) {
+    void *p = mmap(NULL, dim, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | (popola ? MAP_POPULATE : 0), -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+// --- Arena per richiesta ---
+
+struct g11_arena {
+    uint8_t *memoria;
+    size_t dim;                     // Byte disponibili
+    size_t usati;
+};
+
+// Prepara l'arena per una richiesta che userà al più 'dim' byte: tutto ciò che era stato preso prima viene
+// rilasciato. Cresce solo quando arriva una richiesta più grande di tutte le precedenti. Ritorna -1 se
+// la memoria non basta.
+static inline int g11_arena_prepara(struct g11_arena *a, size_t dim) {
+    a->usati = 0;
+    if (dim <= a->dim) {
+        return 0;
+    }
+    size_t nuova = a->dim ? a->dim : G11_ARENA_MIN;
+    while (nuova < dim) {
+        nuova *= 2;
+    }
+    uint8_t *m = g11_mappa(nuova, 0);
+    if (m == NULL) {
+        return -1;
+    }
+    if (a->memoria != NULL) {
+        munmap(a->memoria, a->dim);
+    }
+    a->memoria = m;
+    a->dim = nuova;
+    return 0;
+}
+
+// Prende n byte dall'arena, subito dopo i precedenti (chi prende multipli di 4 resta allineato a 4);
+// lo spazio è stato garantito da g11_arena_prepara.
+static inline void *g11_arena_prendi(struct g11_arena *a, size_t n) {
+    void *p = a->memoria + a->usati;
+    a->usati += n;
+    return p;
+}
+
+// --- Lastre di oggetti di dimensione fissa ---
+
+struct g11_slab {
+    size_t dim;                     // Byte di un oggetto, multiplo della linea di cache
+    size_t lastra;                  // Byte di una lastra (almeno un oggetto)
+    void *liberi;                   // Lista degli oggetti resi: i primi byte puntano al successivo
+    uint8_t *nuovi;                 // Primo oggetto mai preso della lastra corrente
+    size_t restanti;                // Oggetti mai presi della lastra corrente
+    size_t lastre;                  // Lastre allocate
+    size_t presi;                   // Oggetti in uso
+};
+
+// Oggetti di 'dim' byte in lastre di circa 'lastra' byte.
+static inline void g11_slab_crea(struct g11_slab *s, size_t dim, size_t lastra) {
+    memset(s, 0, sizeof(*s));
+    s->dim = (dim + 63) & ~(size_t) 63;
+    s->lastra = lastra > s->dim ? lastra / s->dim * s->dim : s->dim;
+}
+
+// Il prossimo g11_slab_prendi dovrà allocare una nuova lastra di s->lastra byte.
+static inline int g11_slab_esaurito(const struct g11_slab *s) {
+    return s->liberi == NULL && s->restanti == 0;
+}
+
+// Prende un oggetto (non azzerato); NULL se manca memoria.
+static inline void *g11_slab_prendi(struct g11_slab *s) {
+    void *o = s->liberi;
+    if (o != NULL) {
+        memcpy(&s->liberi, o, sizeof(void *));
+        s->presi++;
+        return o;
+    }
+    if (s->restanti == 0) {
+        // Le pagine di una nuova lastra non vengono toccate qui: gli oggetti vengono ritagliati uno alla
+        // volta, quindi una pagina occupa memoria solo quando un oggetto che contiene viene usato.
+        uint8_t *lastra = g11_mappa(s->lastra, 0);
+        if (lastra == NULL) {
+            return NULL;
+        }
+        s->nuovi = lastra;
+        s->restanti = s->lastra / s->dim;
+        s->lastre++;
+    }
+    o = s->nuovi;
+    s->nuovi += s->dim;
+    s->restanti--;
+    s->presi++;
+    return o;
+}
+
+static inline void g11_slab_rendi(struct g11_slab *s, void *o) {
+    memcpy(o, &s->liberi, sizeof(void *));
+    s->liberi = o;
+    s->presi--;
+}
+
+// --- Buffer di I/O per classi di dimensione ---
+
+struct g11_pool_buffer {
+    void *liberi[G11_BUFFER_CLASSI];    // Liste dei buffer liberi per classe
+    size_t trattenuti;                  // Byte nei buffer liberi
+    size_t max_trattenuti;              // Oltre questo limite i buffer resi vengono liberati
+};
+
+static inline void g11_pool_buffer_crea(struct g11_pool_buffer *p, size_t max_trattenuti) {
+    memset(p, 0, sizeof(*p));
+    p->max_trattenuti = max_trattenuti;
+}
+
+// Classe del buffer più piccolo di almeno dim byte, -1 se dim supera la classe più grande.
+static inline int g11_buffer_classe(size_t dim) {
+    for (int k = 0; k < G11_BUFFER_CLASSI; k++) {
+        if (dim <= (size_t) 1 << (G11_BUFFER_MIN_ORDINE + k)) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+// Prende un buffer di almeno dim byte; in *capacita la sua dimensione effettiva. NULL se manca memoria.
+static inline void *g11_buffer_prendi(struct g11_pool_buffer *p, size_t dim, size_t *capacita) {
+    int k = g11_buffer_classe(dim);
+    if (k < 0) {
+        return NULL;
+    }
+    size_t cap = (size_t) 1 << (G11_BUFFER_MIN_ORDINE + k);
+    void *b = p->liberi[k];
+    if (b != NULL) {
+        memcpy(&p->liberi[k], b, sizeof(void *));
+        p->trattenuti -= cap;
+    } else if ((b = g11_mappa(cap, 0)) == NULL) {
+        return NULL;
+    }
+    *capacita = cap;
+    return b;
+}
+
+// Rende un buffer preso con g11_buffer_prendi, con la capacità ricevuta allora.
+static inline void g11_buffer_rendi(struct g11_pool_buffer *p, void *b, size_t capacita) {
+    int k = g11_buffer_classe(capacita);
+    if (p->trattenuti + capacita > p->max_trattenuti) {
+        munmap(b, capacita);
+        return;
+    }
+    memcpy(b, &p->liberi[k], sizeof(void *));
+    p->liberi[k] = b;
+    p->trattenuti += capacita;
+}
+
+// Prealloca n buffer di ogni classe fino a dim byte, con le pagine già toccate dal thread chiamante.
+// Ritorna -1 se manca memoria.
+static inline int g11_buffer_prealloca(struct g11_pool_buffer *p, size_t dim, int n) {
+    for (int k = 0; k < G11_BUFFER_CLASSI && (size_t) 1 << (G11_BUFFER_MIN_ORDINE + k) <= dim; k++) {
+        size_t cap = (size_t) 1 << (G11_BUFFER_MIN_ORDINE + k);
+        for (int i = 0; i < n; i++) {
+            void *b = g11_mappa(cap, 1);
+            if (b == NULL) {
+                return -1;
+            }
+            memcpy(b, &p->liberi[k], sizeof(void *));
+            p->liberi[k] = b;
+            p->trattenuti += cap;
+        }
+    }
+    return 0;
+}
+
+// --- Conteggio delle allocazioni (-DG11_CONTA_ALLOC) ---
+
+#ifdef G11_CONTA_ALLOC
+
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void *__libc_memalign(size_t, size_t);
+extern void __libc_free(void *);
+
+// Contatori del thread corrente; NULL nei thread che non vengono contati
+static _Thread_local uint64_t *g11_conta_allocazioni, *g11_conta_liberazioni;
+
+// Da qui in avanti le allocazioni del thread corrente vengono sommate ai due contatori.
+static inline void g11_conta_alloc_in(uint64_t *allocazioni, uint64_t *liberazioni) {
+    g11_conta_allocazioni = allocazioni;
+    g11_conta_liberazioni = liberazioni;
+}
+
+static inline void g11_conta(uint64_t *c) {
+    if (c != NULL) {
+        __atomic_store_n(c, __atomic_load_n(c, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED); // Letto dal thread delle metriche
+    }
+}
+
+void *malloc(size_t n) {
+    g11_conta(g11_conta_allocazioni);
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t dim) {
+    g11_conta(g11_conta_allocazioni);
+    return __libc_calloc(n, dim);
+}
+
+void *realloc(void *p, size_t n) {
+    g11_conta(g11_conta_allocazioni);
+    return __libc_realloc(p, n);
+}
+
+void *aligned_alloc(size_t allineamento, size_t n) {
+    g11_conta(g11_conta_allocazioni);
+    return __libc_memalign(allineamento, n);
+}
+
+int posix_memalign(void **p, size_t allineamento, size_t n) {
+    g11_conta(g11_conta_allocazioni);
+    *p = __libc_memalign(allineamento, n);
+    return *p == NULL ? ENOMEM : 0;
+}
+
+void free(void *p) {
+    if (p != NULL) {
+        g11_conta(g11_conta_liberazioni);
+    }
+    __libc_free(p);
+}
+
+#define G11_CONTA_ALLOC_IN(allocazioni, liberazioni) g11_conta_alloc_in((allocazioni), (liberazioni))
+
+#else
+
+#define G11_CONTA_ALLOC_IN(allocazioni, liberazioni) ((void) 0)
+
+#endif // G11_CONTA_ALLOC
+
+#endif // POOL_G11_H
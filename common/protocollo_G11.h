@@ -0,0 +1,365 @@
+// Protocollo binario condiviso dai quattro programmi (client e server, TCP e UDP).
+//
+// Ogni messaggio è un frame con prefisso di lunghezza, tutti i campi in network byte order:
+//
+//   richiesta (20 byte)                      risposta (16 byte)
+//   0  uint32 lunghezza totale del frame     0  uint32 lunghezza totale del frame
+//   4  uint8  versione (G11_VERSIONE)        4  uint8  versione
+//   5  uint8  codice operativo (A, S, M, D)  5  uint8  stato (G11_STATO_*)
+//   6  uint16 opzioni (tipo, 0 = int32)      6  uint16 opzioni (tipo della richiesta)
+//   8  uint32 id della richiesta             8  uint32 id della richiesta
+//   12 int32  primo operando                 12 int32  risultato
+//   16 int32  secondo operando
+//
+// I primi 12 byte (intestazione) sono comuni a tutti i frame: la lunghezza permette di delimitare
+// i messaggi su TCP anche quando arrivano spezzati o accodati, e di trasportare frame più lunghi.
+//
+// Operazione a lotti (codice G11_OP_LOTTO): la stessa operazione applicata a n coppie di operandi.
+//
+//   richiesta (20 + 8n byte)                 risposta (16 + 4n + n arrotondato a 4 byte)
+//   12 uint8  operazione (A, S, M, D)        12 uint32 n
+//   13 3 byte riservati                      16 int32  risultati[n]
+//   16 uint32 n                              .. uint8  stati[n] (G11_STATO_* di ogni elemento),
+//   20 int32  a[n]                              completati con zeri fino a un multiplo di 4
+//   .. int32  b[n]
+//
+// I vettori sono contigui (prima tutti i primi operandi, poi tutti i secondi) così il server
+// li elabora in un unico passaggio con istruzioni vettoriali. I lotti usano solo operandi int32.
+//
+// Espressione (codice G11_OP_ESPRESSIONE): un'espressione aritmetica sulle variabili a, b, c, ... valutata
+// per m assegnazioni di valori int32. La risposta ha lo stesso formato di quella di un lotto di m elementi.
+//
+//   richiesta (20 + t arrotondato a 4 + 4mk byte)
+//   12 uint8  k variabili (a, b, c, ... nell'ordine)
+//   13 uint8  riservato
+//   14 uint16 t byte del testo
+//   16 uint32 m assegnazioni (al più una se k = 0)
+//   20 char   testo[t], completato con zeri fino a un multiplo di 4
+//   .. int32  valori[m][k] (per ogni assegnazione i valori di a, b, c, ...)
+//
+// Come ogni frame la richiesta non supera G11_MAX_FRAME (circa 8 MB): m per k è quindi limitato a circa
+// 2 milioni di valori, anche se m da solo può arrivare a G11_MAX_LOTTO.
+//
+// Il testo usa + - * / (anche il meno unario), parentesi, costanti decimali e le variabili, con le
+// precedenze consuete; il calcolo segue le regole delle richieste int32 (stati di divisione per zero e
+// overflow per ogni assegnazione). Una costante deve stare in int32 con il suo meno, se lo ha: -2147483648
+// è valida, 2147483648 e -(2147483648) no. Un testo non valido riceve G11_STATO_SINTASSI.
+//
+// Flusso (codice G11_OP_FLUSSO, solo TCP): la stessa operazione applicata a n coppie che seguono il frame
+// come byte grezzi, senza altre intestazioni, così un file di coppie può essere inviato così com'è.
+//
+//   richiesta (24 byte, poi 8n)              risposta (20 byte, poi 8n)
+//   12 uint8  operazione (A, S, M, D)        12 uint64 n
+//   13 3 byte riservati                      poi per ogni coppia: int32 risultato,
+//   16 uint64 n                                 uint8 stato, 3 byte a zero
+//   poi per ogni coppia: int32 a, int32 b
+//
+// Il server elabora le coppie a blocchi man mano che arrivano e invia gli esiti nello stesso ordine,
+// quindi la memoria usata non dipende da n. Se la richiesta non è valida la risposta è quella da 16 byte
+// con lo stato di errore e le n coppie vengono lette e scartate.
+//
+// Operandi tipizzati: nelle richieste singole il campo opzioni indica il tipo degli operandi
+// (G11_TIPO_*), ripetuto nella risposta. Con 0 il frame è quello a 20 byte della prima versione.
+//
+//   int64 e double (28 byte)                 risposta (20 byte)
+//   12 int64  primo operando                 12 int64 o double risultato
+//   20 int64  secondo operando
+//   (i double viaggiano come i 64 bit IEEE 754, big-endian come gli interi)
+//
+//   interi grandi (20 + 4(na + nb) byte)     risposta (16 + 4n byte)
+//   12 uint32 segno e cifre del primo        12 uint32 segno e cifre n del risultato
+//   16 uint32 segno e cifre del secondo      16 uint32 cifre[n]
+//   20 uint32 cifre del primo[na]
+//   .. uint32 cifre del secondo[nb]
+//
+// Un intero grande è una sequenza di cifre in base 2^32, dalla più significativa; la parola che lo
+// precede ha il bit 31 a 1 se il numero è negativo e nei bit restanti il numero di cifre.
+// Gli stati G11_STATO_VERSIONE, G11_STATO_FORMATO, G11_STATO_OP_NON_VALIDA e G11_STATO_OCCUPATO hanno sempre
+// la risposta da 16 byte; con G11_STATO_DIV_ZERO e G11_STATO_OVERFLOW il risultato ha il formato del tipo.
+//
+// G11_STATO_OCCUPATO: la richiesta non è stata eseguita perché il server è sovraccarico (troppe connessioni,
+// richiesta rimasta in coda troppo a lungo) o perché il client ha superato il suo limite di richieste al
+// secondo; può essere ripetuta più tardi. Una connessione TCP oltre il limite riceve questa risposta con
+// id 0 e viene chiusa.
+#ifndef PROTOCOLLO_G11_H
+#define PROTOCOLLO_G11_H
+
+#include <stdint.h>     // Tipi a dimensione fissa
+#include <string.h>     // memcpy per letture e scritture non allineate
+#include <arpa/inet.h>  // htonl, ntohl, htons, ntohs
+
+#define G11_VERSIONE 1              // Versione corrente del protocollo
+
+#define G11_DIM_INTESTAZIONE 12     // Byte dell'intestazione comune
+#define G11_DIM_RICHIESTA 20        // Byte di una richiesta con due operandi
+#define G11_DIM_RISPOSTA 16         // Byte di una risposta con un risultato
+#define G11_DIM_LOTTO 8             // Byte del corpo di un lotto che precedono i vettori (operazione e n)
+#define G11_MAX_LOTTO (1u << 20)    // Numero massimo di coppie in un lotto
+#define G11_MAX_FRAME (G11_DIM_INTESTAZIONE + G11_DIM_LOTTO + 8u * G11_MAX_LOTTO) // Lunghezza massima di un frame
+#define G11_MAX_DATAGRAMMA 65507    // Carico utile massimo di un datagramma UDP su IPv4
+#define G11_DIM_RICHIESTA_64 28     // Byte di una richiesta con due operandi int64 o double
+#define G11_DIM_RISPOSTA_64 20      // Byte di una risposta con un risultato int64 o double
+#define G11_GRANDI_MAX_CIFRE 4096   // Cifre (base 2^32) massime di un operando intero grande
+#define G11_GRANDI_NEGATIVO 0x80000000u // Bit del segno nella parola che precede le cifre
+#define G11_DIM_FLUSSO 12           // Byte del corpo di una richiesta di flusso (operazione e n)
+#define G11_DIM_RISPOSTA_FLUSSO 20  // Byte della risposta che apre il flusso degli esiti
+#define G11_DIM_COPPIA 8            // Byte di una coppia di operandi nel flusso
+#define G11_DIM_ESITO 8             // Byte dell'esito di una coppia nel flusso
+#define G11_FLUSSO_BLOCCO 1024      // Coppie del flusso elaborate in un solo passaggio
+
+// Espressioni (G11_OP_ESPRESSIONE)
+#define G11_DIM_ESPRESSIONE 8       // Byte del corpo di un'espressione che precedono il testo
+#define G11_ESPR_MAX_TESTO 1024     // Byte massimi del testo di un'espressione
+#define G11_ESPR_MAX_VARIABILI 26   // Variabili di un'espressione: da a a z
+
+// Tipi degli operandi (campo opzioni delle richieste singole)
+#define G11_TIPO_INT32  0           // Interi a 32 bit, come nella prima versione
+#define G11_TIPO_INT64  1           // Interi a 64 bit
+#define G11_TIPO_DOUBLE 2           // Virgola mobile IEEE 754 a doppia precisione
+#define G11_TIPO_GRANDE 3           // Interi di precisione arbitraria
+
+// Codici operativi: coincidono con i comandi digitati dall'utente
+#define G11_OP_ADDIZIONE       'A'
+#define G11_OP_SOTTRAZIONE     'S'
+#define G11_OP_MOLTIPLICAZIONE 'M'
+#define G11_OP_DIVISIONE       'D'
+#define G11_OP_LOTTO           'B' // Stessa operazione su vettori di operandi
+#define G11_OP_ESPRESSIONE     'E' // Espressione con variabili, valutata per più assegnazioni
+#define G11_OP_FLUSSO          'F' // Coppie grezze che seguono il frame (solo TCP)
+
+// Codici di stato delle risposte
+#define G11_STATO_OK             0  // Calcolo eseguito
+#define G11_STATO_DIV_ZERO       1  // Divisione per zero: il risultato vale 0
+#define G11_STATO_OP_NON_VALIDA  2  // Codice operativo sconosciuto
+#define G11_STATO_VERSIONE       3  // Versione del protocollo non supportata
+#define G11_STATO_FORMATO        4  // Lunghezza del frame non coerente con l'operazione
+#define G11_STATO_OVERFLOW       5  // Risultato fuori dall'intervallo del tipo: vale il valore troncato
+#define G11_STATO_SINTASSI       6  // Espressione non valida
+#define G11_STATO_OCCUPATO       7  // Server sovraccarico o limite del client superato: richiesta non eseguita
+
+// Esito dell'analisi di un buffer di ingresso
+#define G11_FRAME_COMPLETO    1     // Nel buffer c'è almeno un frame intero
+#define G11_FRAME_INCOMPLETO  0     // Servono altri byte (lettura parziale)
+#define G11_FRAME_ERRATO     -1     // Lunghezza non valida: il flusso non è più sincronizzabile
+
+// Vista su un frame ricevuto. I puntatori fanno riferimento direttamente al buffer di ingresso:
+// l'analisi non copia i dati, che restano validi finché il buffer non viene riutilizzato.
+struct g11_frame {
+    uint32_t lunghezza;      // Lunghezza totale del frame
+    uint8_t versione;        // Versione del protocollo dichiarata dal mittente
+    uint8_t codice;          // Codice operativo (richiesta) o stato (risposta)
+    uint16_t opzioni;        // Campo opzioni
+    uint32_t id;             // Id della richiesta
+    const uint8_t *corpo;    // Inizio del corpo (dopo l'intestazione)
+    uint32_t dim_corpo;      // Byte del corpo
+};
+
+// Lettura e scrittura di interi in network byte order su indirizzi anche non allineati
+static inline uint32_t g11_leggi_u32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return ntohl(v);
+}
+
+static inline uint16_t g11_leggi_u16(const uint8_t *p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return ntohs(v);
+}
+
+static inline void g11_scrivi_u32(uint8_t *p, uint32_t v) {
+    v = htonl(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void g11_scrivi_u16(uint8_t *p, uint16_t v) {
+    v = htons(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline uint64_t g11_leggi_u64(const uint8_t *p) {
+    return (uint64_t) g11_leggi_u32(p) << 32 | g11_leggi_u32(p + 4);
+}
+
+static inline void g11_scrivi_u64(uint8_t *p, uint64_t v) {
+    g11_scrivi_u32(p, (uint32_t) (v >> 32));
+    g11_scrivi_u32(p + 4, (uint32_t) v);
+}
+
+// Scrive l'intestazione comune all'inizio di un frame.
+static inline void g11_scrivi_intestazione(uint8_t *p, uint32_t lunghezza, uint8_t codice, uint16_t opzioni, uint32_t id) {
+    g11_scrivi_u32(p, lunghezza);
+    p[4] = G11_VERSIONE;
+    p[5] = codice;
+    g11_scrivi_u16(p + 6, opzioni);
+    g11_scrivi_u32(p + 8, id);
+}
+
+// Codifica una richiesta con due operandi. Il buffer deve contenere almeno G11_DIM_RICHIESTA byte.
+static inline void g11_codifica_richiesta(uint8_t *p, uint8_t op, uint32_t id, int32_t a, int32_t b) {
+    g11_scrivi_intestazione(p, G11_DIM_RICHIESTA, op, 0, id);
+    g11_scrivi_u32(p + 12, (uint32_t) a);
+    g11_scrivi_u32(p + 16, (uint32_t) b);
+}
+
+// Codifica una risposta. Il buffer deve contenere almeno G11_DIM_RISPOSTA byte.
+static inline void g11_codifica_risposta(uint8_t *p, uint8_t stato, uint32_t id, int32_t risultato) {
+    g11_scrivi_intestazione(p, G11_DIM_RISPOSTA, stato, 0, id);
+    g11_scrivi_u32(p + 12, (uint32_t) risultato);
+}
+
+// Codifica una richiesta con due operandi a 64 bit (G11_TIPO_INT64, oppure G11_TIPO_DOUBLE con i bit
+// dei due double). Il buffer deve contenere almeno G11_DIM_RICHIESTA_64 byte.
+static inline void g11_codifica_richiesta_64(uint8_t *p, uint8_t op, uint16_t tipo, uint32_t id, uint64_t a, uint64_t b) {
+    g11_scrivi_intestazione(p, G11_DIM_RICHIESTA_64, op, tipo, id);
+    g11_scrivi_u64(p + 12, a);
+    g11_scrivi_u64(p + 20, b);
+}
+
+// Lunghezza di una richiesta con due interi grandi di na e nb cifre, e di una risposta con n cifre.
+static inline uint32_t g11_dim_richiesta_grandi(uint32_t na, uint32_t nb) {
+    return G11_DIM_INTESTAZIONE + 8u + 4u * (na + nb);
+}
+
+static inline uint32_t g11_dim_risposta_grande(uint32_t n) {
+    return G11_DIM_INTESTAZIONE + 4u + 4u * n;
+}
+
+// Lunghezza di una richiesta e della relativa risposta per un lotto di n coppie.
+static inline uint32_t g11_dim_richiesta_lotto(uint32_t n) {
+    return G11_DIM_INTESTAZIONE + G11_DIM_LOTTO + 8u * n;
+}
+
+static inline uint32_t g11_dim_risposta_lotto(uint32_t n) {
+    return G11_DIM_INTESTAZIONE + 4u + 4u * n + ((n + 3u) & ~3u);
+}
+
+// Codifica una richiesta a lotti. Il buffer deve contenere almeno g11_dim_richiesta_lotto(n) byte.
+static inline void g11_codifica_lotto(uint8_t *p, uint8_t op, uint32_t id,
+                                      const int32_t *a, const int32_t *b, uint32_t n) {
+    g11_scrivi_intestazione(p, g11_dim_richiesta_lotto(n), G11_OP_LOTTO, 0, id);
+    p[12] = op;
+    p[13] = p[14] = p[15] = 0;
+    g11_scrivi_u32(p + 16, n);
+    uint8_t *va = p + G11_DIM_INTESTAZIONE + G11_DIM_LOTTO;
+    uint8_t *vb = va + 4u * n;
+    for (uint32_t i = 0; i < n; i++) {
+        g11_scrivi_u32(va + 4u * i, (uint32_t) a[i]);
+        g11_scrivi_u32(vb + 4u * i, (uint32_t) b[i]);
+    }
+}
+
+// Lunghezza di una richiesta G11_OP_ESPRESSIONE con un testo di t byte, k variabili e m assegnazioni.
+static inline uint64_t g11_dim_richiesta_espressione(uint32_t t, uint32_t k, uint32_t m) {
+    return G11_DIM_INTESTAZIONE + G11_DIM_ESPRESSIONE + ((t + 3u) & ~3u) + 4u * (uint64_t) k * m;
+}
+
+// Codifica un'espressione con m assegnazioni di k valori (valori[i * k + j] è la variabile j
+// dell'assegnazione i). Il buffer deve contenere almeno g11_dim_richiesta_espressione(t, k, m) byte.
+static inline void g11_codifica_espressione(uint8_t *p, uint32_t id, const char *testo, uint16_t t,
+                                            uint8_t k, const int32_t *valori, uint32_t m) {
+    g11_scrivi_intestazione(p, (uint32_t) g11_dim_richiesta_espressione(t, k, m), G11_OP_ESPRESSIONE, 0, id);
+    p[12] = k;
+    p[13] = 0;
+    g11_scrivi_u16(p + 14, t);
+    g11_scrivi_u32(p + 16, m);
+    uint8_t *q = p + G11_DIM_INTESTAZIONE + G11_DIM_ESPRESSIONE;
+    memcpy(q, testo, t);
+    memset(q + t, 0, ((t + 3u) & ~3u) - t);
+    q += (t + 3u) & ~3u;
+    for (uint32_t i = 0; i < m * k; i++) {
+        g11_scrivi_u32(q + 4u * i, (uint32_t) valori[i]);
+    }
+}
+
+// Codifica la richiesta che apre un flusso di n coppie (G11_DIM_INTESTAZIONE + G11_DIM_FLUSSO byte).
+static inline void g11_codifica_flusso(uint8_t *p, uint8_t op, uint32_t id, uint64_t n) {
+    g11_scrivi_intestazione(p, G11_DIM_INTESTAZIONE + G11_DIM_FLUSSO, G11_OP_FLUSSO, 0, id);
+    p[12] = op;
+    p[13] = p[14] = p[15] = 0;
+    g11_scrivi_u64(p + 16, n);
+}
+
+// Lunghezza annunciata dal frame all'inizio del buffer, oppure 0 se non sono ancora arrivati 4 byte.
+// Serve a chi riceve per preparare un buffer abbastanza grande prima che il frame arrivi tutto.
+static inline uint32_t g11_lunghezza_annunciata(const uint8_t *buf, size_t disponibili) {
+    return disponibili < 4 ? 0 : g11_leggi_u32(buf);
+}
+
+// Analizza l'inizio del buffer. Se contiene un frame completo riempie 'f' e ritorna G11_FRAME_COMPLETO;
+// il chiamante avanza poi di f->lunghezza byte. Con meno byte di quanti annunciati ritorna
+// G11_FRAME_INCOMPLETO senza consumare nulla, così le letture parziali vengono ricomposte in loco.
+static inline int g11_analizza_frame(const uint8_t *buf, size_t disponibili, size_t max, struct g11_frame *f) {
+    if (disponibili < G11_DIM_INTESTAZIONE) {
+        return G11_FRAME_INCOMPLETO;
+    }
+    uint32_t lunghezza = g11_leggi_u32(buf);
+    if (lunghezza < G11_DIM_INTESTAZIONE || lunghezza > max) {
+        return G11_FRAME_ERRATO;
+    }
+    if (disponibili < lunghezza) {
+        return G11_FRAME_INCOMPLETO;
+    }
+    f->lunghezza = lunghezza;
+    f->versione = buf[4];
+    f->codice = buf[5];
+    f->opzioni = g11_leggi_u16(buf + 6);
+    f->id = g11_leggi_u32(buf + 8);
+    f->corpo = buf + G11_DIM_INTESTAZIONE;
+    f->dim_corpo = lunghezza - G11_DIM_INTESTAZIONE;
+    return G11_FRAME_COMPLETO;
+}
+
+// Nome dell'operazione, come nelle risposte testuali della prima versione del protocollo.
+static inline const char *g11_nome_operazione(uint8_t op) {
+    switch (op) {
+        case G11_OP_ADDIZIONE:       return "ADDIZIONE";
+        case G11_OP_SOTTRAZIONE:     return "SOTTRAZIONE";
+        case G11_OP_MOLTIPLICAZIONE: return "MOLTIPLICAZIONE";
+        case G11_OP_DIVISIONE:       return "DIVISIONE";
+        case G11_OP_LOTTO:           return "LOTTO";
+        case G11_OP_ESPRESSIONE:     return "ESPRESSIONE";
+        case G11_OP_FLUSSO:          return "FLUSSO";
+        default:                     return "SCONOSCIUTA";
+    }
+}
+
+// Descrizione leggibile di un codice di stato.
+static inline const char *g11_descrizione_stato(uint8_t stato) {
+    switch (stato) {
+        case G11_STATO_OK:            return "OK";
+        case G11_STATO_DIV_ZERO:      return "DIVISIONE PER ZERO";
+        case G11_STATO_OP_NON_VALIDA: return "OPERAZIONE NON VALIDA";
+        case G11_STATO_VERSIONE:      return "VERSIONE NON SUPPORTATA";
+        case G11_STATO_FORMATO:       return "FRAME NON VALIDO";
+        case G11_STATO_OVERFLOW:      return "OVERFLOW";
+        case G11_STATO_SINTASSI:      return "ESPRESSIONE NON VALIDA";
+        case G11_STATO_OCCUPATO:      return "SERVER OCCUPATO";
+        default:                      return "STATO SCONOSCIUTO";
+    }
+}
+
+// Nome del tipo degli operandi, come si indica ai client (-T).
+static inline const char *g11_nome_tipo(uint16_t tipo) {
+    switch (tipo) {
+        case G11_TIPO_INT32:  return "int32";
+        case G11_TIPO_INT64:  return "int64";
+        case G11_TIPO_DOUBLE: return "double";
+        case G11_TIPO_GRANDE: return "grande";
+        default:              return "sconosciuto";
+    }
+}
+
+// Riconosce il comando digitato dall'utente (anche minuscolo) e lo converte nel codice operativo.
+// Ritorna 0 se il comando non corrisponde ad alcuna operazione.
+static inline uint8_t g11_opcode_da_comando(char comando) {
+    switch (comando) {
+        case 'A': case 'a': return G11_OP_ADDIZIONE;
+        case 'S': case 's': return G11_OP_SOTTRAZIONE;
+        case 'M': case 'm': return G11_OP_MOLTIPLICAZIONE;
+        case 'D': case 'd': return G11_OP_DIVISIONE;
+        default:            return 0;
+    }
+}
+
+#endif // PROTOCOLLO_G11_H
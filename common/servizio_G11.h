@@ -0,0 +1,364 @@
+// Ciclo di vita dei server: arresto ordinato, configurazione ricaricabile e passaggio dei socket di
+// ascolto a un nuovo processo senza chiudere la porta.
+//
+// I segnali vengono bloccati in tutti i thread prima di crearli e ricevuti dal solo thread principale con
+// sigwaitinfo, quindi nessun gestore asincrono tocca lo stato del server:
+//   SIGTERM, SIGINT  arresto ordinato: i lavoratori smettono di accettare, finiscono le richieste ricevute
+//                    e terminano; log e metriche vengono scaricati prima dell'uscita
+//   SIGHUP           rilegge il file di configurazione (-f); ciò che non si può cambiare a caldo viene
+//                    applicato avviando un nuovo processo con gli stessi socket
+//   SIGUSR2          avvia il nuovo eseguibile con gli stessi socket e, quando è pronto, arresta questo
+//
+// I socket passano al nuovo processo con il protocollo dell'attivazione via socket di systemd: i descrittori
+// partono da 3, LISTEN_FDS ne indica il numero, LISTEN_FDNAMES i nomi e LISTEN_PID il processo a cui sono
+// destinati. Lo stesso codice accetta quindi anche i socket aperti da systemd (unità .socket). Sono gli stessi
+// socket, non copie: le connessioni in coda non vanno perse e nessun client trova la porta chiusa. Il nuovo
+// processo si dichiara pronto scrivendo un byte sul descrittore indicato da G11_PRONTO_FD; fino a quel
+// momento il vecchio continua ad accettare.
+#ifndef SERVIZIO_G11_H
+#define SERVIZIO_G11_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define G11_EREDITATI_INIZIO 3        // Primo descrittore passato (SD_LISTEN_FDS_START)
+#define G11_MAX_EREDITATI 512         // Socket passati al massimo
+#define G11_ATTESA_PRONTO_MS 10000    // Tempo concesso al nuovo processo per dichiararsi pronto
+
+static int g11_arresto;               // Fase dell'arresto (0 nessuna, 1 ordinato, 2 forzato): letta dai lavoratori a ogni risveglio
+
+static inline int g11_in_arresto(void) {
+    return __atomic_load_n(&g11_arresto, __ATOMIC_RELAXED) != 0;
+}
+
+static inline int g11_arresto_forzato(void) {
+    return __atomic_load_n(&g11_arresto, __ATOMIC_RELAXED) > 1;
+}
+
+static inline void g11_avvia_arresto(void) {
+    __atomic_store_n(&g11_arresto, 1, __ATOMIC_RELAXED);
+}
+
+// Scaduto il tempo dell'arresto ordinato: i lavoratori chiudono quanto resta e terminano subito.
+static inline void g11_forza_arresto(void) {
+    __atomic_store_n(&g11_arresto, 2, __ATOMIC_RELAXED);
+}
+
+// Blocca i segnali del ciclo di vita nel thread chiamante e in quelli che creerà; 'segnali' servirà a sigwaitinfo.
+static inline void g11_blocca_segnali(sigset_t *segnali) {
+    sigemptyset(segnali);
+    sigaddset(segnali, SIGTERM);
+    sigaddset(segnali, SIGINT);
+    sigaddset(segnali, SIGHUP);
+    sigaddset(segnali, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, segnali, NULL);
+}
+
+// --- File di configurazione ---
+// Una voce per riga, "nome = valore"; '#' inizia un commento. Ogni nome corrisponde a un'opzione della
+// riga di comando, interpretata dalla stessa funzione: il file prevale sulla riga di comando.
+
+struct g11_nome_opzione {
+    const char *nome;
+    int opzione;
+};
+
+typedef int (*g11_applica_opzione)(void *arg, int opzione, const char *valore);
+
+// Toglie gli spazi iniziali e finali
+static inline char *g11_config_pulisci(char *s) {
+    while (isspace((unsigned char) *s)) s++;
+    size_t n = strlen(s);
+    while (n > 0 && isspace((unsigned char) s[n - 1])) s[--n] = '\0';
+    return s;
+}
+
+// Legge il file e applica le voci nell'ordine. 'applica' ritorna come le funzioni delle opzioni:
+// > 0 riconosciuta, 0 sconosciuta, < 0 valore non valido. Ritorna 0, oppure -1 con il motivo in 'errore'.
+static inline int g11_config_leggi(const char *percorso, const struct g11_nome_opzione *nomi,
+                                   g11_applica_opzione applica, void *arg, char *errore, size_t dim) {
+    FILE *f = fopen(percorso, "re");
+    if (f == NULL) {
+        snprintf(errore, dim, "%s: %s", percorso, strerror(errno));
+        return -1;
+    }
+    char riga[512];
+    int numero = 0, esito = 0;
+    while (esito == 0 && fgets(riga, sizeof(riga), f) != NULL) {
+        numero++;
+        char *commento = strchr(riga, '#');
+        if (commento != NULL) *commento = '\0';
+        char *nome = g11_config_pulisci(riga);
+        if (*nome == '\0') {
+            continue;
+        }
+        char *uguale = strchr(nome, '=');
+        if (uguale == NULL) {
+            snprintf(errore, dim, "%s:%d: manca '=' in \"%s\"", percorso, numero, nome);
+            esito = -1;
+            break;
+        }
+        *uguale = '\0';
+        nome = g11_config_pulisci(nome);
+        char *valore = g11_config_pulisci(uguale + 1);
+        const struct g11_nome_opzione *n = nomi;
+        while (n->nome != NULL && strcmp(n->nome, nome) != 0) n++;
+        if (n->nome == NULL) {
+            snprintf(errore, dim, "%s:%d: voce sconosciuta \"%s\"", percorso, numero, nome);
+            esito = -1;
+        } else if (applica(arg, n->opzione, valore) <= 0) {
+            snprintf(errore, dim, "%s:%d: valore non valido per %s: \"%s\"", percorso, numero, nome, valore);
+            esito = -1;
+        }
+    }
+    fclose(f);
+    return esito;
+}
+
+// --- Socket ricevuti dal processo precedente (o da systemd) ---
+
+struct g11_ereditato {
+    int fd;                           // -1 dopo essere stato preso
+    char nome[32];
+};
+
+static struct g11_ereditato g11_ereditati[G11_MAX_EREDITATI];
+static int g11_n_ereditati = -1;      // -1 finché l'ambiente non è stato letto
+
+// Legge LISTEN_PID, LISTEN_FDS e LISTEN_FDNAMES una sola volta e li toglie dall'ambiente, così non passano
+// ai processi figli. I socket senza nome (o "unknown", come li chiama systemd) sono socket di ascolto.
+static inline void g11_leggi_ereditati(void) {
+    if (g11_n_ereditati >= 0) {
+        return;
+    }
+    g11_n_ereditati = 0;
+    const char *pid = getenv("LISTEN_PID"), *fds = getenv("LISTEN_FDS"), *nomi = getenv("LISTEN_FDNAMES");
+    if (pid != NULL && fds != NULL && strtol(pid, NULL, 10) == (long) getpid()) {
+        int n = atoi(fds);
+        for (int i = 0; i < n && i < G11_MAX_EREDITATI; i++) {
+            struct g11_ereditato *e = &g11_ereditati[g11_n_ereditati++];
+            e->fd = G11_EREDITATI_INIZIO + i;
+            fcntl(e->fd, F_SETFD, FD_CLOEXEC); // Non devono passare ad altri programmi
+            size_t k = 0;
+            while (nomi != NULL && *nomi != '\0' && *nomi != ':') {
+                if (k < sizeof(e->nome) - 1) e->nome[k++] = *nomi;
+                nomi++;
+            }
+            if (nomi != NULL && *nomi == ':') nomi++;
+            e->nome[k] = '\0';
+            if (k == 0 || strcmp(e->nome, "unknown") == 0) {
+                strcpy(e->nome, "ascolto");
+            }
+        }
+    }
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+}
+
+// Prende fino a 'max' socket ricevuti con il nome e il tipo (SOCK_STREAM, SOCK_DGRAM) indicati.
+// Ritorna il numero di descrittori scritti in 'fd'.
+static inline int g11_prendi_ereditati(const char *nome, int tipo, int *fd, int max) {
+    int n = 0;
+    g11_leggi_ereditati();
+    for (int i = 0; i < g11_n_ereditati && n < max; i++) {
+        struct g11_ereditato *e = &g11_ereditati[i];
+        int t = 0;
+        socklen_t dim = sizeof(t);
+        if (e->fd < 0 || strcmp(e->nome, nome) != 0 ||
+            getsockopt(e->fd, SOL_SOCKET, SO_TYPE, &t, &dim) < 0 || t != tipo) {
+            continue;
+        }
+        fd[n++] = e->fd;
+        e->fd = -1;
+    }
+    return n;
+}
+
+// Chiamata dal nuovo processo quando i suoi lavoratori sono avviati: il processo precedente può arrestarsi.
+static inline void g11_dichiara_pronto(void) {
+    const char *s = getenv("G11_PRONTO_FD");
+    if (s != NULL) {
+        int fd = atoi(s);
+        if (write(fd, "1", 1) < 0) {
+            perror("G11_PRONTO_FD");
+        }
+        close(fd);
+        unsetenv("G11_PRONTO_FD");
+    }
+}
+
+// --- Passaggio dei socket a un nuovo processo ---
+
+// 'p' reso assoluto senza risolvere i collegamenti simbolici: se relativo gli viene anteposta la directory
+// corrente. Ritorna una stringa allocata con malloc, oppure NULL.
+static inline char *g11_percorso_assoluto(const char *p) {
+    if (p[0] == '/') {
+        return strdup(p);
+    }
+    char *cwd = getcwd(NULL, 0);
+    if (cwd == NULL) {
+        return NULL;
+    }
+    size_t dim = strlen(cwd) + strlen(p) + 2;
+    char *percorso = malloc(dim);
+    if (percorso != NULL) {
+        snprintf(percorso, dim, "%s/%s", cwd, p);
+    }
+    free(cwd);
+    return percorso;
+}
+
+// Percorso assoluto del programma in esecuzione, da calcolare all'avvio: argv[0] senza '/' viene cercato
+// nelle directory di PATH come fa la shell. I collegamenti simbolici restano come sono: se un aggiornamento
+// sostituisce il file o sposta il collegamento (current -> releases/vN), lo stesso percorso porta al nuovo
+// eseguibile. /proc/self/exe punta invece all'eseguibile originale, anche se rimosso, e serve solo se la
+// ricerca fallisce. Ritorna una stringa allocata con malloc, al più argv0.
+static inline const char *g11_percorso_eseguibile(const char *argv0) {
+    char *percorso = NULL;
+    const char *path = getenv("PATH");
+    if (strchr(argv0, '/') != NULL) {
+        percorso = g11_percorso_assoluto(argv0);
+    } else if (path != NULL) {
+        size_t dim = strlen(path) + strlen(argv0) + 2;
+        char *prova = malloc(dim);
+        for (const char *d = path; prova != NULL && percorso == NULL; d++) {
+            const char *fine = strchrnul(d, ':');
+            // Un elemento vuoto di PATH indica la directory corrente
+            snprintf(prova, dim, "%.*s%s%s", (int) (fine - d), d, fine > d ? "/" : "", argv0);
+            if (access(prova, X_OK) == 0) {
+                percorso = g11_percorso_assoluto(prova);
+            }
+            if (*fine == '\0') break;
+            d = fine;
+        }
+        free(prova);
+    }
+    if (percorso == NULL) {
+        percorso = realpath("/proc/self/exe", NULL);
+    }
+    return percorso != NULL ? percorso : argv0;
+}
+
+// Una variabile d'ambiente che il passaggio sostituisce
+static inline int g11_variabile_passaggio(const char *v) {
+    return strncmp(v, "LISTEN_", 7) == 0 || strncmp(v, "G11_PRONTO_FD=", 14) == 0;
+}
+
+// Avvia 'eseguibile' con gli argomenti 'argv' passandogli i socket fd[0..n) con i rispettivi nomi e attende che
+// si dichiari pronto. Ritorna il pid del nuovo processo, oppure -1 con il motivo in 'errore' (in tal caso
+// il nuovo processo, se era partito, è stato terminato e questo può continuare a servire).
+static inline pid_t g11_passa_socket(const char *eseguibile, char *const argv[], const int *fd,
+                                     const char *const *nomi, int n, char *errore, size_t dim) {
+    extern char **environ;
+    int pronto[2];
+    int alti[G11_MAX_EREDITATI + 1];
+    int base = G11_EREDITATI_INIZIO + n + 1;   // Sopra i descrittori di arrivo: le dup2 non si sovrappongono
+    if (n > G11_MAX_EREDITATI) {
+        snprintf(errore, dim, "troppi socket (%d)", n);
+        return -1;
+    }
+    if (pipe2(pronto, O_CLOEXEC) < 0) {
+        snprintf(errore, dim, "pipe: %s", strerror(errno));
+        return -1;
+    }
+
+    // Ambiente del nuovo processo, preparato prima della fork: dopo, nel figlio, solo chiamate async-signal-safe
+    size_t voci = 0;
+    while (environ[voci] != NULL) voci++;
+    char **ambiente = calloc(voci + 5, sizeof(char *));
+    size_t dim_nomi = 32;
+    for (int i = 0; i < n; i++) dim_nomi += strlen(nomi[i]) + 1;
+    char *var_nomi = malloc(dim_nomi);
+    static char var_fds[32], var_pronto[32], var_pid[32];
+    int ok = ambiente != NULL && var_nomi != NULL;
+    for (int i = 0; ok && i <= n; i++) {
+        alti[i] = fcntl(i < n ? fd[i] : pronto[1], F_DUPFD_CLOEXEC, base);
+        ok = alti[i] >= 0;
+        if (!ok) {
+            while (i-- > 0) close(alti[i]);
+        }
+    }
+    if (!ok) {
+        snprintf(errore, dim, "preparazione del nuovo processo: %s", strerror(errno));
+        free(ambiente);
+        free(var_nomi);
+        close(pronto[0]);
+        close(pronto[1]);
+        return -1;
+    }
+    size_t k = 0;
+    for (size_t i = 0; i < voci; i++) {
+        if (!g11_variabile_passaggio(environ[i])) ambiente[k++] = environ[i];
+    }
+    snprintf(var_fds, sizeof(var_fds), "LISTEN_FDS=%d", n);
+    snprintf(var_pronto, sizeof(var_pronto), "G11_PRONTO_FD=%d", G11_EREDITATI_INIZIO + n);
+    strcpy(var_nomi, "LISTEN_FDNAMES=");
+    for (int i = 0; i < n; i++) {
+        if (i > 0) strcat(var_nomi, ":");
+        strcat(var_nomi, nomi[i]);
+    }
+    ambiente[k++] = var_fds;
+    ambiente[k++] = var_nomi;
+    ambiente[k++] = var_pronto;
+    ambiente[k++] = var_pid;
+    ambiente[k] = NULL;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Figlio: i socket ai descrittori 3..3+n-1, la pipe subito dopo, poi il nuovo eseguibile
+        char cifre[16];
+        int c = 0;
+        for (pid_t p = getpid(); p > 0; p /= 10) cifre[c++] = (char) ('0' + p % 10);
+        memcpy(var_pid, "LISTEN_PID=", 11);
+        for (int i = 0; i < c; i++) var_pid[11 + i] = cifre[c - 1 - i];
+        var_pid[11 + c] = '\0';
+        for (int i = 0; i <= n; i++) {
+            if (dup2(alti[i], G11_EREDITATI_INIZIO + i) < 0) _exit(127); // dup2 toglie FD_CLOEXEC
+        }
+        sigset_t nessuno;
+        sigemptyset(&nessuno);
+        sigprocmask(SIG_SETMASK, &nessuno, NULL); // La maschera passerebbe intatta attraverso execve
+        execve(eseguibile, argv, ambiente);
+        _exit(127);
+    }
+    int errore_fork = errno;
+    for (int i = 0; i <= n; i++) close(alti[i]);
+    close(pronto[1]);
+    free(ambiente);
+    free(var_nomi);
+    if (pid < 0) {
+        snprintf(errore, dim, "fork: %s", strerror(errore_fork));
+        close(pronto[0]);
+        return -1;
+    }
+
+    // Il nuovo processo è pronto quando scrive il suo byte; se esce prima la pipe si chiude senza dati
+    struct pollfd p = { .fd = pronto[0], .events = POLLIN };
+    char byte = 0;
+    int r;
+    while ((r = poll(&p, 1, G11_ATTESA_PRONTO_MS)) < 0 && errno == EINTR) {
+    }
+    if (r > 0 && read(pronto[0], &byte, 1) == 1) {
+        close(pronto[0]);
+        return pid;
+    }
+    close(pronto[0]);
+    snprintf(errore, dim, "%s (pid %d) %s", eseguibile, (int) pid,
+             r == 0 ? "non si è dichiarato pronto in tempo" : "è terminato durante l'avvio");
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    return -1;
+}
+
+#endif // SERVIZIO_G11_H
@@ -0,0 +1,313 @@
+// Accesso minimo a io_uring tramite le chiamate di sistema dirette (senza liburing).
+//
+// Un anello contiene la coda di sottomissione (SQ) e quella di completamento (CQ), condivise con il kernel
+// tramite mmap: le richieste si scrivono nella SQ senza chiamate di sistema e vengono consegnate tutte
+// insieme con una sola io_uring_enter, che nello stesso passaggio attende i completamenti.
+//
+// Per le ricezioni si registra un anello di buffer forniti (IORING_REGISTER_PBUF_RING): il kernel sceglie
+// un buffer libero al momento dell'arrivo dei dati, quindi una recv multishot può restare armata su ogni
+// connessione senza riservarle memoria. Richiede Linux >= 6.0.
+#ifndef URING_G11_H
+#define URING_G11_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+struct g11_uring {
+    int fd;
+    unsigned *sq_testa, *sq_coda, sq_maschera; // Testa letta dal kernel, coda scritta da noi
+    unsigned sq_locale;                        // Coda delle richieste preparate ma non ancora pubblicate
+    unsigned sq_voci;
+    struct io_uring_sqe *sqe;
+    unsigned *cq_testa, *cq_coda, cq_maschera;
+    struct io_uring_cqe *cqe;
+    void *anelli;                              // Area mmap di SQ e CQ (unica con IORING_FEAT_SINGLE_MMAP)
+    size_t dim_anelli, dim_sqe;
+    void *anello_cq;                           // Area separata della CQ sui kernel senza SINGLE_MMAP
+    size_t dim_cq;
+};
+
+// Anello di buffer forniti al kernel per le ricezioni
+struct g11_buffer_forniti {
+    struct io_uring_buf_ring *anello;
+    unsigned char *memoria;  // voci * dim byte contigui
+    unsigned voci, maschera; // voci è una potenza di 2
+    unsigned dim;            // Dimensione di ogni buffer
+    uint16_t gruppo;         // Identificativo del gruppo (buf_group nelle SQE)
+    uint16_t coda;           // Prossima posizione libera dell'anello
+    size_t dim_anello;
+};
+
+static inline int g11_uring_setup(unsigned voci, struct io_uring_params *p) {
+    return (int) syscall(__NR_io_uring_setup, voci, p);
+}
+
+static inline int g11_uring_enter(int fd, unsigned da_inviare, unsigned min_completi, unsigned flag) {
+    return (int) syscall(__NR_io_uring_enter, fd, da_inviare, min_completi, flag, NULL, 0);
+}
+
+static inline int g11_uring_register(int fd, unsigned codice, void *arg, unsigned n) {
+    return (int) syscall(__NR_io_uring_register, fd, codice, arg, n);
+}
+
+static inline void g11_uring_distruggi(struct g11_uring *u) {
+    if (u->sqe != NULL && u->sqe != MAP_FAILED) munmap(u->sqe, u->dim_sqe);
+    if (u->anello_cq != NULL && u->anello_cq != MAP_FAILED) munmap(u->anello_cq, u->dim_cq);
+    if (u->anelli != NULL && u->anelli != MAP_FAILED) munmap(u->anelli, u->dim_anelli);
+    if (u->fd >= 0) close(u->fd);
+    memset(u, 0, sizeof(*u));
+    u->fd = -1;
+}
+
+// Crea un anello con 'voci' posti nella SQ e 'voci_cq' nella CQ. Prova prima le opzioni pensate per un solo
+// thread proprietario (SINGLE_ISSUER, DEFER_TASKRUN: i completamenti vengono prodotti solo dentro
+// io_uring_enter, senza interrompere il thread), poi ripiega su un anello semplice.
+// Ritorna 0, oppure -errno se io_uring non è disponibile.
+static inline int g11_uring_crea(struct g11_uring *u, unsigned voci, unsigned voci_cq) {
+    static const unsigned tentativi[] = {
+        IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN,
+        IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN,
+        IORING_SETUP_CQSIZE,
+    };
+    struct io_uring_params p;
+
+    memset(u, 0, sizeof(*u));
+    u->fd = -EINVAL;
+    for (unsigned i = 0; i < sizeof(tentativi) / sizeof(tentativi[0]) && u->fd < 0; i++) {
+        memset(&p, 0, sizeof(p));
+        p.flags = tentativi[i];
+        p.cq_entries = voci_cq;
+        u->fd = g11_uring_setup(voci, &p);
+        if (u->fd < 0) {
+            u->fd = -errno;
+            if (errno != EINVAL) break; // ENOSYS, EPERM (io_uring disattivato): inutile riprovare
+        }
+    }
+    if (u->fd < 0) {
+        int err = u->fd;
+        u->fd = -1;
+        return err;
+    }
+
+    size_t dim_sq = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->dim_cq = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->dim_anelli = dim_sq;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        u->dim_anelli = dim_sq > u->dim_cq ? dim_sq : u->dim_cq;
+    }
+    u->anelli = mmap(NULL, u->dim_anelli, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->anelli == MAP_FAILED) goto errore;
+    void *cq = u->anelli;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        u->anello_cq = mmap(NULL, u->dim_cq, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+        if (u->anello_cq == MAP_FAILED) goto errore;
+        cq = u->anello_cq;
+    }
+    u->dim_sqe = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqe = mmap(NULL, u->dim_sqe, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqe == MAP_FAILED) goto errore;
+
+    char *sq = u->anelli;
+    u->sq_testa = (unsigned *) (sq + p.sq_off.head);
+    u->sq_coda = (unsigned *) (sq + p.sq_off.tail);
+    u->sq_maschera = *(unsigned *) (sq + p.sq_off.ring_mask);
+    u->sq_voci = p.sq_entries;
+    u->sq_locale = *u->sq_coda;
+    unsigned *indici = (unsigned *) (sq + p.sq_off.array);
+    for (unsigned i = 0; i < p.sq_entries; i++) {
+        indici[i] = i; // La posizione i della SQ usa sempre la SQE i
+    }
+    u->cq_testa = (unsigned *) ((char *) cq + p.cq_off.head);
+    u->cq_coda = (unsigned *) ((char *) cq + p.cq_off.tail);
+    u->cq_maschera = *(unsigned *) ((char *) cq + p.cq_off.ring_mask);
+    u->cqe = (struct io_uring_cqe *) ((char *) cq + p.cq_off.cqes);
+    return 0;
+
+errore:;
+    int err = -errno;
+    g11_uring_distruggi(u);
+    return err;
+}
+
+// Pubblica le richieste preparate, le consegna al kernel e attende almeno 'min_completi' completamenti.
+// Ritorna il numero di richieste consegnate oppure -errno.
+static inline int g11_uring_invia(struct g11_uring *u, unsigned min_completi) {
+    __atomic_store_n(u->sq_coda, u->sq_locale, __ATOMIC_RELEASE);
+    unsigned n = u->sq_locale - __atomic_load_n(u->sq_testa, __ATOMIC_ACQUIRE);
+    int r = g11_uring_enter(u->fd, n, min_completi, min_completi > 0 ? IORING_ENTER_GETEVENTS : 0);
+    return r < 0 ? -errno : r;
+}
+
+// Prossima SQE libera, azzerata. Se la SQ è piena consegna prima le richieste già preparate.
+// Ritorna NULL solo se il kernel non riesce ad accettarle.
+static inline struct io_uring_sqe *g11_uring_sqe(struct g11_uring *u) {
+    if (u->sq_locale - __atomic_load_n(u->sq_testa, __ATOMIC_ACQUIRE) >= u->sq_voci) {
+        if (g11_uring_invia(u, 0) < 0 ||
+            u->sq_locale - __atomic_load_n(u->sq_testa, __ATOMIC_ACQUIRE) >= u->sq_voci) {
+            return NULL;
+        }
+    }
+    struct io_uring_sqe *s = &u->sqe[u->sq_locale & u->sq_maschera];
+    memset(s, 0, sizeof(*s));
+    u->sq_locale++;
+    return s;
+}
+
+// Scorrimento della CQ: g11_uring_cqe restituisce il prossimo completamento (NULL se non ce ne sono),
+// g11_uring_cqe_fatto lo libera.
+static inline struct io_uring_cqe *g11_uring_cqe(struct g11_uring *u) {
+    unsigned testa = *u->cq_testa;
+    if (testa == __atomic_load_n(u->cq_coda, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return &u->cqe[testa & u->cq_maschera];
+}
+
+static inline void g11_uring_cqe_fatto(struct g11_uring *u) {
+    __atomic_store_n(u->cq_testa, *u->cq_testa + 1, __ATOMIC_RELEASE);
+}
+
+// Preparazione delle richieste usate dal server
+static inline void g11_prep_accetta_multishot(struct io_uring_sqe *s, int fd, uint64_t dato) {
+    s->opcode = IORING_OP_ACCEPT;
+    s->fd = fd;
+    s->ioprio = IORING_ACCEPT_MULTISHOT; // Un completamento per ogni connessione, finché non viene annullata
+    s->accept_flags = SOCK_CLOEXEC;
+    s->user_data = dato;
+}
+
+static inline void g11_prep_ricevi_multishot(struct io_uring_sqe *s, int fd, uint16_t gruppo, uint64_t dato) {
+    s->opcode = IORING_OP_RECV;
+    s->fd = fd;
+    s->ioprio = IORING_RECV_MULTISHOT;   // Resta armata: un completamento per ogni blocco di dati ricevuto
+    s->flags = IOSQE_BUFFER_SELECT;      // Il buffer viene preso dall'anello del gruppo indicato
+    s->buf_group = gruppo;
+    s->user_data = dato;
+}
+
+static inline void g11_prep_invia(struct io_uring_sqe *s, int fd, const void *buf, size_t len, uint64_t dato) {
+    s->opcode = IORING_OP_SEND;
+    s->fd = fd;
+    s->addr = (uint64_t) (uintptr_t) buf;
+    s->len = (uint32_t) len;
+    s->msg_flags = MSG_NOSIGNAL;
+    s->user_data = dato;
+}
+
+static inline void g11_prep_annulla(struct io_uring_sqe *s, uint64_t bersaglio, uint64_t dato) {
+    s->opcode = IORING_OP_ASYNC_CANCEL;
+    s->fd = -1;
+    s->addr = bersaglio; // user_data della richiesta da annullare
+    s->user_data = dato;
+}
+
+// Timer: si completa con -ETIME allo scadere di *attesa, così l'attesa dei completamenti ha un limite
+// anche quando non arriva nulla. Il kernel copia *attesa al momento della sottomissione.
+static inline void g11_prep_timer(struct io_uring_sqe *s, const struct __kernel_timespec *attesa, uint64_t dato) {
+    s->opcode = IORING_OP_TIMEOUT;
+    s->fd = -1;
+    s->addr = (uint64_t) (uintptr_t) attesa;
+    s->len = 1;
+    s->user_data = dato;
+}
+
+// Restituisce il buffer 'id' all'anello; diventa visibile al kernel con g11_buffer_pubblica.
+static inline void g11_buffer_restituisci(struct g11_buffer_forniti *b, uint16_t id) {
+    struct io_uring_buf *voce = &b->anello->bufs[b->coda & b->maschera];
+    voce->addr = (uint64_t) (uintptr_t) (b->memoria + (size_t) id * b->dim);
+    voce->len = b->dim;
+    voce->bid = id;
+    b->coda++;
+}
+
+static inline void g11_buffer_pubblica(struct g11_buffer_forniti *b) {
+    __atomic_store_n(&b->anello->tail, b->coda, __ATOMIC_RELEASE);
+}
+
+static inline unsigned char *g11_buffer_dati(const struct g11_buffer_forniti *b, uint16_t id) {
+    return b->memoria + (size_t) id * b->dim;
+}
+
+// Alloca 'voci' buffer da 'dim' byte (voci potenza di 2, al più 32768) e li registra nel gruppo 'gruppo'.
+// Ritorna 0 oppure -errno (EINVAL sui kernel che non supportano gli anelli di buffer).
+static inline int g11_buffer_crea(struct g11_uring *u, struct g11_buffer_forniti *b,
+                                  uint16_t gruppo, unsigned voci, unsigned dim) {
+    memset(b, 0, sizeof(*b));
+    b->voci = voci;
+    b->maschera = voci - 1;
+    b->dim = dim;
+    b->gruppo = gruppo;
+    b->dim_anello = voci * sizeof(struct io_uring_buf);
+    b->anello = mmap(NULL, b->dim_anello, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b->anello == MAP_FAILED) {
+        return -errno;
+    }
+    b->memoria = mmap(NULL, (size_t) voci * dim, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b->memoria == MAP_FAILED) {
+        int err = -errno;
+        munmap(b->anello, b->dim_anello);
+        return err;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t) (uintptr_t) b->anello;
+    reg.ring_entries = voci;
+    reg.bgid = gruppo;
+    if (g11_uring_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        int err = -errno;
+        munmap(b->memoria, (size_t) voci * dim);
+        munmap(b->anello, b->dim_anello);
+        return err;
+    }
+    for (unsigned i = 0; i < voci; i++) {
+        g11_buffer_restituisci(b, (uint16_t) i);
+    }
+    g11_buffer_pubblica(b);
+    return 0;
+}
+
+static inline void g11_buffer_distruggi(struct g11_buffer_forniti *b) {
+    munmap(b->memoria, (size_t) b->voci * b->dim);
+    munmap(b->anello, b->dim_anello);
+}
+
+// Verifica che il kernel supporti tutto ciò che serve al server: anello, buffer forniti e recv multishot
+// (gli ultimi due non si possono rilevare dalle feature dell'anello). Prova una ricezione su una coppia
+// di socket locali. Ritorna 0 oppure -errno.
+static inline int g11_uring_supportato(void) {
+    struct g11_uring u;
+    struct g11_buffer_forniti b;
+    int sv[2];
+    int r = g11_uring_crea(&u, 4, 8);
+    if (r < 0) {
+        return r;
+    }
+    r = g11_buffer_crea(&u, &b, 0, 2, 64);
+    if (r == 0) {
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+            r = -errno;
+        } else {
+            struct io_uring_sqe *s = g11_uring_sqe(&u);
+            g11_prep_ricevi_multishot(s, sv[0], 0, 1);
+            r = write(sv[1], "x", 1) == 1 ? g11_uring_invia(&u, 1) : -EIO;
+            if (r >= 0) {
+                struct io_uring_cqe *c = g11_uring_cqe(&u);
+                r = c != NULL && c->res == 1 && (c->flags & IORING_CQE_F_MORE) ? 0 : -EOPNOTSUPP;
+            }
+            close(sv[0]);
+            close(sv[1]);
+        }
+        g11_buffer_distruggi(&b);
+    }
+    g11_uring_distruggi(&u);
+    return r;
+}
+
+#endif // URING_G11_H